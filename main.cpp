@@ -1,9 +1,16 @@
 #include <iostream>
 #include <string>
+#include <winsock2.h>
 #include <windows.h>
+#include <winioctl.h>
+#include <psapi.h>
+#include <iphlpapi.h>
+#include <winternl.h>
 #include <vector>
+#include <array>
 #include <sstream>
 #include <map>
+#include <unordered_map>
 #include <iomanip>
 #include <filesystem>
 #include <fstream>
@@ -14,6 +21,7 @@
 #include <algorithm>
 #include <ctime>
 #include <cstdlib>
+#include <cmath>
 #include <iomanip>
 #include <regex>
 #include <future>
@@ -30,6 +38,29 @@
 #include <bitset>
 #include <numeric>
 #include <execution>
+#include <cstring>
+#include <intrin.h>
+#include <immintrin.h>
+
+// MSVC picks these libraries up from the pragmas; MinGW and GCC ignore them and
+// need them on the link line: -liphlpapi -lntdll -lpsapi
+#pragma comment(lib, "iphlpapi.lib")
+#pragma comment(lib, "ntdll.lib")
+#pragma comment(lib, "psapi.lib")
+
+// MSVC compiles ISA-specific intrinsics anywhere; GCC and Clang need the function
+// marked. Callers check CpuFeatures before taking these paths.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_SHA __attribute__((target("sha,sse4.1,ssse3")))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_XSAVE __attribute__((target("xsave")))
+#else
+#define TARGET_AVX2
+#define TARGET_SHA
+#define TARGET_SSSE3
+#define TARGET_XSAVE
+#endif
 
 namespace fs = std::filesystem;
 
@@ -41,6 +72,305 @@ public:
     }
 };
 
+class ConsoleInterrupt {
+public:
+    static void install() {
+        event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        SetConsoleCtrlHandler(handler, TRUE);
+    }
+
+    static bool requested() {
+        return flag.load(std::memory_order_relaxed);
+    }
+
+    static void reset() {
+        flag = false;
+        if (event) ResetEvent(event);
+    }
+
+    // Signaled on Ctrl+C, for use in WaitForMultipleObjects.
+    static HANDLE waitHandle() {
+        return event;
+    }
+
+private:
+    static inline std::atomic<bool> flag{false};
+    static inline HANDLE event = nullptr;
+
+    static BOOL WINAPI handler(DWORD type) {
+        if (type == CTRL_C_EVENT || type == CTRL_BREAK_EVENT) {
+            flag = true;
+            if (event) SetEvent(event);
+            return TRUE;
+        }
+        return FALSE;
+    }
+};
+
+// Read-only view of a whole file. Pages are faulted in on access, so opening and
+// touching only the tail of a huge file costs the same as for a small one.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const fs::path& path) {
+        open(path);
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const fs::path& path) {
+        close();
+        file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            file = nullptr;
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            close();
+            return false;
+        }
+        length = static_cast<uint64_t>(fileSize.QuadPart);
+        if (length == 0) return true;
+
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (!view) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (view) UnmapViewOfFile(view);
+        if (mapping) CloseHandle(mapping);
+        if (file) CloseHandle(file);
+        view = nullptr;
+        mapping = nullptr;
+        file = nullptr;
+        length = 0;
+    }
+
+    bool isOpen() const { return file != nullptr; }
+    const char* data() const { return view; }
+    uint64_t size() const { return length; }
+
+private:
+    HANDLE file = nullptr;
+    HANDLE mapping = nullptr;
+    const char* view = nullptr;
+    uint64_t length = 0;
+};
+
+class TextEncoding {
+public:
+    static std::string toUtf8(const std::wstring& text) {
+        if (text.empty()) return {};
+        int size = WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0, nullptr, nullptr);
+        std::string result(size, '\0');
+        WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), result.data(), size, nullptr, nullptr);
+        return result;
+    }
+
+    static void appendUtf8(std::string& out, const wchar_t* text, size_t length) {
+        if (length == 0) return;
+        size_t start = out.size();
+        int size = WideCharToMultiByte(CP_UTF8, 0, text, static_cast<int>(length), nullptr, 0, nullptr, nullptr);
+        out.resize(start + size);
+        WideCharToMultiByte(CP_UTF8, 0, text, static_cast<int>(length), out.data() + start, size, nullptr, nullptr);
+    }
+
+    static std::wstring toWide(const std::string& text) {
+        if (text.empty()) return {};
+        int size = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+        std::wstring result(size, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), result.data(), size);
+        return result;
+    }
+};
+
+// Enumerates a directory in large batches with GetFileInformationByHandleEx. Each
+// record already carries sizes, times, attributes and the file id, so callers never
+// need a per-entry metadata call.
+class DirectoryReader {
+public:
+    struct Entry {
+        const WCHAR* name;
+        size_t nameLength;
+        DWORD attributes;
+        uint64_t size;
+        uint64_t allocationSize;
+        uint64_t creationTime;
+        uint64_t lastWriteTime;
+        uint64_t fileId;
+
+        bool isDirectory() const { return (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0; }
+        bool isReparsePoint() const { return (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0; }
+    };
+
+    explicit DirectoryReader(const fs::path& dir) {
+        handle = CreateFileW(dir.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                             nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) lastError = GetLastError();
+    }
+
+    ~DirectoryReader() {
+        if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+    }
+
+    DirectoryReader(const DirectoryReader&) = delete;
+    DirectoryReader& operator=(const DirectoryReader&) = delete;
+
+    bool isOpen() const { return handle != INVALID_HANDLE_VALUE; }
+    DWORD error() const { return lastError; }
+
+    // Volume serial number, file id and last write time of the directory itself. A
+    // file id is only unique within its volume.
+    bool identity(DWORD& volume, uint64_t& fileId, uint64_t& lastWriteTime) {
+        BY_HANDLE_FILE_INFORMATION info;
+        if (!isOpen() || !GetFileInformationByHandle(handle, &info)) {
+            if (isOpen()) lastError = GetLastError();
+            return false;
+        }
+        volume = info.dwVolumeSerialNumber;
+        fileId = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+        lastWriteTime = (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+        return true;
+    }
+
+    // Calls `visit(const Entry&)` for every entry except "." and "..". Entry names
+    // point into the batch buffer and are only valid during the call.
+    template<class F>
+    bool forEach(F&& visit) {
+        if (!isOpen()) return false;
+        std::vector<LONGLONG> buffer(BUFFER_SIZE / sizeof(LONGLONG));
+        while (GetFileInformationByHandleEx(handle, FileIdBothDirectoryInfo, buffer.data(), BUFFER_SIZE)) {
+            const char* record = reinterpret_cast<const char*>(buffer.data());
+            while (true) {
+                auto* info = reinterpret_cast<const FILE_ID_BOTH_DIR_INFO*>(record);
+                size_t length = info->FileNameLength / sizeof(WCHAR);
+                bool dots = info->FileName[0] == L'.' &&
+                            (length == 1 || (length == 2 && info->FileName[1] == L'.'));
+                if (!dots) {
+                    visit(Entry{info->FileName, length, info->FileAttributes,
+                                static_cast<uint64_t>(info->EndOfFile.QuadPart),
+                                static_cast<uint64_t>(info->AllocationSize.QuadPart),
+                                static_cast<uint64_t>(info->CreationTime.QuadPart),
+                                static_cast<uint64_t>(info->LastWriteTime.QuadPart),
+                                static_cast<uint64_t>(info->FileId.QuadPart)});
+                }
+                if (info->NextEntryOffset == 0) break;
+                record += info->NextEntryOffset;
+            }
+        }
+        lastError = GetLastError();
+        return lastError == ERROR_NO_MORE_FILES;
+    }
+
+private:
+    static constexpr DWORD BUFFER_SIZE = 128 * 1024;
+
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    DWORD lastError = 0;
+};
+
+// Overlapped ReadDirectoryChangesW on a single directory handle. With `recursive` the
+// kernel reports the whole subtree through that one handle, so trees with tens of
+// thousands of directories need neither a watch per directory nor a rescan. Two
+// buffers alternate: the next read is queued before the finished one is parsed, so
+// changes arriving while events are handled are not lost.
+class DirectoryWatcher {
+public:
+    DirectoryWatcher(const fs::path& dir, bool recursive, DWORD filter) : recursive(recursive), filter(filter) {
+        handle = CreateFileW(dir.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                             nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) return;
+        overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        for (auto& buffer : buffers) buffer.resize(BUFFER_SIZE / sizeof(DWORD));
+        if (!overlapped.hEvent || !arm()) close();
+    }
+
+    ~DirectoryWatcher() {
+        close();
+    }
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    bool isOpen() const { return handle != INVALID_HANDLE_VALUE; }
+    HANDLE event() const { return overlapped.hEvent; }
+
+    // Call once event() is signaled. Passes every change as (name, length, action)
+    // with the name relative to the watched directory. `overflow` is set when the
+    // kernel had to drop changes because the buffer was full. Returns false if the
+    // watch itself failed, e.g. because the directory was deleted.
+    template<class F>
+    bool collect(F&& visit, bool& overflow) {
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(handle, &overlapped, &bytes, FALSE)) {
+            if (GetLastError() != ERROR_NOTIFY_ENUM_DIR) return false;
+            bytes = 0;
+        }
+        pending = false;
+        const char* completed = reinterpret_cast<const char*>(buffers[current].data());
+        current ^= 1;
+        if (!arm()) return false;
+
+        overflow = bytes == 0;
+        for (size_t pos = 0; bytes > 0;) {
+            auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(completed + pos);
+            visit(info->FileName, info->FileNameLength / sizeof(WCHAR), info->Action);
+            if (info->NextEntryOffset == 0) break;
+            pos += info->NextEntryOffset;
+        }
+        return true;
+    }
+
+private:
+    // 64 KB is the largest buffer ReadDirectoryChangesW accepts for network shares.
+    static constexpr DWORD BUFFER_SIZE = 64 * 1024;
+
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    OVERLAPPED overlapped{};
+    std::vector<DWORD> buffers[2];
+    int current = 0;
+    bool pending = false;
+    bool recursive;
+    DWORD filter;
+
+    bool arm() {
+        ResetEvent(overlapped.hEvent);
+        pending = ReadDirectoryChangesW(handle, buffers[current].data(), BUFFER_SIZE, recursive, filter,
+                                        nullptr, &overlapped, nullptr) != FALSE;
+        return pending;
+    }
+
+    void close() {
+        if (pending) {
+            // The kernel writes into the buffer until the cancelled read completes.
+            CancelIo(handle);
+            DWORD bytes = 0;
+            GetOverlappedResult(handle, &overlapped, &bytes, TRUE);
+            pending = false;
+        }
+        if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+        if (overlapped.hEvent) CloseHandle(overlapped.hEvent);
+        handle = INVALID_HANDLE_VALUE;
+        overlapped.hEvent = nullptr;
+    }
+};
+
 class CommandResult {
 public:
     enum class Status {
@@ -88,6 +418,7 @@ public:
                 std::cout << std::left << std::setw(15) << name << " - " << description << "\n";
             }
             std::cout << "\nFuer detaillierte Informationen zu einem Befehl, geben Sie 'help <Befehlsname>' ein.\n";
+            std::cout << "Mit '<Befehl> | less' erscheinen Ausgabe und Fehlermeldungen im Pager; Vollbildansichten wie top und edit werden nicht erfasst.\n";
             return CommandResult(CommandResult::Status::Success, "Displayed available commands");
         } else {
             const std::string& commandName = args[0];
@@ -126,14 +457,16 @@ private:
             {"alias", "Zeigt alle definierten Aliase an. Verwendung: alias"},
             {"setalias", "Erstellt ein neues Alias. Verwendung: setalias <Aliasname> <Befehl>"},
             {"create", "Erstellt eine neue Datei. Verwendung: create <Dateiname>"},
-            {"delete", "Loescht eine Datei. Verwendung: delete <Dateiname>"},
-            {"list", "Listet Dateien im aktuellen Verzeichnis auf. Verwendung: list"},
+            {"delete", "Loescht eine Datei, mit -r parallel einen ganzen Verzeichnisbaum (--dry-run zaehlt nur). Verwendung: delete <Pfad> [-r] [--dry-run]"},
+            {"copy", "Kopiert Dateien und Verzeichnisbaeume parallel. Verwendung: copy <Quelle> <Ziel> [--force]"},
+            {"move", "Verschiebt Dateien und Verzeichnisse. Verwendung: move <Quelle> <Ziel> [--force]"},
+            {"list", "Listet Dateien eines Verzeichnisses auf (-l: Details, -a: versteckte Dateien, -r: umgekehrt). Verwendung: list [Pfad] [-l] [-a] [--sort name|size|time|none] [-r]"},
             {"ping", "Sendet ICMP-Echo-Anforderungen an einen Host. Verwendung: ping <Hostname oder IP>"},
-            {"random", "Generiert eine Zufallszahl zwischen 1 und 100. Verwendung: random"},
+            {"random", "Erzeugt Zufallszahlen oder Zufallsdaten, reproduzierbar ueber --seed. Verwendung: random [--count N] [--range a b] [--seed s] [--out Datei] | random --bytes N --out Datei [--seed s]"},
             {"sleep", "Pausiert die Ausfuehrung fuer eine bestimmte Zeit. Verwendung: sleep <Sekunden>"},
             {"theme", "Aendert das Farbschema des Terminals. Verwendung: theme"},
             {"writefile", "Schreibt Text in eine Datei. Verwendung: writefile <Dateiname> <Text>"},
-            {"readfile", "Liest den Inhalt einer Datei. Verwendung: readfile <Dateiname>"},
+            {"readfile", "Liest den Inhalt einer Datei. Verwendung: readfile <Dateiname> [--head N | --tail N] [--follow] [--page]"},
             {"encrypt", "Verschluesselt eine Datei. Verwendung: encrypt <Eingabedatei> <Ausgabedatei>"},
             {"decrypt", "Entschluesselt eine Datei. Verwendung: decrypt <Eingabedatei> <Ausgabedatei>"},
             {"compress", "Komprimiert eine Datei. Verwendung: compress <Eingabedatei> <Ausgabedatei>"},
@@ -142,13 +475,20 @@ private:
             {"schedule", "Plant die Ausfuehrung eines Befehls. Verwendung: schedule <Verzoegerung in Sekunden> <Befehl>"},
             {"task", "Verwaltet Hintergrundaufgaben. Verwendung: task <start|stop|list> [Befehl]"},
             {"network", "Zeigt Netzwerkinformationen an. Verwendung: network"},
-            {"sysinfo", "Zeigt Systeminformationen an. Verwendung: sysinfo"},
+            {"ps", "Listet alle Prozesse mit Speicher und CPU-Zeit auf, sortiert und gefiltert nach Name oder PID. Verwendung: ps [--sort pid|name|cpu|mem] [--filter Text]"},
+            {"top", "Zeigt die Prozesse laufend aktualisiert mit CPU-Auslastung an; c/m/p/n waehlen die Sortierung, q beendet. Verwendung: top [--sort cpu|mem|pid|name] [--interval ms]"},
+            {"kill", "Beendet einen Prozess. Verwendung: kill <PID>"},
+            {"du", "Zeigt belegten und tatsaechlichen Speicher eines Verzeichnisbaums und die groessten Eintraege. Verwendung: du [Pfad] [--depth N] [--top K] [--refresh]"},
+            {"dupes", "Findet doppelte Dateien ueber Groesse, Teil-Hash und vollen Hash und ersetzt sie auf Wunsch durch Links. Verwendung: dupes [Pfad] [--min-size N] [--link hard|clone] [--refresh]"},
+            {"agg", "Berechnet Anzahl, Summe, Minimum, Maximum, Mittelwert und Perzentile einer Spalte einer CSV-/TSV-Datei, optional je Gruppe. Verwendung: agg <Datei> <Spalte> [--group-by Spalte] [--sep c]"},
+            {"watch", "Beobachtet eine Datei oder ein Verzeichnis und fuehrt bei Aenderungen einen Befehl aus; {} wird durch jeden geaenderten Pfad ersetzt. Verwendung: watch <Pfad> [--recursive] [--debounce ms] -- <Befehl>"},
+            {"sysinfo", "Zeigt Systeminformationen an. Verwendung: sysinfo [--interval <ms>]"},
             {"weather", "Zeigt Wetterinformationen fuer eine Stadt an. Verwendung: weather <Stadt>"},
-            {"math", "Fuehrt einfache mathematische Operationen durch. Verwendung: math <Zahl1> <Operator> <Zahl2>"},
-            {"sort", "Sortiert eine Liste von Elementen. Verwendung: sort <Element1> <Element2> ..."},
-            {"base64", "Kodiert oder dekodiert Text in Base64. Verwendung: base64 <encode|decode> <Text>"},
-            {"hash", "Berechnet den Hash-Wert eines Textes. Verwendung: hash <Text>"},
-            {"edit", "Oeffnet einen einfachen Texteditor. Verwendung: edit <dateiname>"},
+            {"math", "Berechnet Ausdruecke mit + - * / % ^, Klammern, Funktionen (sin, sqrt, log, min, ...) und Variablen (name = Ausdruck); --over wertet den Ausdruck fuer jede Zahl einer Dateispalte als x aus. Verwendung: math <Ausdruck> | math <Name> = <Ausdruck> | math --over <Datei> <Ausdruck> [--col N] [--sep c]"},
+            {"sort", "Sortiert Elemente oder die Zeilen einer Datei beliebiger Groesse. Verwendung: sort [-n] [-u] <Element1> <Element2> ... | sort --file <Datei> [--out Datei] [-k Spalte] [-n] [-u] [--memory MB] [--temp Verzeichnis]"},
+            {"base64", "Kodiert oder dekodiert Text oder Dateien in Base64. Verwendung: base64 <encode|decode> <Text> | base64 <encode|decode> --file <Eingabedatei> <Ausgabedatei>"},
+            {"hash", "Berechnet xxh3-, sha256- oder blake3-Pruefsummen von Text oder Dateien. Verwendung: hash <Text> | hash --file <Pfad> [--algo xxh3|sha256|blake3]"},
+            {"edit", "Oeffnet einen einfachen Texteditor mit den Befehlen add, edit <zeilennummer>, delete <zeilennummer>, goto <zeilennummer>, find <text>, next, replace <alt> [neu] [all], undo, redo, save und quit. Verwendung: edit <dateiname>"},
             {"exit", "Beendet das Terminal. Verwendung: exit"}
         };
     }
@@ -189,219 +529,6668 @@ private:
     std::atomic<bool> shouldStop{false};
 };
 
-class SimpleTextEditor {
+// Newline positions of a byte buffer, kept as a running count per 64 KB block.
+// Counting the newlines before an offset or finding the n-th newline is a binary
+// search over the blocks plus a scan of at most one block, and the whole index is
+// 1/8192 of the buffer size instead of one offset per line.
+class LineIndex {
+public:
+    // Indexes data[size(), newSize); everything before is assumed unchanged.
+    void extend(const char* data, uint64_t newSize) {
+        while (length < newSize) {
+            if (length % BLOCK == 0) before.push_back(total);
+            uint64_t end = std::min(newSize, (length / BLOCK + 1) * BLOCK);
+            total += countBreaks(data + length, static_cast<size_t>(end - length));
+            length = end;
+        }
+    }
+
+    // Recounts data[from, to) after it was overwritten in place. Only the blocks in
+    // the range are scanned; later blocks just shift by the difference.
+    void refresh(const char* data, uint64_t from, uint64_t to) {
+        to = std::min(to, length);
+        if (from >= to) return;
+        size_t first = static_cast<size_t>(from / BLOCK);
+        size_t last = static_cast<size_t>((to - 1) / BLOCK);
+        std::vector<uint64_t> counts;
+        uint64_t oldSum = (last + 1 < before.size() ? before[last + 1] : total) - before[first];
+        uint64_t newSum = 0;
+        for (size_t block = first; block <= last; ++block) {
+            uint64_t begin = block * BLOCK;
+            counts.push_back(countBreaks(data + begin, static_cast<size_t>(std::min(length, begin + BLOCK) - begin)));
+            newSum += counts.back();
+        }
+        for (size_t block = first + 1; block <= last; ++block) before[block] = before[block - 1] + counts[block - first - 1];
+        for (size_t block = last + 1; block < before.size(); ++block) before[block] = before[block] - oldSum + newSum;
+        total = total - oldSum + newSum;
+    }
+
+    uint64_t size() const { return length; }
+    uint64_t breaks() const { return total; }
+
+    // Newlines in data[0, offset).
+    uint64_t rank(const char* data, uint64_t offset) const {
+        uint64_t block = offset / BLOCK;
+        if (block >= before.size()) return total;
+        return before[block] + countBreaks(data + block * BLOCK, static_cast<size_t>(offset - block * BLOCK));
+    }
+
+    // Offset of the newline with zero-based number `n`, which must be below breaks().
+    uint64_t select(const char* data, uint64_t n) const {
+        size_t block = static_cast<size_t>(std::upper_bound(before.begin(), before.end(), n) - before.begin() - 1);
+        uint64_t remaining = n - before[block];
+        const char* start = data + block * BLOCK;
+        const char* end = data + std::min(length, (block + 1) * BLOCK);
+        const char* p = start;
+        const __m128i newline = _mm_set1_epi8('\n');
+        for (; p + 16 <= end; p += 16) {
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), newline));
+            size_t count = std::bitset<16>(static_cast<unsigned>(mask)).count();
+            if (remaining < count) break;
+            remaining -= count;
+        }
+        for (;; ++p) {
+            if (*p == '\n' && remaining-- == 0) return static_cast<uint64_t>(p - data);
+        }
+    }
+
+    static uint64_t countBreaks(const char* data, size_t size) {
+        uint64_t count = 0;
+        size_t i = 0;
+        const __m128i newline = _mm_set1_epi8('\n');
+        for (; i + 16 <= size; i += 16) {
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), newline));
+            count += std::bitset<16>(static_cast<unsigned>(mask)).count();
+        }
+        for (; i < size; ++i) count += data[i] == '\n';
+        return count;
+    }
+
 private:
-    std::vector<std::string> lines;
-    std::string filename;
+    static constexpr uint64_t BLOCK = 64 * 1024;
+
+    std::vector<uint64_t> before;
+    uint64_t length = 0;
+    uint64_t total = 0;
+};
 
+// Substring search for the editor. For needles up to 16 bytes an SSE2 compare of the
+// needle's first and last byte against 16 positions at once yields the candidates,
+// which memcmp then verifies; longer needles use Horspool's bad-character shifts,
+// which skip ahead by up to the needle length per step.
+class ByteSearch {
 public:
-    SimpleTextEditor(const std::string& fname) : filename(fname) {
-        std::ifstream file(filename);
-        std::string line;
-        while (std::getline(file, line)) {
-            lines.push_back(line);
+    explicit ByteSearch(std::string_view pattern) : needle(pattern) {
+        shift.fill(needle.size());
+        for (size_t i = 0; i + 1 < needle.size(); ++i) shift[static_cast<uint8_t>(needle[i])] = needle.size() - 1 - i;
+    }
+
+    size_t size() const { return needle.size(); }
+
+    // Position of the first match in data[0, size).
+    std::optional<size_t> find(const char* data, size_t size) const {
+        if (needle.empty() || size < needle.size()) return std::nullopt;
+        return needle.size() > FILTER_MAX ? horspool(data, size) : filtered(data, size);
+    }
+
+private:
+    static constexpr size_t FILTER_MAX = 16;
+
+    std::string needle;
+    std::array<size_t, 256> shift;
+
+    std::optional<size_t> filtered(const char* data, size_t size) const {
+        size_t m = needle.size();
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i last = _mm_set1_epi8(needle[m - 1]);
+        size_t i = 0;
+        for (; i + m - 1 + 16 <= size; i += 16) {
+            __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + m - 1));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))));
+            for (size_t bit = 0; mask != 0; ++bit, mask >>= 1) {
+                if ((mask & 1) && (m <= 2 || std::memcmp(data + i + bit + 1, needle.data() + 1, m - 2) == 0)) {
+                    return i + bit;
+                }
+            }
         }
+        for (; i + m <= size; ++i) {
+            if (data[i] == needle[0] && std::memcmp(data + i, needle.data(), m) == 0) return i;
+        }
+        return std::nullopt;
     }
 
-    void display() {
-        for (size_t i = 0; i < lines.size(); ++i) {
-            std::cout << i + 1 << ": " << lines[i] << std::endl;
+    std::optional<size_t> horspool(const char* data, size_t size) const {
+        size_t m = needle.size();
+        char last = needle[m - 1];
+        for (size_t i = 0; i + m <= size;) {
+            char c = data[i + m - 1];
+            if (c == last && std::memcmp(data + i, needle.data(), m - 1) == 0) return i;
+            i += shift[static_cast<uint8_t>(c)];
         }
+        return std::nullopt;
     }
+};
 
-    void addLine(const std::string& line) {
-        lines.push_back(line);
+// Editable text as a piece table: a treap of (buffer, start, length) pieces over the
+// read-only mapped original and an append-only add buffer, where each subtree knows
+// its byte and newline totals. Nodes are immutable and shared between versions, so
+// an edit allocates only the O(log n) nodes on one path and leaves the previous root
+// a valid snapshot. Opening only maps the file; the newline index of the original is
+// built in the background and waited for on the first edit.
+class PieceTable {
+public:
+    enum class Source : uint8_t { Original, Add };
+
+    struct Piece {
+        Source source;
+        uint64_t start;
+        uint64_t length;
+        uint64_t breaks;
+    };
+
+    PieceTable() = default;
+    PieceTable(const PieceTable&) = delete;
+    PieceTable& operator=(const PieceTable&) = delete;
+
+    ~PieceTable() {
+        if (indexing.valid()) indexing.wait();
     }
 
-    void editLine(size_t lineNumber, const std::string& newContent) {
-        if (lineNumber > 0 && lineNumber <= lines.size()) {
-            lines[lineNumber - 1] = newContent;
+    // Maps `path` as the new original; a missing file opens as an empty document.
+    bool open(const fs::path& path) {
+        if (indexing.valid()) indexing.wait();
+        root.reset();
+        clearHistory();
+        addBuffer.clear();
+        addIndex = LineIndex();
+        originalIndex = LineIndex();
+        std::error_code ec;
+        if (fs::exists(path, ec) && !original.open(path)) return false;
+        if (original.size() == 0) {
+            indexed = true;
+            return true;
         }
+        indexed = false;
+        indexing = std::async(std::launch::async, [this] { originalIndex.extend(original.data(), original.size()); });
+        return true;
     }
 
-    void deleteLine(size_t lineNumber) {
-        if (lineNumber > 0 && lineNumber <= lines.size()) {
-            lines.erase(lines.begin() + lineNumber - 1);
+    // Unmaps the original while keeping all pieces. Nothing may be read until
+    // remap() maps the same, unchanged file again.
+    void release() {
+        if (indexing.valid()) indexing.wait();
+        original.close();
+    }
+
+    bool remap(const fs::path& path) {
+        return original.open(path);
+    }
+
+    // Document ranges that differ from the file, provided every piece of the original
+    // still sits at its old offset and nothing was cut from the end; then writing
+    // just these ranges into the file turns it into the document. Otherwise text of
+    // the original has moved and only a full rewrite works.
+    std::optional<std::vector<std::pair<uint64_t, uint64_t>>> changedRanges() {
+        std::vector<std::pair<uint64_t, uint64_t>> ranges;
+        if (!indexed && !lineCountKnown()) return ranges;
+        ensureIndexed();
+        if (!original.isOpen() || size() < original.size()) return std::nullopt;
+        bool inPlace = true;
+        forEachPiece(root.get(), 0, [&](uint64_t offset, const Piece& piece) {
+            if (piece.source == Source::Original) {
+                inPlace = inPlace && piece.start == offset;
+            } else if (!ranges.empty() && ranges.back().first + ranges.back().second == offset) {
+                ranges.back().second += piece.length;
+            } else {
+                ranges.emplace_back(offset, piece.length);
+            }
+        });
+        if (!inPlace) return std::nullopt;
+        return ranges;
+    }
+
+    // Adopts `path` as the original after `ranges` were written into it in place.
+    // The newline index is updated for those ranges instead of being rebuilt.
+    bool commitInPlace(const fs::path& path, const std::vector<std::pair<uint64_t, uint64_t>>& ranges) {
+        original.close();
+        if (!original.open(path)) return false;
+        for (const auto& [offset, count] : ranges) originalIndex.refresh(original.data(), offset, offset + count);
+        originalIndex.extend(original.data(), original.size());
+        addBuffer.clear();
+        addIndex = LineIndex();
+        clearHistory();
+        root = original.size() == 0 ? nullptr
+             : makeNode(Piece{Source::Original, 0, original.size(), originalIndex.breaks()}, nextPriority(), nullptr, nullptr);
+        return true;
+    }
+
+    uint64_t size() const { return indexed ? length(root) : original.size(); }
+
+    bool lineCountKnown() const {
+        return indexed || indexing.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // Number of lines; a last line without a newline counts as well.
+    uint64_t lineCount() {
+        ensureIndexed();
+        uint64_t total = size();
+        return breaks(root) + (total > 0 && byteAt(total - 1) != '\n' ? 1 : 0);
+    }
+
+    // Offset of the first byte of zero-based line `line`, or size() past the end.
+    uint64_t lineStart(uint64_t line) {
+        if (line == 0) return 0;
+        if (!indexed && !lineCountKnown()) {
+            // Until the index is ready the document is still the original, and a
+            // viewport near the top is found faster by scanning than by waiting.
+            const char* data = original.data();
+            const char* end = data + original.size();
+            const char* p = data;
+            while (line > 0 && p < end) {
+                p = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+                if (!p) return original.size();
+                ++p;
+                --line;
+            }
+            return static_cast<uint64_t>(p - data);
         }
+        ensureIndexed();
+        if (line > breaks(root)) return size();
+        return findBreak(line - 1) + 1;
     }
 
-    void save() {
-        std::ofstream file(filename);
-        for (const auto& line : lines) {
-            file << line << std::endl;
+    // Calls `visit(const char*, size_t)` for each contiguous span of [offset, offset + count).
+    template<class F>
+    void forEachSpan(uint64_t offset, uint64_t count, F&& visit) {
+        if (!indexed && !lineCountKnown()) {
+            uint64_t end = std::min(original.size(), offset + count);
+            if (offset < end) visit(original.data() + offset, static_cast<size_t>(end - offset));
+            return;
         }
+        ensureIndexed();
+        spans(root.get(), 0, offset, std::min(size(), offset + count), visit);
+    }
+
+    // Offset just past the first newline at or after `offset`, or size() if none.
+    uint64_t nextLine(uint64_t offset) {
+        uint64_t total = size();
+        while (offset < total) {
+            std::optional<uint64_t> found;
+            uint64_t position = offset;
+            forEachSpan(offset, SCAN_WINDOW, [&](const char* data, size_t size) {
+                if (found) return;
+                if (auto* p = static_cast<const char*>(std::memchr(data, '\n', size))) found = position + (p - data) + 1;
+                position += size;
+            });
+            if (found) return *found;
+            offset = position;
+        }
+        return total;
+    }
+
+    std::string text(uint64_t offset, uint64_t count) {
+        std::string result;
+        forEachSpan(offset, count, [&](const char* data, size_t size) { result.append(data, size); });
+        return result;
+    }
+
+    char byteAt(uint64_t offset) {
+        char value = 0;
+        forEachSpan(offset, 1, [&](const char* data, size_t) { value = *data; });
+        return value;
+    }
+
+    // Calls `visit(offset)` for each non-overlapping match at or after `from` until it
+    // returns false. The document is scanned in 1 MB windows that overlap by the
+    // needle length, so matches across piece and line boundaries are found too.
+    template<class F>
+    void forEachMatch(std::string_view needle, uint64_t from, F&& visit) {
+        ByteSearch search(needle);
+        size_t m = needle.size();
+        uint64_t total = size();
+        std::string scratch;
+        for (uint64_t pos = from; m > 0 && pos + m <= total;) {
+            uint64_t windowEnd = std::min(total, pos + SEARCH_WINDOW + m - 1);
+            const char* window = contiguous(pos, windowEnd - pos, scratch);
+            uint64_t next = windowEnd - m + 1;
+            for (uint64_t at = pos; at + m <= windowEnd;) {
+                auto hit = search.find(window + (at - pos), static_cast<size_t>(windowEnd - at));
+                if (!hit) break;
+                uint64_t offset = at + *hit;
+                if (!visit(offset)) return;
+                at = offset + m;
+                next = std::max(next, at);
+            }
+            pos = next;
+        }
+    }
+
+    std::optional<uint64_t> find(std::string_view needle, uint64_t from) {
+        std::optional<uint64_t> found;
+        forEachMatch(needle, from, [&](uint64_t offset) {
+            found = offset;
+            return false;
+        });
+        return found;
+    }
+
+    // Zero-based line containing `offset`.
+    uint64_t lineOf(uint64_t offset) {
+        ensureIndexed();
+        uint64_t lines = 0;
+        const Node* node = root.get();
+        while (node) {
+            uint64_t leftLength = length(node->left);
+            if (offset < leftLength) {
+                node = node->left.get();
+                continue;
+            }
+            lines += breaks(node->left);
+            offset -= leftLength;
+            const Piece& piece = node->piece;
+            if (offset < piece.length) {
+                const LineIndex& lineIndex = index(piece.source);
+                const char* base = data(piece.source);
+                return lines + lineIndex.rank(base, piece.start + offset) - lineIndex.rank(base, piece.start);
+            }
+            lines += piece.breaks;
+            offset -= piece.length;
+            node = node->right.get();
+        }
+        return lines;
+    }
+
+    // Replaces every non-overlapping match in one pass. The replacement is stored once
+    // and shared by all matches, and the new tree is built from the resulting piece
+    // list directly instead of through one split and merge per match.
+    size_t replaceAll(std::string_view needle, std::string_view replacement) {
+        std::vector<uint64_t> matches;
+        forEachMatch(needle, 0, [&](uint64_t offset) {
+            matches.push_back(offset);
+            return true;
+        });
+        if (matches.empty()) return 0;
+        ensureIndexed();
+
+        uint64_t total = size();
+        size_t m = needle.size();
+        auto keepBegin = [&](size_t range) { return range == 0 ? 0 : matches[range - 1] + m; };
+        auto keepEnd = [&](size_t range) { return range < matches.size() ? matches[range] : total; };
+        std::optional<Piece> inserted;
+        if (!replacement.empty()) inserted = append(replacement);
+
+        std::vector<Piece> pieces;
+        size_t range = 0;
+        forEachPiece(root.get(), 0, [&](uint64_t offset, const Piece& piece) {
+            uint64_t end = offset + piece.length;
+            while (range <= matches.size()) {
+                uint64_t from = std::max(offset, keepBegin(range));
+                uint64_t to = std::min(end, keepEnd(range));
+                if (from < to) pieces.push_back(cut(piece, from - offset, to - from));
+                if (keepEnd(range) > end) break;
+                if (range < matches.size() && inserted) pieces.push_back(*inserted);
+                ++range;
+                if (range <= matches.size() && keepBegin(range) >= end) break;
+            }
+        });
+        Tree replaced = build(pieces);
+        record(0, root, replaced);
+        root = replaced;
+        return matches.size();
+    }
+
+    void insert(uint64_t offset, std::string_view text) {
+        if (text.empty()) return;
+        ensureIndexed();
+        Piece piece = append(text);
+        Tree inserted = makeNode(piece, nextPriority(), nullptr, nullptr);
+        auto [left, right] = split(root, offset);
+        root = merge(merge(left, inserted), right);
+        record(offset, nullptr, inserted);
+    }
+
+    void erase(uint64_t offset, uint64_t count) {
+        if (count == 0) return;
+        ensureIndexed();
+        auto [left, rest] = split(root, offset);
+        auto [removed, right] = split(rest, count);
+        root = merge(left, right);
+        record(offset, removed, nullptr);
+    }
+
+    // Ends the current undo step; edits made after it are undone separately.
+    void checkpoint() { stepOpen = false; }
+
+    // Reverts the last step and returns the offset it started at. Each edit keeps the
+    // subtrees it took out of and put into the tree, which share their nodes and the
+    // buffer text with the document, so undoing an edit of any size is one split and
+    // merge no matter how much text it covered.
+    std::optional<uint64_t> undo() {
+        if (undoSteps.empty()) return std::nullopt;
+        Step step = std::move(undoSteps.back());
+        undoSteps.pop_back();
+        historyPieces -= step.pieces;
+        stepOpen = false;
+        for (auto edit = step.edits.rbegin(); edit != step.edits.rend(); ++edit) {
+            root = exchange(root, edit->offset, length(edit->inserted), edit->removed);
+        }
+        uint64_t offset = step.edits.front().offset;
+        redoSteps.push_back(std::move(step));
+        return offset;
+    }
+
+    std::optional<uint64_t> redo() {
+        if (redoSteps.empty()) return std::nullopt;
+        Step step = std::move(redoSteps.back());
+        redoSteps.pop_back();
+        for (const Edit& edit : step.edits) {
+            root = exchange(root, edit.offset, length(edit.removed), edit.inserted);
+        }
+        uint64_t offset = step.edits.front().offset;
+        historyPieces += step.pieces;
+        undoSteps.push_back(std::move(step));
+        return offset;
     }
-};
 
-class EditCommand : public Command {
 private:
-    Terminal& terminal;
+    struct Node;
+    using Tree = std::shared_ptr<const Node>;
+
+    struct Node {
+        Piece piece;
+        uint32_t priority;
+        Tree left;
+        Tree right;
+        uint64_t length;
+        uint64_t breaks;
+        uint64_t count;
+    };
 
-public:
-    EditCommand(Terminal& t) : terminal(t) {}
+    // At `offset` the document held `removed` before the edit and holds `inserted`
+    // after it; either may be empty.
+    struct Edit {
+        uint64_t offset;
+        Tree removed;
+        Tree inserted;
+    };
 
-    CommandResult execute(const std::vector<std::string>& args) override {
-        if (!validateArgs(args)) {
-            return CommandResult(CommandResult::Status::Error, "Invalid arguments");
+    struct Step {
+        std::vector<Edit> edits;
+        uint64_t pieces = 0;
+    };
+
+    static constexpr uint64_t SCAN_WINDOW = 64 * 1024;
+    static constexpr uint64_t SEARCH_WINDOW = 1024 * 1024;
+    // Undo history budget in pieces (about 100 bytes each); the oldest steps go first.
+    static constexpr uint64_t HISTORY_PIECES = 1024 * 1024;
+
+    MappedFile original;
+    LineIndex originalIndex;
+    std::string addBuffer;
+    LineIndex addIndex;
+    std::future<void> indexing;
+    bool indexed = true;
+    Tree root;
+    std::mt19937 random{std::random_device{}()};
+    std::deque<Step> undoSteps;
+    std::vector<Step> redoSteps;
+    uint64_t historyPieces = 0;
+    bool stepOpen = false;
+
+    static uint64_t length(const Tree& tree) { return tree ? tree->length : 0; }
+    static uint64_t breaks(const Tree& tree) { return tree ? tree->breaks : 0; }
+    static uint64_t count(const Tree& tree) { return tree ? tree->count : 0; }
+
+    uint32_t nextPriority() { return static_cast<uint32_t>(random()); }
+
+    const char* data(Source source) const {
+        return source == Source::Original ? original.data() : addBuffer.data();
+    }
+
+    const LineIndex& index(Source source) const {
+        return source == Source::Original ? originalIndex : addIndex;
+    }
+
+    void ensureIndexed() {
+        if (indexed) return;
+        indexing.get();
+        indexed = true;
+        Piece whole{Source::Original, 0, original.size(), originalIndex.breaks()};
+        root = makeNode(whole, nextPriority(), nullptr, nullptr);
+    }
+
+    Piece append(std::string_view text) {
+        Piece piece{Source::Add, addBuffer.size(), text.size(), 0};
+        addBuffer.append(text);
+        uint64_t before = addIndex.breaks();
+        addIndex.extend(addBuffer.data(), addBuffer.size());
+        piece.breaks = addIndex.breaks() - before;
+        return piece;
+    }
+
+    static Tree makeNode(const Piece& piece, uint32_t priority, Tree left, Tree right) {
+        uint64_t bytes = length(left) + piece.length + length(right);
+        uint64_t lines = breaks(left) + piece.breaks + breaks(right);
+        uint64_t pieces = count(left) + 1 + count(right);
+        return std::make_shared<const Node>(Node{piece, priority, std::move(left), std::move(right), bytes, lines, pieces});
+    }
+
+    Piece slice(const Piece& piece, uint64_t from, uint64_t count) const {
+        const LineIndex& lines = index(piece.source);
+        const char* base = data(piece.source);
+        uint64_t start = piece.start + from;
+        return Piece{piece.source, start, count, lines.rank(base, start + count) - lines.rank(base, start)};
+    }
+
+    // Part of a piece whose newlines are counted directly; used where the bytes are
+    // visited once anyway, so the total work stays linear in the document size.
+    Piece cut(const Piece& piece, uint64_t from, uint64_t count) const {
+        if (from == 0 && count == piece.length) return piece;
+        uint64_t start = piece.start + from;
+        return Piece{piece.source, start, count, LineIndex::countBreaks(data(piece.source) + start, static_cast<size_t>(count))};
+    }
+
+    // Balanced tree over `pieces` in order. Random priorities are sorted and handed
+    // out level by level, so every parent outranks its children.
+    Tree build(const std::vector<Piece>& pieces) {
+        std::vector<uint32_t> priorities(pieces.size());
+        for (auto& priority : priorities) priority = nextPriority();
+        std::sort(priorities.begin(), priorities.end(), std::greater<uint32_t>());
+        std::vector<uint32_t> assigned(pieces.size());
+        std::deque<std::pair<size_t, size_t>> ranges{{0, pieces.size()}};
+        for (size_t next = 0; !ranges.empty(); ranges.pop_front()) {
+            auto [low, high] = ranges.front();
+            if (low >= high) continue;
+            size_t middle = low + (high - low) / 2;
+            assigned[middle] = priorities[next++];
+            ranges.emplace_back(low, middle);
+            ranges.emplace_back(middle + 1, high);
         }
-        SimpleTextEditor editor(args[0]);
-        std::string command;
+        return buildRange(pieces, assigned, 0, pieces.size());
+    }
 
-        while (true) {
-            editor.display();
-            std::cout << "\nEditor-Befehle: add, edit <zeilennummer>, delete <zeilennummer>, save, quit\n";
-            std::cout << "Befehl: ";
-            std::getline(std::cin, command);
+    static Tree buildRange(const std::vector<Piece>& pieces, const std::vector<uint32_t>& priorities, size_t low, size_t high) {
+        if (low >= high) return nullptr;
+        size_t middle = low + (high - low) / 2;
+        return makeNode(pieces[middle], priorities[middle], buildRange(pieces, priorities, low, middle),
+                        buildRange(pieces, priorities, middle + 1, high));
+    }
 
-            std::istringstream iss(command);
-            std::vector<std::string> tokens;
-            std::string token;
-            while (iss >> token) {
-                tokens.push_back(token);
+    // Pointer to [offset, offset + count) if it lies within one piece, otherwise to a
+    // copy of it in `scratch`.
+    const char* contiguous(uint64_t offset, uint64_t count, std::string& scratch) {
+        const char* first = nullptr;
+        size_t spanCount = 0;
+        forEachSpan(offset, count, [&](const char* data, size_t) {
+            if (spanCount++ == 0) first = data;
+        });
+        if (spanCount == 1) return first;
+        scratch.clear();
+        forEachSpan(offset, count, [&](const char* data, size_t size) { scratch.append(data, size); });
+        return scratch.data();
+    }
+
+    // `tree` with the `length` bytes at `offset` replaced by `replacement`.
+    Tree exchange(const Tree& tree, uint64_t offset, uint64_t length, const Tree& replacement) {
+        auto [left, rest] = split(tree, offset);
+        auto [removed, right] = split(rest, length);
+        return merge(merge(left, replacement), right);
+    }
+
+    // Adds an edit to the open undo step. An insert right behind the step's last
+    // insert, or right where it erased, extends that edit instead of adding one.
+    // Inserted subtrees are part of the document, so only the removed ones count
+    // against the history budget.
+    void record(uint64_t offset, Tree removed, Tree inserted) {
+        redoSteps.clear();
+        if (!stepOpen || undoSteps.empty()) {
+            undoSteps.emplace_back();
+            stepOpen = true;
+        }
+        Step& step = undoSteps.back();
+        Edit* last = step.edits.empty() ? nullptr : &step.edits.back();
+        if (last && !removed && last->offset + length(last->inserted) == offset) {
+            last->inserted = merge(last->inserted, inserted);
+        } else {
+            uint64_t pieces = count(removed) + 1;
+            step.pieces += pieces;
+            historyPieces += pieces;
+            step.edits.push_back(Edit{offset, std::move(removed), std::move(inserted)});
+        }
+        while (historyPieces > HISTORY_PIECES && !undoSteps.empty()) {
+            historyPieces -= undoSteps.front().pieces;
+            undoSteps.pop_front();
+            stepOpen = stepOpen && !undoSteps.empty();
+        }
+    }
+
+    // Saving changes what the original and the add buffer hold, which recorded
+    // pieces point into, so the history ends there.
+    void clearHistory() {
+        undoSteps.clear();
+        redoSteps.clear();
+        historyPieces = 0;
+        stepOpen = false;
+    }
+
+    std::pair<Tree, Tree> split(const Tree& tree, uint64_t offset) {
+        if (!tree) return {nullptr, nullptr};
+        uint64_t leftLength = length(tree->left);
+        if (offset <= leftLength) {
+            auto [left, right] = split(tree->left, offset);
+            return {left, makeNode(tree->piece, tree->priority, right, tree->right)};
+        }
+        offset -= leftLength;
+        if (offset >= tree->piece.length) {
+            auto [left, right] = split(tree->right, offset - tree->piece.length);
+            return {makeNode(tree->piece, tree->priority, tree->left, left), right};
+        }
+        Piece head = slice(tree->piece, 0, offset);
+        Piece tail = slice(tree->piece, offset, tree->piece.length - offset);
+        return {makeNode(head, tree->priority, tree->left, nullptr), makeNode(tail, tree->priority, nullptr, tree->right)};
+    }
+
+    static Tree merge(const Tree& left, const Tree& right) {
+        if (!left) return right;
+        if (!right) return left;
+        if (left->priority > right->priority) {
+            return makeNode(left->piece, left->priority, left->left, merge(left->right, right));
+        }
+        return makeNode(right->piece, right->priority, merge(left, right->left), right->right);
+    }
+
+    // Document offset of the newline with zero-based number `n`.
+    uint64_t findBreak(uint64_t n) const {
+        uint64_t offset = 0;
+        const Node* node = root.get();
+        while (node) {
+            uint64_t leftBreaks = breaks(node->left);
+            if (n < leftBreaks) {
+                node = node->left.get();
+                continue;
+            }
+            n -= leftBreaks;
+            offset += length(node->left);
+            const Piece& piece = node->piece;
+            if (n < piece.breaks) {
+                const LineIndex& lines = index(piece.source);
+                const char* base = data(piece.source);
+                return offset + lines.select(base, lines.rank(base, piece.start) + n) - piece.start;
+            }
+            n -= piece.breaks;
+            offset += piece.length;
+            node = node->right.get();
+        }
+        return offset;
+    }
+
+    template<class F>
+    static uint64_t forEachPiece(const Node* node, uint64_t offset, F&& visit) {
+        if (!node) return offset;
+        offset = forEachPiece(node->left.get(), offset, visit);
+        visit(offset, node->piece);
+        return forEachPiece(node->right.get(), offset + node->piece.length, visit);
+    }
+
+    template<class F>
+    void spans(const Node* node, uint64_t base, uint64_t from, uint64_t to, F& visit) const {
+        if (!node || from >= to) return;
+        uint64_t pieceStart = base + length(node->left);
+        uint64_t pieceEnd = pieceStart + node->piece.length;
+        if (from < pieceStart) spans(node->left.get(), base, from, to, visit);
+        if (from < pieceEnd && to > pieceStart) {
+            uint64_t begin = std::max(from, pieceStart);
+            uint64_t end = std::min(to, pieceEnd);
+            visit(data(node->piece.source) + node->piece.start + (begin - pieceStart), static_cast<size_t>(end - begin));
+        }
+        if (to > pieceEnd) spans(node->right.get(), pieceEnd, from, to, visit);
+    }
+};
+
+class SimpleTextEditor {
+private:
+    PieceTable buffer;
+    std::string filename;
+    std::string lineEnding = "\n";
+    uint64_t top = 0;
+    std::string searchText;
+    uint64_t searchFrom = 0;
+    // Where the next replace looks first: the last found match, or the end of the
+    // last replacement so the inserted text is never matched again.
+    std::optional<uint64_t> replaceFrom;
+
+    static constexpr uint64_t VIEW_LINES = 20;
+    static constexpr uint64_t MAX_LINE_DISPLAY = 512;
+    static constexpr uint64_t WRITE_CHUNK = 64 * 1024 * 1024;
+
+    // End of a line's text, before its "\n" or "\r\n".
+    uint64_t contentEnd(uint64_t start, uint64_t next) {
+        uint64_t end = next;
+        if (end > start && buffer.byteAt(end - 1) == '\n') --end;
+        if (end > start && buffer.byteAt(end - 1) == '\r') --end;
+        return end;
+    }
+
+    void showLine(uint64_t line) {
+        if (line < top || line >= top + VIEW_LINES) top = line > VIEW_LINES / 2 ? line - VIEW_LINES / 2 : 0;
+    }
+
+    // Next match of `text` at or after `from`, wrapping around to the start once.
+    std::optional<uint64_t> locate(const std::string& text, uint64_t from) {
+        auto hit = buffer.find(text, from);
+        if (!hit && from > 0) {
+            hit = buffer.find(text, 0);
+            if (hit) std::cout << "(Suche am Anfang fortgesetzt)\n";
+        }
+        if (!hit) std::cout << "Nicht gefunden: " << text << "\n";
+        return hit;
+    }
+
+    void reportMatch(uint64_t offset) {
+        uint64_t line = buffer.lineOf(offset);
+        std::cout << "Gefunden in Zeile " << line + 1 << ", Spalte " << offset - buffer.lineStart(line) + 1 << ".\n";
+        showLine(line);
+    }
+
+public:
+    SimpleTextEditor(const std::string& fname) : filename(fname) {
+        if (!buffer.open(fs::u8path(filename))) {
+            std::cerr << "Fehler: Datei '" << filename << "' konnte nicht geoeffnet werden.\n";
+        }
+        std::string head = buffer.text(0, 64 * 1024);
+        size_t firstBreak = head.find('\n');
+        if (firstBreak != std::string::npos && firstBreak > 0 && head[firstBreak - 1] == '\r') lineEnding = "\r\n";
+    }
+
+    // Shows VIEW_LINES lines from the top of the viewport; only those lines are read.
+    void display() {
+        std::ostringstream out;
+        uint64_t total = buffer.size();
+        uint64_t offset = buffer.lineStart(top);
+        uint64_t line = top;
+        for (; line < top + VIEW_LINES && offset < total; ++line) {
+            uint64_t next = buffer.nextLine(offset);
+            uint64_t end = contentEnd(offset, next);
+            out << line + 1 << ": " << buffer.text(offset, std::min(end - offset, MAX_LINE_DISPLAY))
+                << (end - offset > MAX_LINE_DISPLAY ? " ..." : "") << "\n";
+            offset = next;
+        }
+        out << "[Zeilen " << std::min(top + 1, line) << "-" << line << " von ";
+        if (buffer.lineCountKnown()) out << buffer.lineCount();
+        else out << "?";
+        out << "]\n";
+        std::cout << out.str();
+    }
+
+    void scrollTo(size_t lineNumber) {
+        top = lineNumber > 0 ? lineNumber - 1 : 0;
+    }
+
+    // The rest of an editor command line after its command word. Only the one separator
+    // after the word is removed, so a search text may start with spaces.
+    static std::string argumentsOf(const std::string& command) {
+        size_t start = command.find_first_not_of(" \t");
+        size_t end = start == std::string::npos ? start : command.find_first_of(" \t", start);
+        return end == std::string::npos ? std::string() : command.substr(end + 1);
+    }
+
+    // Searches from the top of the viewport.
+    void find(const std::string& text) {
+        if (text.empty()) return;
+        searchText = text;
+        if (auto hit = locate(text, buffer.lineStart(top))) {
+            searchFrom = *hit + 1;
+            replaceFrom = *hit;
+            reportMatch(*hit);
+        }
+    }
+
+    void findNext() {
+        if (searchText.empty()) {
+            std::cout << "Kein Suchbegriff. Zuerst find <text> verwenden.\n";
+            return;
+        }
+        if (auto hit = locate(searchText, searchFrom)) {
+            searchFrom = *hit + 1;
+            replaceFrom = *hit;
+            reportMatch(*hit);
+        }
+    }
+
+    // Replaces the next match, continuing from the last find, or all matches at once.
+    void replace(const std::string& text, const std::string& replacement, bool all) {
+        if (text.empty()) return;
+        if (all) {
+            size_t count = buffer.replaceAll(text, replacement);
+            buffer.checkpoint();
+            std::cout << count << " Vorkommen ersetzt.\n";
+            searchFrom = 0;
+            replaceFrom.reset();
+            return;
+        }
+        uint64_t from = searchText == text && replaceFrom ? *replaceFrom : buffer.lineStart(top);
+        searchText = text;
+        if (auto hit = locate(text, from)) {
+            buffer.erase(*hit, text.size());
+            buffer.insert(*hit, replacement);
+            buffer.checkpoint();
+            searchFrom = *hit + replacement.size();
+            replaceFrom = searchFrom;
+            reportMatch(*hit);
+        }
+    }
+
+    // Parses `<alt> [<neu>...] [all]`. Quoted arguments may contain spaces or be
+    // empty; unquoted words after the search text form the replacement.
+    void replace(const std::string& arguments) {
+        std::vector<std::pair<std::string, bool>> args;
+        bool inQuotes = false;
+        bool inArg = false;
+        for (char c : arguments) {
+            if (c == '"') {
+                if (!inArg) args.emplace_back(std::string(), true);
+                inQuotes = !inQuotes;
+                inArg = true;
+            } else if (c == ' ' && !inQuotes) {
+                inArg = false;
+            } else {
+                if (!inArg) args.emplace_back(std::string(), false);
+                args.back().first += c;
+                inArg = true;
+            }
+        }
+        if (args.empty()) return;
+        bool all = args.size() > 1 && !args.back().second && args.back().first == "all";
+        if (all) args.pop_back();
+        std::string replacement;
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (i > 1) replacement += ' ';
+            replacement += args[i].first;
+        }
+        replace(args[0].first, replacement, all);
+    }
+
+    void addLine(const std::string& line) {
+        uint64_t total = buffer.size();
+        std::string text;
+        if (total > 0 && buffer.byteAt(total - 1) != '\n') text += lineEnding;
+        text += line;
+        text += lineEnding;
+        buffer.insert(total, text);
+        buffer.checkpoint();
+        showLine(buffer.lineCount() - 1);
+    }
+
+    void editLine(size_t lineNumber, const std::string& newContent) {
+        if (lineNumber > 0 && lineNumber <= buffer.lineCount()) {
+            uint64_t start = buffer.lineStart(lineNumber - 1);
+            uint64_t end = contentEnd(start, buffer.lineStart(lineNumber));
+            buffer.erase(start, end - start);
+            buffer.insert(start, newContent);
+            buffer.checkpoint();
+            showLine(lineNumber - 1);
+        }
+    }
+
+    void deleteLine(size_t lineNumber) {
+        if (lineNumber > 0 && lineNumber <= buffer.lineCount()) {
+            uint64_t start = buffer.lineStart(lineNumber - 1);
+            buffer.erase(start, buffer.lineStart(lineNumber) - start);
+            buffer.checkpoint();
+            showLine(lineNumber - 1);
+        }
+    }
+
+    // Each editor command is one undo step. Saving ends the history.
+    void undo() {
+        if (auto offset = buffer.undo()) showLine(buffer.lineOf(*offset));
+        else std::cout << "Nichts rueckgaengig zu machen.\n";
+    }
+
+    void redo() {
+        if (auto offset = buffer.redo()) showLine(buffer.lineOf(*offset));
+        else std::cout << "Nichts wiederherzustellen.\n";
+    }
+
+    // Edits that left the rest of the file where it was, such as appends and
+    // replacements of equal length, are saved by writing only the changed ranges into
+    // the file. Everything else goes to a temporary file that is flushed to disk and
+    // then renamed over the original, so a crash leaves the old or the new file but
+    // never a mix of both.
+    bool save() {
+        if (auto changes = buffer.changedRanges()) return patch(*changes);
+        return rewrite();
+    }
+
+private:
+    bool writeAt(HANDLE file, const char* data, size_t size, uint64_t offset) {
+        while (size > 0) {
+            OVERLAPPED position{};
+            position.Offset = static_cast<DWORD>(offset);
+            position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD chunk = static_cast<DWORD>(std::min<uint64_t>(size, WRITE_CHUNK));
+            DWORD written = 0;
+            if (!WriteFile(file, data, chunk, &written, &position) || written != chunk) return false;
+            data += chunk;
+            size -= chunk;
+            offset += chunk;
+        }
+        return true;
+    }
+
+    bool writeRange(HANDLE file, uint64_t offset, uint64_t length) {
+        bool ok = true;
+        uint64_t position = offset;
+        buffer.forEachSpan(offset, length, [&](const char* data, size_t size) {
+            ok = ok && writeAt(file, data, size, position);
+            position += size;
+        });
+        return ok;
+    }
+
+    bool patch(const std::vector<std::pair<uint64_t, uint64_t>>& changes) {
+        if (changes.empty()) return true;
+        fs::path path = fs::u8path(filename);
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, 0, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return rewrite();
+        bool ok = true;
+        for (const auto& [offset, length] : changes) ok = ok && writeRange(file, offset, length);
+        ok = ok && FlushFileBuffers(file);
+        CloseHandle(file);
+        return ok && buffer.commitInPlace(path, changes);
+    }
+
+    // Unsaved pieces point into the mapped original, so the mapping is dropped only
+    // right before the rename and restored if the rename fails.
+    bool rewrite() {
+        fs::path path = fs::u8path(filename);
+        fs::path temporary = path;
+        temporary += L".tmp";
+        HANDLE file = CreateFileW(temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        WIN32_FILE_ATTRIBUTE_DATA previous{};
+        bool existed = GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &previous) != FALSE;
+        FILE_END_OF_FILE_INFO endOfFile{};
+        endOfFile.EndOfFile.QuadPart = static_cast<LONGLONG>(buffer.size());
+        SetFileInformationByHandle(file, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+        bool ok = writeRange(file, 0, buffer.size()) && FlushFileBuffers(file);
+        if (ok && existed) SetFileTime(file, &previous.ftCreationTime, nullptr, nullptr);
+        CloseHandle(file);
+        if (!ok) {
+            DeleteFileW(temporary.c_str());
+            return false;
+        }
+
+        buffer.release();
+        if (!MoveFileExW(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+            DeleteFileW(temporary.c_str());
+            buffer.remap(path);
+            return false;
+        }
+        DWORD kept = FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_NOT_CONTENT_INDEXED;
+        if (existed && (previous.dwFileAttributes & kept)) SetFileAttributesW(path.c_str(), previous.dwFileAttributes & kept);
+        return buffer.open(path);
+    }
+};
+
+class EditCommand : public Command {
+private:
+    Terminal& terminal;
+
+public:
+    EditCommand(Terminal& t) : terminal(t) {}
+
+    CommandResult execute(const std::vector<std::string>& args) override {
+        if (!validateArgs(args)) {
+            return CommandResult(CommandResult::Status::Error, "Invalid arguments");
+        }
+        SimpleTextEditor editor(args[0]);
+        std::string command;
+
+        while (true) {
+            editor.display();
+            std::cout << "\nEditor-Befehle: add, edit <zeilennummer>, delete <zeilennummer>, goto <zeilennummer>,\n"
+                      << "                find <text>, next, replace <alt> [neu] [all], undo, redo, save, quit\n";
+            std::cout << "Befehl: ";
+            std::getline(std::cin, command);
+
+            std::istringstream iss(command);
+            std::vector<std::string> tokens;
+            std::string token;
+            while (iss >> token) {
+                tokens.push_back(token);
+            }
+
+            if (tokens.empty()) continue;
+
+            if (tokens[0] == "quit") break;
+
+            if (tokens[0] == "add") {
+                std::cout << "Neue Zeile: ";
+                std::string newLine;
+                std::getline(std::cin, newLine);
+                editor.addLine(newLine);
+            } else if (tokens[0] == "edit" && tokens.size() > 1) {
+                size_t lineNumber = std::stoul(tokens[1]);
+                std::cout << "Neue Inhalte: ";
+                std::string newContent;
+                std::getline(std::cin, newContent);
+                editor.editLine(lineNumber, newContent);
+            } else if (tokens[0] == "delete" && tokens.size() > 1) {
+                size_t lineNumber = std::stoul(tokens[1]);
+                editor.deleteLine(lineNumber);
+            } else if (tokens[0] == "goto" && tokens.size() > 1) {
+                editor.scrollTo(std::stoul(tokens[1]));
+            } else if (tokens[0] == "find" && tokens.size() > 1) {
+                editor.find(SimpleTextEditor::argumentsOf(command));
+            } else if (tokens[0] == "next") {
+                editor.findNext();
+            } else if (tokens[0] == "undo") {
+                editor.undo();
+            } else if (tokens[0] == "redo") {
+                editor.redo();
+            } else if (tokens[0] == "replace" && tokens.size() > 1) {
+                editor.replace(SimpleTextEditor::argumentsOf(command));
+            } else if (tokens[0] == "save") {
+                if (editor.save()) std::cout << "Datei gespeichert.\n";
+                else std::cerr << "Fehler: Datei konnte nicht gespeichert werden.\n";
+            }
+        }
+        return CommandResult(CommandResult::Status::Success, "File edited successfully");
+    }
+
+    std::string getHelp() const override { return "Oeffnet einen einfachen Texteditor"; }
+    std::string getUsage() const override { return "edit <dateiname>"; }
+    bool validateArgs(const std::vector<std::string>& args) const override {
+        return !args.empty() && args.size() == 1;
+    }
+};
+
+// All processes from a single NtQuerySystemInformation call, which returns names,
+// times and memory counters without opening any process. The query buffer, the
+// process list and the previous sample are kept between refreshes. CPU usage is the
+// CPU time a process gained since the previous refresh, relative to all processors.
+class ProcessTable {
+public:
+    struct Process {
+        DWORD pid = 0;
+        DWORD parentPid = 0;
+        std::string name;
+        ULONG threads = 0;
+        ULONG handles = 0;
+        uint64_t workingSet = 0;
+        uint64_t cpuTime = 0;       // kernel and user time in 100 ns units
+        double cpuPercent = 0;      // 0 until the second refresh
+    };
+
+    enum class SortKey { Pid, Name, Cpu, Memory };
+
+    ProcessTable() {
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        processorCount = std::max<DWORD>(systemInfo.dwNumberOfProcessors, 1);
+    }
+
+    static std::optional<SortKey> parseSortKey(const std::string& text) {
+        if (text == "pid") return SortKey::Pid;
+        if (text == "name") return SortKey::Name;
+        if (text == "cpu") return SortKey::Cpu;
+        if (text == "mem") return SortKey::Memory;
+        return std::nullopt;
+    }
+
+    const std::vector<Process>& processes() const { return list; }
+
+    bool refresh() {
+        ULONG needed = 0;
+        NTSTATUS status;
+        while ((status = NtQuerySystemInformation(SystemProcessInformation, buffer.data(),
+                                                  static_cast<ULONG>(buffer.size() * sizeof(uint64_t)), &needed)) ==
+               STATUS_INFO_LENGTH_MISMATCH) {
+            // Processes may start between the two calls.
+            buffer.resize(std::max<size_t>((needed + needed / 4) / sizeof(uint64_t) + 1, buffer.size() * 2));
+        }
+        if (status < 0) return false;
+
+        auto now = std::chrono::steady_clock::now();
+        double available = 0;
+        if (!previous.empty()) {
+            available = std::chrono::duration<double>(now - previousAt).count() * 1e7 * processorCount;
+        }
+        current.clear();
+        size_t count = 0;
+        for (size_t offset = 0;;) {
+            const auto* record = reinterpret_cast<const ProcessRecord*>(reinterpret_cast<const char*>(buffer.data()) + offset);
+            if (count == list.size()) list.emplace_back();
+            Process& process = list[count++];
+            process.pid = static_cast<DWORD>(reinterpret_cast<ULONG_PTR>(record->UniqueProcessId));
+            process.parentPid = static_cast<DWORD>(reinterpret_cast<ULONG_PTR>(record->InheritedFromUniqueProcessId));
+            process.name.clear();
+            if (record->ImageName.Length > 0) {
+                TextEncoding::appendUtf8(process.name, record->ImageName.Buffer, record->ImageName.Length / sizeof(WCHAR));
+            } else if (process.pid == 0) {
+                process.name = "[Leerlauf]";
+            }
+            process.threads = record->NumberOfThreads;
+            process.handles = record->HandleCount;
+            process.workingSet = record->WorkingSetSize;
+            process.cpuTime = static_cast<uint64_t>(record->KernelTime.QuadPart + record->UserTime.QuadPart);
+            process.cpuPercent = 0;
+
+            // A reused pid belongs to a new process if the creation time differs.
+            Sample sample{record->CreateTime.QuadPart, process.cpuTime};
+            auto before = previous.find(process.pid);
+            if (available > 0 && before != previous.end() && before->second.createTime == sample.createTime &&
+                process.cpuTime >= before->second.cpuTime) {
+                process.cpuPercent = std::min(100.0, (process.cpuTime - before->second.cpuTime) * 100.0 / available);
+            }
+            current.emplace(process.pid, sample);
+
+            if (record->NextEntryOffset == 0) break;
+            offset += record->NextEntryOffset;
+        }
+        list.resize(count);
+        previous.swap(current);
+        previousAt = now;
+        return true;
+    }
+
+    // Busy share of all processors, without the idle process.
+    double totalCpuPercent() const {
+        double total = 0;
+        for (const auto& process : list) {
+            if (process.pid != 0) total += process.cpuPercent;
+        }
+        return std::min(total, 100.0);
+    }
+
+    void sort(SortKey key) {
+        auto byName = [](const Process& a, const Process& b) {
+            int order = _stricmp(a.name.c_str(), b.name.c_str());
+            return order != 0 ? order < 0 : a.pid < b.pid;
+        };
+        switch (key) {
+            case SortKey::Pid:
+                std::sort(list.begin(), list.end(), [](const Process& a, const Process& b) { return a.pid < b.pid; });
+                break;
+            case SortKey::Name:
+                std::sort(list.begin(), list.end(), byName);
+                break;
+            case SortKey::Cpu:
+                std::sort(list.begin(), list.end(), [](const Process& a, const Process& b) {
+                    if (a.cpuPercent != b.cpuPercent) return a.cpuPercent > b.cpuPercent;
+                    return a.cpuTime != b.cpuTime ? a.cpuTime > b.cpuTime : a.pid < b.pid;
+                });
+                break;
+            case SortKey::Memory:
+                std::sort(list.begin(), list.end(), [](const Process& a, const Process& b) {
+                    return a.workingSet != b.workingSet ? a.workingSet > b.workingSet : a.pid < b.pid;
+                });
+                break;
+        }
+    }
+
+    // Returns 0 on success, otherwise the Win32 error code.
+    static DWORD terminate(DWORD pid) {
+        HANDLE process = OpenProcess(PROCESS_TERMINATE, FALSE, pid);
+        if (!process) return GetLastError();
+        DWORD error = TerminateProcess(process, 1) ? 0 : GetLastError();
+        CloseHandle(process);
+        return error;
+    }
+
+private:
+    static constexpr NTSTATUS STATUS_INFO_LENGTH_MISMATCH = static_cast<NTSTATUS>(0xC0000004L);
+    static constexpr size_t INITIAL_BUFFER = 512 * 1024;
+
+    // SYSTEM_PROCESS_INFORMATION as the kernel fills it; winternl.h declares the
+    // creation and CPU times as reserved fields.
+    struct ProcessRecord {
+        ULONG NextEntryOffset;
+        ULONG NumberOfThreads;
+        LARGE_INTEGER WorkingSetPrivateSize;
+        ULONG HardFaultCount;
+        ULONG NumberOfThreadsHighWatermark;
+        ULONGLONG CycleTime;
+        LARGE_INTEGER CreateTime;
+        LARGE_INTEGER UserTime;
+        LARGE_INTEGER KernelTime;
+        UNICODE_STRING ImageName;
+        LONG BasePriority;
+        HANDLE UniqueProcessId;
+        HANDLE InheritedFromUniqueProcessId;
+        ULONG HandleCount;
+        ULONG SessionId;
+        ULONG_PTR UniqueProcessKey;
+        SIZE_T PeakVirtualSize;
+        SIZE_T VirtualSize;
+        ULONG PageFaultCount;
+        SIZE_T PeakWorkingSetSize;
+        SIZE_T WorkingSetSize;
+        SIZE_T QuotaPeakPagedPoolUsage;
+        SIZE_T QuotaPagedPoolUsage;
+        SIZE_T QuotaPeakNonPagedPoolUsage;
+        SIZE_T QuotaNonPagedPoolUsage;
+        SIZE_T PagefileUsage;
+        SIZE_T PeakPagefileUsage;
+        SIZE_T PrivatePageCount;
+    };
+
+    struct Sample {
+        LONGLONG createTime;
+        uint64_t cpuTime;
+    };
+
+    std::vector<uint64_t> buffer = std::vector<uint64_t>(INITIAL_BUFFER / sizeof(uint64_t));   // 8-byte aligned records
+    std::vector<Process> list;
+    std::unordered_map<DWORD, Sample> previous;
+    std::unordered_map<DWORD, Sample> current;
+    std::chrono::steady_clock::time_point previousAt;
+    DWORD processorCount = 1;
+};
+
+class PerformanceMetrics {
+private:
+    static inline std::map<std::string, std::chrono::microseconds> metrics;
+    static inline std::mutex metricsMutex;
+
+public:
+    static void record(const std::string& operation, std::chrono::microseconds duration) {
+        std::lock_guard<std::mutex> lock(metricsMutex);
+        metrics[operation] += duration;
+    }
+
+    static void displayMetrics() {
+        std::lock_guard<std::mutex> lock(metricsMutex);
+        for (const auto& [op, duration] : metrics) {
+            std::cout << op << ": " << duration.count() / 1000.0 << "ms\n";
+        }
+    }
+};
+
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queue_mutex;
+    std::condition_variable condition;
+    bool stop;
+
+public:
+    ThreadPool(size_t threads) : stop(false) {
+        for(size_t i = 0; i < threads; ++i)
+            workers.emplace_back([this] {
+                while(true) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(queue_mutex);
+                        condition.wait(lock, [this] { 
+                            return stop || !tasks.empty(); 
+                        });
+                        if(stop && tasks.empty())
+                            return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+    }
+
+    template<class F>
+    auto enqueue(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+        std::future<Result> result = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            tasks.emplace([task] { (*task)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            stop = true;
+        }
+        condition.notify_all();
+        for(std::thread &worker: workers)
+            worker.join();
+    }
+};
+
+// Tracks a batch of pool tasks so the submitting thread can wait for all of them,
+// optionally with a timeout to report progress in between.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool(pool) {}
+
+    ~TaskGroup() {
+        wait();
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    template<class F>
+    void run(F&& f) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++pending;
+        }
+        pool.enqueue([this, task = std::forward<F>(f)]() mutable {
+            struct Finish {
+                TaskGroup* group;
+                ~Finish() { group->finish(); }
+            } finish{this};
+            task();
+        });
+    }
+
+    bool waitFor(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return done.wait_for(lock, timeout, [this] { return pending == 0; });
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    ThreadPool& pool;
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t pending = 0;
+
+    void finish() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) done.notify_all();
+    }
+};
+
+class ConcreteCommand : public Command {
+private:
+    std::function<void(const std::vector<std::string>&)> executeFunc;
+    std::string helpText;
+    std::string usageText;
+
+public:
+    ConcreteCommand(
+        std::function<void(const std::vector<std::string>&)> exec,
+        std::string help,
+        std::string usage
+    ) : executeFunc(std::move(exec)),
+        helpText(std::move(help)),
+        usageText(std::move(usage)) {}
+
+    CommandResult execute(const std::vector<std::string>& args) override {
+        executeFunc(args);
+        return CommandResult(CommandResult::Status::Success, "Command executed");
+    }
+
+    std::string getHelp() const override {
+        return helpText;
+    }
+
+    std::string getUsage() const override {
+        return usageText;
+    }
+
+    bool validateArgs(const std::vector<std::string>& args) const override {
+        return true;
+    }
+};
+
+class ScreenBuffer {
+public:
+    struct Cell {
+        char32_t glyph = U' ';
+        WORD attr = 0;
+
+        bool operator==(const Cell& other) const { return glyph == other.glyph && attr == other.attr; }
+        bool operator!=(const Cell& other) const { return !(*this == other); }
+    };
+
+    ScreenBuffer(int w, int h) : width(w), height(h), cells(static_cast<size_t>(w) * h) {}
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    const Cell& at(int row, int col) const { return cells[static_cast<size_t>(row) * width + col]; }
+
+    void clear(WORD attr) {
+        std::fill(cells.begin(), cells.end(), Cell{U' ', attr});
+    }
+
+    void fill(int row, int col, int count, char32_t glyph, WORD attr) {
+        if (row < 0 || row >= height) return;
+        for (int c = std::max(col, 0); c < std::min(col + count, width); ++c) {
+            cells[static_cast<size_t>(row) * width + c] = Cell{glyph, attr};
+        }
+    }
+
+    // Writes UTF-8 text starting at (row, col), clipped to the row. Returns the column after the text.
+    int put(int row, int col, const std::string& text, WORD attr) {
+        size_t i = 0;
+        while (i < text.size()) {
+            char32_t cp = decodeUtf8(text, i);
+            if (row >= 0 && row < height && col >= 0 && col < width) {
+                cells[static_cast<size_t>(row) * width + col] = Cell{cp, attr};
+            }
+            ++col;
+        }
+        return col;
+    }
+
+    static size_t columnCount(const std::string& text) {
+        size_t count = 0;
+        for (size_t i = 0; i < text.size(); ++count) {
+            decodeUtf8(text, i);
+        }
+        return count;
+    }
+
+    static void appendUtf8(std::string& out, char32_t cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    static char32_t decodeUtf8(const std::string& text, size_t& i) {
+        unsigned char lead = static_cast<unsigned char>(text[i++]);
+        if (lead < 0x80) return lead;
+
+        int extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+        char32_t cp = lead & (0x3F >> extra);
+        for (int k = 0; k < extra && i < text.size(); ++k) {
+            unsigned char next = static_cast<unsigned char>(text[i]);
+            if ((next & 0xC0) != 0x80) return U'?';
+            cp = (cp << 6) | (next & 0x3F);
+            ++i;
+        }
+        return extra == 0 ? U'?' : cp;
+    }
+
+private:
+    int width;
+    int height;
+    std::vector<Cell> cells;
+};
+
+class FrameRenderer {
+public:
+    enum class Anchor {
+        Screen,
+        CurrentLine
+    };
+
+    FrameRenderer(int w, int h, Anchor a) : front(w, h), back(w, h), anchor(a) {}
+
+    ScreenBuffer& frame() { return back; }
+
+    void invalidate() {
+        frontValid = false;
+        emittedAttr.reset();
+    }
+
+    // Declares what the terminal currently shows, e.g. a freshly started blank line.
+    void assumeBlank(WORD attr, int cursorCol = 0) {
+        front.clear(attr);
+        frontValid = true;
+        emittedAttr.reset();
+        cursorRow = 0;
+        cursorColumn = cursorCol;
+    }
+
+    // Emits only the cells that differ from the previous frame, in a single write.
+    void present(int targetRow, int targetCol, WORD restAttr) {
+        out.clear();
+        for (int row = 0; row < back.getHeight(); ++row) {
+            int col = 0;
+            while (col < back.getWidth()) {
+                if (frontValid && back.at(row, col) == front.at(row, col)) {
+                    ++col;
+                    continue;
+                }
+                int runEnd = col + 1;
+                int unchanged = 0;
+                for (int c = runEnd; c < back.getWidth(); ++c) {
+                    if (frontValid && back.at(row, c) == front.at(row, c)) {
+                        if (++unchanged > MAX_RUN_GAP) break;
+                    } else {
+                        unchanged = 0;
+                        runEnd = c + 1;
+                    }
+                }
+                moveCursor(row, col);
+                for (int c = col; c < runEnd; ++c) {
+                    const auto& cell = back.at(row, c);
+                    if (emittedAttr != cell.attr) {
+                        appendAttr(cell.attr);
+                    }
+                    ScreenBuffer::appendUtf8(out, cell.glyph);
+                }
+                cursorColumn = runEnd;
+                col = runEnd;
+            }
+        }
+        moveCursor(targetRow, targetCol);
+        if (emittedAttr != restAttr) {
+            appendAttr(restAttr);
+        }
+
+        if (!out.empty()) {
+            std::cout.flush();
+            DWORD written = 0;
+            WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), out.data(), static_cast<DWORD>(out.size()), &written, nullptr);
+        }
+        front = back;
+        frontValid = true;
+    }
+
+private:
+    static constexpr int MAX_RUN_GAP = 4;
+
+    ScreenBuffer front;
+    ScreenBuffer back;
+    Anchor anchor;
+    bool frontValid = false;
+    std::optional<WORD> emittedAttr;
+    int cursorRow = -1;
+    int cursorColumn = -1;
+    std::string out;
+
+    void appendNumber(int value) {
+        char digits[12];
+        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, end);
+    }
+
+    void moveCursor(int row, int col) {
+        if (row == cursorRow && col == cursorColumn) return;
+        if (anchor == Anchor::Screen) {
+            out += "\x1b[";
+            appendNumber(row + 1);
+            out += ';';
+            appendNumber(col + 1);
+            out += 'H';
+        } else if (col == 0) {
+            out += '\r';
+        } else if (row == cursorRow && col == cursorColumn - 1) {
+            out += '\b';
+        } else {
+            out += "\x1b[";
+            appendNumber(col + 1);
+            out += 'G';
+        }
+        cursorRow = row;
+        cursorColumn = col;
+    }
+
+    void appendAttr(WORD attr) {
+        static const int ansiIndex[8] = {0, 4, 2, 6, 1, 5, 3, 7};
+        int fg = attr & 0x0F;
+        int bg = (attr >> 4) & 0x0F;
+        out += "\x1b[";
+        appendNumber(((fg & 8) ? 90 : 30) + ansiIndex[fg & 7]);
+        out += ';';
+        appendNumber(((bg & 8) ? 100 : 40) + ansiIndex[bg & 7]);
+        out += 'm';
+        emittedAttr = attr;
+    }
+};
+
+struct SystemSnapshot {
+    uint64_t sampleCount = 0;
+    double cpuPercent = 0.0;
+    int memoryLoad = 0;
+    ULONGLONG totalPhysical = 0;
+    ULONGLONG availablePhysical = 0;
+    ULONGLONG totalPageFile = 0;
+    ULONGLONG availablePageFile = 0;
+    DWORD processCount = 0;
+    DWORD threadCount = 0;
+    DWORD handleCount = 0;
+    double diskReadPerSecond = 0.0;
+    double diskWritePerSecond = 0.0;
+    double networkReceivePerSecond = 0.0;
+    double networkSendPerSecond = 0.0;
+    ULONGLONG uptimeSeconds = 0;
+};
+
+// Samples system counters on its own thread. Readers copy the last published snapshot
+// from a double buffer guarded by a per-slot sequence number, so they never lock or
+// make a system call.
+class SystemStatsSampler {
+public:
+    explicit SystemStatsSampler(std::chrono::milliseconds samplingInterval = std::chrono::milliseconds(1000))
+        : interval(samplingInterval) {}
+
+    ~SystemStatsSampler() {
+        stop();
+    }
+
+    void start() {
+        if (worker.joinable()) return;
+
+        char name[MAX_COMPUTERNAME_LENGTH + 1];
+        DWORD nameLength = sizeof(name);
+        if (GetComputerNameA(name, &nameLength)) computerName.assign(name, nameLength);
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        processorCount = systemInfo.dwNumberOfProcessors;
+        openDisks();
+
+        sample();
+        stopRequested = false;
+        worker = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopRequested = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+
+        for (HANDLE disk : diskHandles) CloseHandle(disk);
+        diskHandles.clear();
+    }
+
+    void setInterval(std::chrono::milliseconds samplingInterval) {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            interval = std::max(samplingInterval, std::chrono::milliseconds(100));
+        }
+        wake.notify_all();
+    }
+
+    std::chrono::milliseconds getInterval() const {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        return interval;
+    }
+
+    SystemSnapshot snapshot() const {
+        while (true) {
+            const Slot& slot = slots[published.load(std::memory_order_acquire)];
+            uint64_t before = slot.sequence.load(std::memory_order_acquire);
+            SystemSnapshot copy = slot.data;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((before & 1) == 0 && before == slot.sequence.load(std::memory_order_relaxed)) {
+                return copy;
+            }
+        }
+    }
+
+    const std::string& getComputerName() const { return computerName; }
+    DWORD getProcessorCount() const { return processorCount; }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        SystemSnapshot data;
+    };
+
+    struct Counters {
+        ULONGLONG idle = 0;
+        ULONGLONG busy = 0;
+        ULONGLONG diskRead = 0;
+        ULONGLONG diskWritten = 0;
+        ULONGLONG networkIn = 0;
+        ULONGLONG networkOut = 0;
+        std::chrono::steady_clock::time_point takenAt;
+    };
+
+    Slot slots[2];
+    std::atomic<unsigned> published{0};
+    std::thread worker;
+    mutable std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stopRequested = false;
+    std::chrono::milliseconds interval;
+
+    std::vector<HANDLE> diskHandles;
+    std::optional<Counters> previous;
+    uint64_t sampleCount = 0;
+    std::string computerName;
+    DWORD processorCount = 0;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        while (!stopRequested) {
+            wake.wait_for(lock, interval);
+            if (stopRequested) break;
+            lock.unlock();
+            sample();
+            lock.lock();
+        }
+    }
+
+    void openDisks() {
+        for (int i = 0; i < 16; ++i) {
+            std::wstring device = L"\\\\.\\PhysicalDrive" + std::to_wstring(i);
+            HANDLE disk = CreateFileW(device.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                      nullptr, OPEN_EXISTING, 0, nullptr);
+            if (disk != INVALID_HANDLE_VALUE) diskHandles.push_back(disk);
+        }
+    }
+
+    static ULONGLONG toTicks(const FILETIME& time) {
+        return (ULONGLONG(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    }
+
+    void sample() {
+        SystemSnapshot next;
+        Counters now;
+        now.takenAt = std::chrono::steady_clock::now();
+
+        FILETIME idleTime, kernelTime, userTime;
+        if (GetSystemTimes(&idleTime, &kernelTime, &userTime)) {
+            now.idle = toTicks(idleTime);
+            now.busy = toTicks(kernelTime) + toTicks(userTime) - now.idle;
+        }
+
+        MEMORYSTATUSEX memInfo;
+        memInfo.dwLength = sizeof(MEMORYSTATUSEX);
+        if (GlobalMemoryStatusEx(&memInfo)) {
+            next.memoryLoad = static_cast<int>(memInfo.dwMemoryLoad);
+            next.totalPhysical = memInfo.ullTotalPhys;
+            next.availablePhysical = memInfo.ullAvailPhys;
+            next.totalPageFile = memInfo.ullTotalPageFile;
+            next.availablePageFile = memInfo.ullAvailPageFile;
+        }
+
+        PERFORMANCE_INFORMATION perfInfo;
+        if (GetPerformanceInfo(&perfInfo, sizeof(perfInfo))) {
+            next.processCount = perfInfo.ProcessCount;
+            next.threadCount = perfInfo.ThreadCount;
+            next.handleCount = perfInfo.HandleCount;
+        }
+
+        for (HANDLE disk : diskHandles) {
+            DISK_PERFORMANCE diskPerf;
+            DWORD returned = 0;
+            if (DeviceIoControl(disk, IOCTL_DISK_PERFORMANCE, nullptr, 0, &diskPerf, sizeof(diskPerf), &returned, nullptr)) {
+                now.diskRead += diskPerf.BytesRead.QuadPart;
+                now.diskWritten += diskPerf.BytesWritten.QuadPart;
+            }
+        }
+
+        MIB_IF_TABLE2* table = nullptr;
+        if (GetIfTable2(&table) == NO_ERROR) {
+            for (ULONG i = 0; i < table->NumEntries; ++i) {
+                const MIB_IF_ROW2& row = table->Table[i];
+                if (!row.InterfaceAndOperStatusFlags.HardwareInterface || row.OperStatus != IfOperStatusUp) continue;
+                now.networkIn += row.InOctets;
+                now.networkOut += row.OutOctets;
+            }
+            FreeMibTable(table);
+        }
+
+        next.uptimeSeconds = GetTickCount64() / 1000;
+
+        if (previous) {
+            double seconds = std::chrono::duration<double>(now.takenAt - previous->takenAt).count();
+            ULONGLONG idleDelta = now.idle - previous->idle;
+            ULONGLONG busyDelta = now.busy - previous->busy;
+            if (idleDelta + busyDelta > 0) {
+                next.cpuPercent = 100.0 * busyDelta / (idleDelta + busyDelta);
+            }
+            if (seconds > 0) {
+                auto rate = [seconds](ULONGLONG current, ULONGLONG before) {
+                    return current >= before ? (current - before) / seconds : 0.0;
+                };
+                next.diskReadPerSecond = rate(now.diskRead, previous->diskRead);
+                next.diskWritePerSecond = rate(now.diskWritten, previous->diskWritten);
+                next.networkReceivePerSecond = rate(now.networkIn, previous->networkIn);
+                next.networkSendPerSecond = rate(now.networkOut, previous->networkOut);
+            }
+        }
+        previous = now;
+        next.sampleCount = ++sampleCount;
+
+        Slot& slot = slots[published.load(std::memory_order_relaxed) ^ 1];
+        slot.sequence.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.data = next;
+        slot.sequence.fetch_add(1, std::memory_order_release);
+        published.store(published.load(std::memory_order_relaxed) ^ 1, std::memory_order_release);
+    }
+};
+
+class GitStatusCache {
+public:
+    void attachThreadPool(ThreadPool& pool) {
+        threadPool = &pool;
+    }
+
+    // Returns "branch", "branch*" when tracked files changed, or "" outside a repository.
+    // Never blocks on the dirty check; it runs on the pool and shows up on a later prompt.
+    std::string describe(const fs::path& dir) {
+        auto repo = findRepository(dir);
+        if (!repo) return "";
+
+        refreshHead(*repo);
+        scheduleDirtyCheck(repo);
+
+        std::string label = repo->label;
+        if (repo->dirty.load() == 1) label += "*";
+        return label;
+    }
+
+private:
+    struct Repository {
+        fs::path workTree;
+        fs::path gitDir;
+        fs::path commonDir;
+        fs::file_time_type headTime{};
+        fs::file_time_type packedRefsTime{};
+        fs::file_time_type indexTime{};
+        std::string label;
+        std::atomic<int> dirty{-1};
+        std::atomic<bool> scanning{false};
+        std::chrono::steady_clock::time_point lastScan{};
+    };
+
+    struct Discovery {
+        std::shared_ptr<Repository> repo;
+        std::chrono::steady_clock::time_point checkedAt;
+    };
+
+    static constexpr auto DISCOVERY_TTL = std::chrono::seconds(2);
+    static constexpr auto RESCAN_INTERVAL = std::chrono::seconds(2);
+
+    ThreadPool* threadPool = nullptr;
+    std::map<std::string, Discovery> discoveries;
+    std::map<std::string, std::shared_ptr<Repository>> repositories;
+
+    static fs::file_time_type modifiedTime(const fs::path& path) {
+        std::error_code ec;
+        auto time = fs::last_write_time(path, ec);
+        return ec ? fs::file_time_type{} : time;
+    }
+
+    static std::string readFirstLine(const fs::path& path) {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+            line.pop_back();
+        }
+        return line;
+    }
+
+    std::shared_ptr<Repository> findRepository(const fs::path& dir) {
+        auto now = std::chrono::steady_clock::now();
+        auto& discovery = discoveries[dir.string()];
+        if (discovery.checkedAt != std::chrono::steady_clock::time_point{} &&
+            now - discovery.checkedAt < DISCOVERY_TTL) {
+            return discovery.repo;
+        }
+        discovery.checkedAt = now;
+        discovery.repo = nullptr;
+
+        std::error_code ec;
+        for (fs::path current = dir; !current.empty(); current = current.parent_path()) {
+            fs::path dotGit = current / ".git";
+            auto status = fs::status(dotGit, ec);
+
+            fs::path gitDir;
+            if (fs::is_directory(status)) {
+                gitDir = dotGit;
+            } else if (fs::is_regular_file(status)) {
+                std::string line = readFirstLine(dotGit);
+                if (line.rfind("gitdir: ", 0) == 0) {
+                    gitDir = fs::u8path(line.substr(8));
+                    if (gitDir.is_relative()) gitDir = current / gitDir;
+                }
+            }
+
+            if (!gitDir.empty()) {
+                auto& repo = repositories[current.string()];
+                if (!repo) {
+                    repo = std::make_shared<Repository>();
+                    repo->workTree = current;
+                    repo->gitDir = gitDir.lexically_normal();
+                    std::string common = readFirstLine(repo->gitDir / "commondir");
+                    repo->commonDir = common.empty()
+                        ? repo->gitDir
+                        : (repo->gitDir / fs::u8path(common)).lexically_normal();
+                }
+                discovery.repo = repo;
+                break;
+            }
+
+            if (current == current.root_path() || current.parent_path() == current) break;
+        }
+        return discovery.repo;
+    }
+
+    void refreshHead(Repository& repo) {
+        auto headTime = modifiedTime(repo.gitDir / "HEAD");
+        auto packedTime = modifiedTime(repo.commonDir / "packed-refs");
+        if (!repo.label.empty() && headTime == repo.headTime && packedTime == repo.packedRefsTime) {
+            return;
+        }
+        repo.headTime = headTime;
+        repo.packedRefsTime = packedTime;
+
+        std::string head = readFirstLine(repo.gitDir / "HEAD");
+        if (head.rfind("ref: ", 0) == 0) {
+            std::string ref = head.substr(5);
+            repo.label = ref.rfind("refs/heads/", 0) == 0 ? ref.substr(11) : ref;
+        } else if (head.size() >= 40) {
+            std::string name = findPackedRefName(repo, head.substr(0, 40));
+            repo.label = name.empty() ? head.substr(0, 7) : name;
+        } else {
+            repo.label = "?";
+        }
+    }
+
+    // Names a detached HEAD after a tag or branch from packed-refs that points at it.
+    static std::string findPackedRefName(const Repository& repo, const std::string& commit) {
+        std::ifstream packed(repo.commonDir / "packed-refs");
+        std::string line;
+        std::string previousRef;
+        std::string match;
+        while (std::getline(packed, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            if (line[0] == '^') {
+                if (line.compare(1, 40, commit) == 0 && !previousRef.empty()) match = previousRef;
+                continue;
+            }
+            previousRef = line.size() > 41 ? line.substr(41) : "";
+            while (!previousRef.empty() && previousRef.back() == '\r') previousRef.pop_back();
+            if (line.compare(0, 40, commit) == 0) match = previousRef;
+            if (!match.empty() && match.rfind("refs/tags/", 0) == 0) break;
+        }
+
+        for (const char* prefix : {"refs/tags/", "refs/heads/", "refs/remotes/"}) {
+            if (match.rfind(prefix, 0) == 0) return match.substr(std::char_traits<char>::length(prefix));
+        }
+        return match;
+    }
+
+    void scheduleDirtyCheck(const std::shared_ptr<Repository>& repo) {
+        if (!threadPool || repo->scanning.load()) return;
+
+        auto now = std::chrono::steady_clock::now();
+        auto indexTime = modifiedTime(repo->gitDir / "index");
+        if (repo->dirty.load() != -1 && indexTime == repo->indexTime && now - repo->lastScan < RESCAN_INTERVAL) {
+            return;
+        }
+        repo->indexTime = indexTime;
+        repo->lastScan = now;
+        repo->scanning = true;
+
+        threadPool->enqueue([repo]() {
+            repo->dirty = computeDirty(*repo);
+            repo->scanning = false;
+        });
+    }
+
+    static uint32_t readBigEndian32(const std::vector<char>& data, size_t pos) {
+        const auto* p = reinterpret_cast<const unsigned char*>(data.data() + pos);
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    // Compares the stat data recorded in .git/index against the work tree, like git's
+    // racy-clean check: tracked files only, and a touched file counts as modified.
+    static int computeDirty(const Repository& repo) {
+        std::ifstream file(repo.gitDir / "index", std::ios::binary);
+        if (!file) return -1;
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() < 12 || std::memcmp(data.data(), "DIRC", 4) != 0) return -1;
+
+        uint32_t version = readBigEndian32(data, 4);
+        uint32_t count = readBigEndian32(data, 8);
+        if (version < 2 || version > 4) return -1;
+
+        size_t pos = 12;
+        std::string path;
+        for (uint32_t i = 0; i < count; ++i) {
+            size_t entryStart = pos;
+            if (pos + 62 > data.size()) return -1;
+
+            uint32_t mtimeSeconds = readBigEndian32(data, pos + 8);
+            uint32_t mtimeNanos = readBigEndian32(data, pos + 12);
+            uint32_t mode = readBigEndian32(data, pos + 24);
+            uint32_t size = readBigEndian32(data, pos + 36);
+            uint16_t flags = static_cast<uint16_t>((readBigEndian32(data, pos + 58)) & 0xFFFF);
+            pos += 62;
+
+            bool skipWorktree = false;
+            if (version >= 3 && (flags & 0x4000)) {
+                if (pos + 2 > data.size()) return -1;
+                skipWorktree = (static_cast<unsigned char>(data[pos]) & 0x40) != 0;
+                pos += 2;
+            }
+
+            if (version == 4) {
+                size_t strip = 0;
+                unsigned char c;
+                do {
+                    if (pos >= data.size()) return -1;
+                    c = static_cast<unsigned char>(data[pos++]);
+                    strip = (strip << 7) | (c & 0x7F);
+                    if (c & 0x80) ++strip;
+                } while (c & 0x80);
+                if (strip > path.size()) return -1;
+                path.resize(path.size() - strip);
+            } else {
+                path.clear();
+            }
+
+            auto nul = std::find(data.begin() + pos, data.end(), '\0');
+            if (nul == data.end()) return -1;
+            path.append(data.begin() + pos, nul);
+            pos = static_cast<size_t>(nul - data.begin()) + 1;
+            if (version != 4) {
+                pos = entryStart + ((pos - entryStart + 7) & ~size_t{7});
+            }
+
+            bool gitlink = (mode & 0170000) == 0160000;
+            if (gitlink || skipWorktree) continue;
+
+            WIN32_FILE_ATTRIBUTE_DATA info;
+            fs::path fullPath = repo.workTree / fs::u8path(path);
+            if (!GetFileAttributesExW(fullPath.c_str(), GetFileExInfoStandard, &info)) return 1;
+            if (info.nFileSizeLow != size) return 1;
+
+            ULONGLONG ticks = (ULONGLONG(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+            ULONGLONG unixTicks = ticks - 116444736000000000ULL;
+            if (unixTicks / 10000000ULL != mtimeSeconds) return 1;
+            if (mtimeNanos != 0 && unixTicks % 10000000ULL != mtimeNanos / 100) return 1;
+        }
+        return 0;
+    }
+};
+
+class CompletionTrie {
+public:
+    void clear() {
+        root.children.clear();
+        root.terminal = false;
+    }
+
+    void insert(const std::string& word) {
+        Node* node = &root;
+        size_t pos = 0;
+        while (pos < word.size()) {
+            auto it = findChild(*node, word[pos]);
+            if (it == node->children.end() || (*it)->label[0] != word[pos]) {
+                auto leaf = std::make_unique<Node>();
+                leaf->label = word.substr(pos);
+                leaf->terminal = true;
+                node->children.insert(it, std::move(leaf));
+                return;
+            }
+
+            Node& child = **it;
+            size_t common = 0;
+            while (common < child.label.size() && pos + common < word.size() &&
+                   child.label[common] == word[pos + common]) {
+                ++common;
+            }
+            if (common < child.label.size()) {
+                auto tail = std::make_unique<Node>();
+                tail->label = child.label.substr(common);
+                tail->terminal = child.terminal;
+                tail->children = std::move(child.children);
+                child.label.resize(common);
+                child.terminal = false;
+                child.children.clear();
+                child.children.push_back(std::move(tail));
+            }
+            node = &child;
+            pos += common;
+        }
+        node->terminal = true;
+    }
+
+    // Returns up to `limit` words starting with `prefix`, in sorted order.
+    std::vector<std::string> complete(const std::string& prefix, size_t limit) const {
+        std::vector<std::string> results;
+        const Node* node = &root;
+        std::string path;
+        size_t pos = 0;
+        while (pos < prefix.size()) {
+            auto it = findChild(*node, prefix[pos]);
+            if (it == node->children.end() || (*it)->label[0] != prefix[pos]) return results;
+
+            const Node& child = **it;
+            size_t length = std::min(child.label.size(), prefix.size() - pos);
+            if (child.label.compare(0, length, prefix, pos, length) != 0) return results;
+            path += child.label;
+            pos += child.label.size();
+            node = &child;
+        }
+        collect(*node, path, limit, results);
+        return results;
+    }
+
+private:
+    struct Node {
+        std::string label;
+        bool terminal = false;
+        std::vector<std::unique_ptr<Node>> children;
+    };
+
+    Node root;
+
+    static std::vector<std::unique_ptr<Node>>::const_iterator findChild(const Node& node, char first) {
+        return std::lower_bound(node.children.begin(), node.children.end(), first,
+            [](const std::unique_ptr<Node>& child, char c) { return child->label[0] < c; });
+    }
+
+    static std::vector<std::unique_ptr<Node>>::iterator findChild(Node& node, char first) {
+        return std::lower_bound(node.children.begin(), node.children.end(), first,
+            [](const std::unique_ptr<Node>& child, char c) { return child->label[0] < c; });
+    }
+
+    static void collect(const Node& node, std::string& path, size_t limit, std::vector<std::string>& results) {
+        if (results.size() >= limit) return;
+        if (node.terminal) results.push_back(path);
+        for (const auto& child : node.children) {
+            path += child->label;
+            collect(*child, path, limit, results);
+            path.resize(path.size() - child->label.size());
+        }
+    }
+};
+
+// Sorted, case-folded directory listings keyed by directory path and revalidated against
+// the directory's last-write time. Listings are read on the thread pool; a lookup waits
+// only briefly, so a huge directory completes on a later Tab instead of stalling input.
+class PathCompletionCache {
+public:
+    struct Matches {
+        std::vector<std::string> names;
+        std::string commonPrefix;
+        size_t total = 0;
+        bool pending = false;
+    };
+
+    void attachThreadPool(ThreadPool& pool) {
+        threadPool = &pool;
+    }
+
+    Matches complete(const fs::path& dir, const std::string& prefix, size_t limit) {
+        Matches matches;
+        WIN32_FILE_ATTRIBUTE_DATA info;
+        if (!GetFileAttributesExW(dir.c_str(), GetFileExInfoStandard, &info)) return matches;
+        ULONGLONG modified = (ULONGLONG(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+
+        std::string key = dir.string();
+        auto& entry = entries[key];
+        if (!entry.listing.valid() || entry.modified != modified) {
+            entry.modified = modified;
+            if (threadPool) {
+                entry.listing = threadPool->enqueue([dir] { return readListing(dir); }).share();
+            } else {
+                std::promise<std::shared_ptr<const Listing>> ready;
+                ready.set_value(readListing(dir));
+                entry.listing = ready.get_future().share();
+            }
+        }
+        entry.lastUsed = ++useCounter;
+        evictIfNeeded();
+
+        auto listing = entries[key].listing;
+        if (listing.wait_for(SYNC_BUDGET) != std::future_status::ready) {
+            matches.pending = true;
+            return matches;
+        }
+
+        const auto& items = listing.get()->items;
+        std::string folded = fold(prefix);
+        auto first = std::lower_bound(items.begin(), items.end(), folded,
+            [](const Item& item, const std::string& value) { return item.key < value; });
+        auto last = first;
+        while (last != items.end() && last->key.compare(0, folded.size(), folded) == 0) {
+            if (matches.names.size() < limit) {
+                matches.names.push_back(last->directory ? last->name + "\\" : last->name);
+            }
+            ++last;
+        }
+        matches.total = static_cast<size_t>(last - first);
+        if (matches.total > 0) {
+            const Item& front = *first;
+            const Item& back = *(last - 1);
+            size_t common = 0;
+            while (common < front.key.size() && common < back.key.size() && front.key[common] == back.key[common]) {
+                ++common;
+            }
+            matches.commonPrefix = front.name.substr(0, common);
+            if (matches.total == 1 && front.directory) matches.commonPrefix += "\\";
+        }
+        return matches;
+    }
+
+private:
+    struct Item {
+        std::string key;
+        std::string name;
+        bool directory;
+    };
+
+    struct Listing {
+        std::vector<Item> items;
+    };
+
+    struct Entry {
+        ULONGLONG modified = 0;
+        uint64_t lastUsed = 0;
+        std::shared_future<std::shared_ptr<const Listing>> listing;
+    };
+
+    static constexpr size_t MAX_DIRECTORIES = 64;
+    static constexpr auto SYNC_BUDGET = std::chrono::milliseconds(25);
+
+    ThreadPool* threadPool = nullptr;
+    std::map<std::string, Entry> entries;
+    uint64_t useCounter = 0;
+
+    static std::string fold(const std::string& text) {
+        std::string result = text;
+        for (char& c : result) {
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        }
+        return result;
+    }
+
+    static std::shared_ptr<const Listing> readListing(const fs::path& dir) {
+        auto listing = std::make_shared<Listing>();
+        WIN32_FIND_DATAW data;
+        fs::path pattern = dir / "*";
+        HANDLE find = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &data,
+                                       FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE) return listing;
+        do {
+            std::wstring name = data.cFileName;
+            if (name == L"." || name == L"..") continue;
+            std::string utf8 = TextEncoding::toUtf8(name);
+            listing->items.push_back(Item{fold(utf8), std::move(utf8),
+                                          (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0});
+        } while (FindNextFileW(find, &data));
+        FindClose(find);
+
+        std::sort(listing->items.begin(), listing->items.end(),
+            [](const Item& a, const Item& b) { return a.key < b.key; });
+        return listing;
+    }
+
+    void evictIfNeeded() {
+        if (entries.size() <= MAX_DIRECTORIES) return;
+        auto oldest = std::min_element(entries.begin(), entries.end(),
+            [](const auto& a, const auto& b) { return a.second.lastUsed < b.second.lastUsed; });
+        entries.erase(oldest);
+    }
+};
+
+class TabCompleter {
+public:
+    struct Result {
+        size_t replaceFrom = 0;
+        std::string replacement;
+        std::vector<std::string> candidates;
+        size_t totalCandidates = 0;
+    };
+
+    void attachThreadPool(ThreadPool& pool) {
+        paths.attachThreadPool(pool);
+    }
+
+    void rebuild(const std::map<std::string, std::unique_ptr<Command>>& cmds,
+                 const std::map<std::string, std::string>& aliases) {
+        commands = &cmds;
+        aliasTargets = aliases;
+        commandNames.clear();
+        for (const auto& [name, cmd] : cmds) commandNames.insert(name);
+        for (const auto& [alias, target] : aliases) commandNames.insert(alias);
+    }
+
+    // Completes the token that ends at `cursorPos`: a command name for the first token,
+    // otherwise the command's own completions plus file system paths.
+    Result complete(const std::string& input, size_t cursorPos) {
+        Result result;
+        bool inQuotes = false;
+        size_t tokenStart = 0;
+        bool firstToken = true;
+        for (size_t i = 0; i < cursorPos; ++i) {
+            if (input[i] == '"') inQuotes = !inQuotes;
+            else if (input[i] == ' ' && !inQuotes) {
+                tokenStart = i + 1;
+                if (i > 0 && input[i - 1] != ' ') firstToken = false;
+            }
+        }
+        for (size_t i = 0; i < tokenStart && firstToken; ++i) {
+            if (input[i] != ' ') firstToken = false;
+        }
+
+        bool quoted = tokenStart < cursorPos && input[tokenStart] == '"';
+        std::string token = input.substr(tokenStart + (quoted ? 1 : 0), cursorPos - tokenStart - (quoted ? 1 : 0));
+        result.replaceFrom = tokenStart;
+
+        std::string common;
+        std::string suffix;
+        if (firstToken) {
+            result.candidates = commandNames.complete(token, MAX_CANDIDATES);
+            result.totalCandidates = result.candidates.size();
+            if (!result.candidates.empty()) {
+                common = commonPrefix(result.candidates.front(), result.candidates.back());
+            }
+            if (result.totalCandidates == 1) suffix = " ";
+        } else {
+            size_t slash = token.find_last_of("\\/");
+            std::string dirPart = slash == std::string::npos ? "" : token.substr(0, slash + 1);
+            std::string namePart = slash == std::string::npos ? token : token.substr(slash + 1);
+            fs::path dir = dirPart.empty() ? fs::current_path() : fs::u8path(dirPart);
+            if (dir.is_relative()) dir = fs::current_path() / dir;
+
+            auto matches = paths.complete(dir, namePart, MAX_CANDIDATES);
+            if (matches.pending) {
+                std::cout << '\a';
+                return result;
+            }
+            for (auto& name : matches.names) result.candidates.push_back(dirPart + name);
+            result.totalCandidates = matches.total;
+            common = matches.total > 0 ? dirPart + matches.commonPrefix : token;
+
+            size_t nameStart = input.find_first_not_of(' ');
+            std::string commandName = input.substr(nameStart, input.find(' ', nameStart) - nameStart);
+            if (auto alias = aliasTargets.find(commandName); alias != aliasTargets.end()) {
+                commandName = alias->second;
+            }
+            if (commands) {
+                if (auto it = commands->find(commandName); it != commands->end()) {
+                    for (auto& extra : it->second->getCompletions(token)) {
+                        common = result.totalCandidates > 0 ? commonPrefix(common, extra) : extra;
+                        result.candidates.push_back(std::move(extra));
+                        ++result.totalCandidates;
+                    }
+                }
+            }
+            bool needsQuote = quoted || common.find(' ') != std::string::npos;
+            if (result.totalCandidates == 1 && !common.empty() && common.back() != '\\') {
+                suffix = needsQuote ? "\" " : " ";
+            }
+            quoted = needsQuote;
+        }
+
+        if (result.totalCandidates == 0) return result;
+        result.replacement = (quoted ? "\"" : "") + common + suffix;
+        return result;
+    }
+
+private:
+    static constexpr size_t MAX_CANDIDATES = 200;
+
+    CompletionTrie commandNames;
+    PathCompletionCache paths;
+    const std::map<std::string, std::unique_ptr<Command>>* commands = nullptr;
+    std::map<std::string, std::string> aliasTargets;
+
+    static std::string commonPrefix(const std::string& a, const std::string& b) {
+        auto end = std::mismatch(a.begin(), a.begin() + std::min(a.size(), b.size()), b.begin()).first;
+        return std::string(a.begin(), end);
+    }
+};
+
+// Bounded output history: fixed-size chunks in a ring (oldest dropped once the byte cap is
+// reached), each with the offsets of the lines that start in it. Line numbers stay absolute,
+// so seeking to a line is a binary search over chunks plus an index lookup.
+class ScrollbackBuffer {
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    explicit ScrollbackBuffer(size_t maxBytes = 64 * 1024 * 1024) {
+        setCapacity(maxBytes);
+    }
+
+    void setCapacity(size_t maxBytes) {
+        maxChunks = std::max<size_t>(2, maxBytes / CHUNK_SIZE);
+        trim();
+    }
+
+    void clear() {
+        while (!chunks.empty()) recycle();
+        totalLines = 0;
+        atLineStart = true;
+        droppedBytes = 0;
+    }
+
+    void append(const char* data, size_t size) {
+        while (size > 0) {
+            if (chunks.empty() || chunks.back().data.size() == CHUNK_SIZE) {
+                startChunk();
+            }
+            Chunk& chunk = chunks.back();
+            size_t count = std::min(size, CHUNK_SIZE - chunk.data.size());
+            size_t base = chunk.data.size();
+            chunk.data.append(data, count);
+
+            size_t pos = 0;
+            while (pos < count) {
+                if (atLineStart) {
+                    chunk.lineStarts.push_back(static_cast<uint32_t>(base + pos));
+                    ++totalLines;
+                    atLineStart = false;
+                }
+                const void* newline = std::memchr(data + pos, '\n', count - pos);
+                if (!newline) break;
+                pos = static_cast<size_t>(static_cast<const char*>(newline) - data) + 1;
+                atLineStart = true;
+            }
+            data += count;
+            size -= count;
+        }
+    }
+
+    uint64_t firstLine() const {
+        for (const auto& chunk : chunks) {
+            if (!chunk.lineStarts.empty()) return chunk.firstLine;
+        }
+        return totalLines;
+    }
+
+    uint64_t endLine() const { return totalLines; }
+    bool hasDroppedOutput() const { return droppedBytes > 0; }
+
+    // Returns line `number` without its line terminator; empty if it is no longer buffered.
+    std::string line(uint64_t number) const {
+        std::string result;
+        if (chunks.empty() || number < firstLine() || number >= totalLines) return result;
+
+        auto it = std::upper_bound(chunks.begin(), chunks.end(), number,
+            [](uint64_t value, const Chunk& chunk) { return value < chunk.firstLine; });
+        size_t chunkIndex = static_cast<size_t>(it - chunks.begin()) - 1;
+        size_t offset = chunks[chunkIndex].lineStarts[number - chunks[chunkIndex].firstLine];
+
+        for (; chunkIndex < chunks.size(); ++chunkIndex, offset = 0) {
+            const std::string& data = chunks[chunkIndex].data;
+            size_t end = data.find('\n', offset);
+            if (end != std::string::npos) {
+                result.append(data, offset, end - offset);
+                break;
+            }
+            result.append(data, offset, std::string::npos);
+        }
+        if (!result.empty() && result.back() == '\r') result.pop_back();
+        return result;
+    }
+
+private:
+    struct Chunk {
+        std::string data;
+        uint64_t firstLine = 0;
+        std::vector<uint32_t> lineStarts;
+    };
+
+    std::deque<Chunk> chunks;
+    std::vector<Chunk> spare;
+    size_t maxChunks = 2;
+    uint64_t totalLines = 0;
+    uint64_t droppedBytes = 0;
+    bool atLineStart = true;
+
+    void startChunk() {
+        Chunk chunk;
+        if (!spare.empty()) {
+            chunk = std::move(spare.back());
+            spare.pop_back();
+        } else {
+            chunk.data.reserve(CHUNK_SIZE);
+        }
+        chunk.firstLine = totalLines;
+        chunks.push_back(std::move(chunk));
+        trim();
+    }
+
+    void recycle() {
+        Chunk chunk = std::move(chunks.front());
+        chunks.pop_front();
+        droppedBytes += chunk.data.size();
+        chunk.data.clear();
+        chunk.lineStarts.clear();
+        if (spare.empty()) spare.push_back(std::move(chunk));
+    }
+
+    void trim() {
+        while (chunks.size() > maxChunks) recycle();
+    }
+};
+
+class ScrollbackStreamBuf : public std::streambuf {
+public:
+    explicit ScrollbackStreamBuf(ScrollbackBuffer& target) : scrollback(target) {}
+
+protected:
+    int overflow(int ch) override {
+        if (ch != traits_type::eof()) {
+            char c = static_cast<char>(ch);
+            scrollback.append(&c, 1);
+        }
+        return ch;
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize count) override {
+        scrollback.append(data, static_cast<size_t>(count));
+        return count;
+    }
+
+private:
+    ScrollbackBuffer& scrollback;
+};
+
+// Full-screen viewer over a ScrollbackBuffer on the console's alternate screen.
+// Only the visible window is materialized, and redraws go through the frame diff.
+class Pager {
+public:
+    Pager(int w, int h, WORD text, WORD status) : width(w), height(h), textAttr(text), statusAttr(status),
+        renderer(w, h, FrameRenderer::Anchor::Screen) {}
+
+    void run(const ScrollbackBuffer& buffer, const std::string& title) {
+        std::cout << "\x1b[?1049h" << std::flush;
+        uint64_t top = buffer.firstLine();
+        std::string pendingNumber;
+        int rows = height - 1;
+
+        while (true) {
+            uint64_t first = buffer.firstLine();
+            uint64_t last = buffer.endLine() > static_cast<uint64_t>(rows) ? buffer.endLine() - rows : 0;
+            top = std::clamp(top, first, std::max(first, last));
+            render(buffer, title, top, pendingNumber);
+
+            int ch = _getch();
+            if (ch == 0 || ch == 224) {
+                switch (_getch()) {
+                    case 72: ch = 'k'; break;
+                    case 80: ch = 'j'; break;
+                    case 73: ch = 'b'; break;
+                    case 81: ch = ' '; break;
+                    case 71: ch = 'g'; break;
+                    case 79: ch = 'G'; break;
+                    default: continue;
+                }
+            }
+
+            if (ch >= '0' && ch <= '9') {
+                pendingNumber += static_cast<char>(ch);
+                continue;
+            }
+            if (!pendingNumber.empty() && (ch == 'g' || ch == 13)) {
+                uint64_t target = std::stoull(pendingNumber);
+                top = target > 0 ? target - 1 : 0;
+                pendingNumber.clear();
+                continue;
+            }
+            pendingNumber.clear();
+
+            if (ch == 'q' || ch == 27 || ch == 3) break;
+            else if (ch == 'j' || ch == 13) top += 1;
+            else if (ch == 'k') top = top > 0 ? top - 1 : 0;
+            else if (ch == ' ' || ch == 'f') top += rows;
+            else if (ch == 'b') top = top > static_cast<uint64_t>(rows) ? top - rows : 0;
+            else if (ch == 'g') top = 0;
+            else if (ch == 'G') top = last;
+        }
+
+        std::cout << "\x1b[?1049l" << std::flush;
+    }
+
+private:
+    int width;
+    int height;
+    WORD textAttr;
+    WORD statusAttr;
+    FrameRenderer renderer;
+
+    void render(const ScrollbackBuffer& buffer, const std::string& title, uint64_t top, const std::string& pendingNumber) {
+        ScreenBuffer& frame = renderer.frame();
+        frame.clear(textAttr);
+        int rows = height - 1;
+
+        for (int row = 0; row < rows && top + row < buffer.endLine(); ++row) {
+            std::string text = buffer.line(top + row);
+            int col = 0;
+            for (size_t i = 0; i < text.size() && col < width;) {
+                if (text[i] == '\t') {
+                    col = (col / 8 + 1) * 8;
+                    ++i;
+                    continue;
+                }
+                char32_t cp = ScreenBuffer::decodeUtf8(text, i);
+                frame.fill(row, col++, 1, cp < 32 ? U'?' : cp, textAttr);
+            }
+        }
+
+        uint64_t total = buffer.endLine();
+        uint64_t bottom = std::min<uint64_t>(top + rows, total);
+        std::ostringstream status;
+        status << ' ' << title << "  Zeilen " << (total ? top + 1 : 0) << "-" << bottom << " von " << total;
+        if (total > 0) status << " (" << bottom * 100 / total << "%)";
+        if (buffer.hasDroppedOutput()) status << "  [aeltere Ausgabe verworfen]";
+        if (!pendingNumber.empty()) status << "  :" << pendingNumber;
+        status << "  q=Ende j/k b/Leer g/G <n>g";
+        frame.fill(rows, 0, width, U' ', statusAttr);
+        frame.put(rows, 0, status.str(), statusAttr);
+
+        renderer.present(rows, std::min(width - 1, static_cast<int>(ScreenBuffer::columnCount(status.str()))), textAttr);
+    }
+};
+
+// Live process list in the style of top. Every refresh renders a complete frame, and
+// FrameRenderer writes only the cells that changed, which are mostly a few CPU and
+// memory columns.
+class ProcessView {
+public:
+    ProcessView(int w, int h, WORD text, WORD header) : width(w), height(h), textAttr(text), headerAttr(header),
+        renderer(w, h, FrameRenderer::Anchor::Screen) {}
+
+    // `table` must already hold a sample; CPU shares show 0 until the first interval
+    // has passed. Returns false when the table could no longer be refreshed.
+    bool run(ProcessTable& table, ProcessTable::SortKey sortKey, std::chrono::milliseconds interval) {
+        std::cout << "\x1b[?1049h\x1b[?25l" << std::flush;
+        ConsoleInterrupt::reset();
+        auto due = std::chrono::steady_clock::now() + interval;
+        bool changed = true;
+        bool ok = true;
+        while (!ConsoleInterrupt::requested()) {
+            if (changed) {
+                table.sort(sortKey);
+                render(table, sortKey);
+                changed = false;
+            }
+            if (std::chrono::steady_clock::now() >= due) {
+                if (!table.refresh()) {
+                    ok = false;
+                    break;
+                }
+                due += interval;
+                changed = true;
+                continue;
+            }
+            if (!_kbhit()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(KEY_POLL_MS));
+                continue;
+            }
+            int ch = _getch();
+            if (ch == 0 || ch == 224) {
+                _getch();
+                continue;
+            }
+            if (ch == 'q' || ch == 27 || ch == 3) break;
+            if (ch == 'c') sortKey = ProcessTable::SortKey::Cpu;
+            else if (ch == 'm') sortKey = ProcessTable::SortKey::Memory;
+            else if (ch == 'p') sortKey = ProcessTable::SortKey::Pid;
+            else if (ch == 'n') sortKey = ProcessTable::SortKey::Name;
+            changed = true;
+        }
+        std::cout << "\x1b[?25h\x1b[?1049l" << std::flush;
+        return ok;
+    }
+
+private:
+    static constexpr int KEY_POLL_MS = 50;
+
+    int width;
+    int height;
+    WORD textAttr;
+    WORD headerAttr;
+    FrameRenderer renderer;
+
+    void render(const ProcessTable& table, ProcessTable::SortKey sortKey) {
+        static const char* sortNames[] = {"pid", "name", "cpu", "mem"};
+        ScreenBuffer& frame = renderer.frame();
+        frame.clear(textAttr);
+
+        const auto& processes = table.processes();
+        ULONG threads = 0;
+        for (const auto& process : processes) threads += process.threads;
+        char line[256];
+        std::snprintf(line, sizeof(line), " %zu Prozesse, %lu Threads, CPU %5.1f %%   Sortierung: %s   q=Ende c/m/p/n=Sortierung",
+                 processes.size(), static_cast<unsigned long>(threads), table.totalCpuPercent(),
+                 sortNames[static_cast<int>(sortKey)]);
+        frame.put(0, 0, line, textAttr);
+        std::snprintf(line, sizeof(line), "%8s %8s %7s %6s %12s %12s  %s", "PID", "PPID", "Threads", "CPU %", "Speicher", "CPU-Zeit", "Name");
+        frame.fill(1, 0, width, U' ', headerAttr);
+        frame.put(1, 0, line, headerAttr);
+
+        for (int row = 2; row < height && static_cast<size_t>(row - 2) < processes.size(); ++row) {
+            const auto& process = processes[row - 2];
+            uint64_t seconds = process.cpuTime / 10000000;
+            std::snprintf(line, sizeof(line), "%8lu %8lu %7lu %6.1f %9.1f MB %5llu:%02llu:%02llu  ",
+                     static_cast<unsigned long>(process.pid), static_cast<unsigned long>(process.parentPid),
+                     static_cast<unsigned long>(process.threads), process.cpuPercent, process.workingSet / (1024.0 * 1024.0),
+                     static_cast<unsigned long long>(seconds / 3600), static_cast<unsigned long long>(seconds / 60 % 60),
+                     static_cast<unsigned long long>(seconds % 60));
+            int col = frame.put(row, 0, line, textAttr);
+            frame.put(row, col, process.name, textAttr);
+        }
+        renderer.present(height - 1, 0, textAttr);
+    }
+};
+
+// Copies and moves files and directory trees. Files on a block-cloning volume (ReFS)
+// are cloned by reference; everything else goes through CopyFileExW, which lets the
+// file system or SMB server offload the copy, with a plain unbuffered read/write
+// loop as the last resort. Files are copied in parallel on the thread pool, small
+// files in batches so per-task overhead does not dominate.
+class FileTransfer {
+public:
+    struct Progress {
+        std::atomic<uint64_t> bytesDone{0};
+        std::atomic<uint64_t> filesDone{0};
+        uint64_t totalBytes = 0;
+        uint64_t totalFiles = 0;
+    };
+
+    FileTransfer(ThreadPool& pool, bool overwrite) : pool(pool), overwrite(overwrite) {}
+
+    const Progress& progress() const { return state; }
+    const std::vector<std::string>& errors() const { return failures; }
+    bool renamedInPlace() const { return renamed; }
+    void cancel() { cancelled = true; }
+
+    // Copies `from` to `to`. `report` is called periodically from the calling thread.
+    bool copy(const fs::path& from, const fs::path& to, const std::function<void()>& report) {
+        std::error_code ec;
+        if (!fs::is_directory(from, ec)) {
+            detectCloning(from, to.parent_path().empty() ? fs::current_path() : to.parent_path());
+            auto size = fs::file_size(from, ec);
+            state.totalFiles = 1;
+            state.totalBytes = ec ? 0 : size;
+            TaskGroup group(pool);
+            group.run([this, from, to, size] { copyFile(from, to, size); });
+            while (!group.waitFor(std::chrono::milliseconds(REPORT_INTERVAL_MS))) report();
+            return failures.empty() && !cancelled;
+        }
+
+        fs::create_directories(to, ec);
+        if (ec) {
+            fail(to, ec.message());
+            return false;
+        }
+        detectCloning(from, to);
+
+        std::vector<std::pair<fs::path, fs::path>> directories{{from, to}};
+        std::vector<FileJob> batch;
+        uint64_t batchBytes = 0;
+        TaskGroup group(pool);
+        auto flush = [&] {
+            if (batch.empty()) return;
+            group.run([this, jobs = std::move(batch)] {
+                for (const auto& job : jobs) {
+                    if (cancelled) return;
+                    copyFile(job.from, job.to, job.size);
+                }
+            });
+            batch.clear();
+            batchBytes = 0;
+        };
+
+        auto lastReport = std::chrono::steady_clock::now();
+        for (auto it = fs::recursive_directory_iterator(from, fs::directory_options::skip_permission_denied, ec);
+             !ec && it != fs::recursive_directory_iterator() && !cancelled; it.increment(ec)) {
+            fs::path target = to / it->path().lexically_relative(from);
+            if (it->is_directory(ec)) {
+                std::error_code createError;
+                fs::create_directories(target, createError);
+                if (createError) fail(target, createError.message());
+                else directories.emplace_back(it->path(), target);
+                continue;
+            }
+
+            uint64_t size = it->file_size(ec);
+            if (ec) size = 0;
+            ec.clear();
+            state.totalFiles++;
+            state.totalBytes += size;
+            if (size >= SMALL_FILE_BYTES) {
+                group.run([this, source = it->path(), target, size] { copyFile(source, target, size); });
+            } else {
+                batch.push_back(FileJob{it->path(), target, size});
+                batchBytes += size;
+                if (batch.size() >= BATCH_FILES || batchBytes >= BATCH_BYTES) flush();
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastReport >= std::chrono::milliseconds(REPORT_INTERVAL_MS)) {
+                report();
+                lastReport = now;
+            }
+        }
+        if (ec) fail(from, ec.message());
+        flush();
+        while (!group.waitFor(std::chrono::milliseconds(REPORT_INTERVAL_MS))) report();
+
+        // Directory timestamps change whenever an entry is added, so they are
+        // restored deepest first once all files are in place.
+        for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
+            copyMetadata(it->first, it->second, true);
+        }
+        return failures.empty() && !cancelled;
+    }
+
+    // Renames within a volume; otherwise copies and removes the source once the copy
+    // completed without errors and was not cancelled.
+    bool move(const fs::path& from, const fs::path& to, const std::function<void()>& report) {
+        DWORD flags = overwrite ? MOVEFILE_REPLACE_EXISTING : 0;
+        if (MoveFileExW(from.c_str(), to.c_str(), flags)) {
+            renamed = true;
+            return true;
+        }
+        DWORD error = GetLastError();
+        if (error != ERROR_NOT_SAME_DEVICE) {
+            fail(from, systemMessage(error));
+            return false;
+        }
+        if (!copy(from, to, report)) return false;
+
+        // A copy that finished between two reports may still have an interrupt
+        // pending; the final report latches it before anything is deleted.
+        report();
+        if (cancelled) return false;
+
+        std::error_code ec;
+        fs::remove_all(from, ec);
+        if (ec) {
+            fail(from, ec.message());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct FileJob {
+        fs::path from;
+        fs::path to;
+        uint64_t size;
+    };
+
+    struct CopyContext {
+        FileTransfer* transfer;
+        uint64_t reported;
+    };
+
+    static constexpr uint64_t SMALL_FILE_BYTES = 1024 * 1024;
+    static constexpr size_t BATCH_FILES = 64;
+    static constexpr uint64_t BATCH_BYTES = 8 * 1024 * 1024;
+    static constexpr uint64_t UNBUFFERED_BYTES = 256ull * 1024 * 1024;
+    static constexpr uint64_t CLONE_CHUNK = 1ull << 30;
+    static constexpr DWORD STREAM_BUFFER = 4 * 1024 * 1024;
+    static constexpr int REPORT_INTERVAL_MS = 200;
+
+    ThreadPool& pool;
+    bool overwrite;
+    std::atomic<bool> cancelled{false};
+    bool renamed = false;
+    DWORD cloneClusterSize = 0;
+    Progress state;
+    std::mutex failureMutex;
+    std::vector<std::string> failures;
+
+    void fail(const fs::path& path, const std::string& message) {
+        std::lock_guard<std::mutex> lock(failureMutex);
+        failures.push_back(path.u8string() + ": " + message);
+    }
+
+    static std::string systemMessage(DWORD error) {
+        return std::system_category().message(static_cast<int>(error));
+    }
+
+    // Block cloning only works when source and target share a volume that supports it.
+    void detectCloning(const fs::path& from, const fs::path& to) {
+        wchar_t sourceRoot[MAX_PATH];
+        wchar_t targetRoot[MAX_PATH];
+        if (!GetVolumePathNameW(fs::absolute(from).c_str(), sourceRoot, MAX_PATH) ||
+            !GetVolumePathNameW(fs::absolute(to).c_str(), targetRoot, MAX_PATH) ||
+            _wcsicmp(sourceRoot, targetRoot) != 0) {
+            return;
+        }
+        DWORD flags = 0;
+        if (!GetVolumeInformationW(targetRoot, nullptr, 0, nullptr, nullptr, &flags, nullptr, 0) ||
+            !(flags & FILE_SUPPORTS_BLOCK_REFCOUNTING)) {
+            return;
+        }
+        DWORD sectorsPerCluster = 0, bytesPerSector = 0, freeClusters = 0, totalClusters = 0;
+        if (GetDiskFreeSpaceW(targetRoot, &sectorsPerCluster, &bytesPerSector, &freeClusters, &totalClusters)) {
+            cloneClusterSize = sectorsPerCluster * bytesPerSector;
+        }
+    }
+
+    void copyFile(const fs::path& from, const fs::path& to, uint64_t size) {
+        if (cancelled) return;
+        bool copied = cloneClusterSize != 0 && size > 0 && cloneFile(from, to, size);
+        if (!copied) {
+            CopyContext context{this, 0};
+            DWORD flags = overwrite ? 0 : COPY_FILE_FAIL_IF_EXISTS;
+            if (size >= UNBUFFERED_BYTES) flags |= COPY_FILE_NO_BUFFERING;
+            copied = CopyFileExW(from.c_str(), to.c_str(), copyProgress, &context, nullptr, flags);
+            if (!copied) {
+                DWORD error = GetLastError();
+                state.bytesDone -= context.reported;
+                if (error == ERROR_REQUEST_ABORTED || error == ERROR_FILE_EXISTS || error == ERROR_ACCESS_DENIED) {
+                    if (error != ERROR_REQUEST_ABORTED) fail(from, systemMessage(error));
+                    return;
+                }
+                copied = streamCopy(from, to, size);
+            }
+        }
+        if (copied) {
+            copyMetadata(from, to, false);
+            state.filesDone++;
+        }
+    }
+
+    static DWORD CALLBACK copyProgress(LARGE_INTEGER, LARGE_INTEGER transferred, LARGE_INTEGER, LARGE_INTEGER,
+                                       DWORD, DWORD, HANDLE, HANDLE, LPVOID data) {
+        auto* context = static_cast<CopyContext*>(data);
+        uint64_t total = static_cast<uint64_t>(transferred.QuadPart);
+        context->transfer->state.bytesDone += total - context->reported;
+        context->reported = total;
+        // Cancelling from the callback fails the copy with ERROR_REQUEST_ABORTED.
+        return context->transfer->cancelled ? PROGRESS_CANCEL : PROGRESS_CONTINUE;
+    }
+
+    bool cloneFile(const fs::path& from, const fs::path& to, uint64_t size) {
+        HANDLE source = CreateFileW(from.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING, 0, nullptr);
+        if (source == INVALID_HANDLE_VALUE) return false;
+        HANDLE target = CreateFileW(to.c_str(), GENERIC_READ | GENERIC_WRITE | DELETE, 0, nullptr,
+                                    overwrite ? CREATE_ALWAYS : CREATE_NEW, 0, nullptr);
+        if (target == INVALID_HANDLE_VALUE) {
+            CloseHandle(source);
+            return false;
+        }
+
+        DWORD returned = 0;
+        BY_HANDLE_FILE_INFORMATION info{};
+        GetFileInformationByHandle(source, &info);
+        bool ok = !(info.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) ||
+                  DeviceIoControl(target, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr);
+
+        FILE_END_OF_FILE_INFO endOfFile{};
+        endOfFile.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+        ok = ok && SetFileInformationByHandle(target, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+
+        // The last region is rounded up to a whole cluster; the end of file set above
+        // keeps the clone from growing past the source size.
+        uint64_t rounded = (size + cloneClusterSize - 1) / cloneClusterSize * cloneClusterSize;
+        for (uint64_t offset = 0; ok && offset < rounded && !cancelled; offset += CLONE_CHUNK) {
+            DUPLICATE_EXTENTS_DATA extents{};
+            extents.FileHandle = source;
+            extents.SourceFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+            extents.TargetFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+            extents.ByteCount.QuadPart = static_cast<LONGLONG>(std::min(CLONE_CHUNK, rounded - offset));
+            ok = DeviceIoControl(target, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &extents, sizeof(extents),
+                                 nullptr, 0, &returned, nullptr);
+        }
+
+        if (!ok || cancelled) {
+            FILE_DISPOSITION_INFO disposition{TRUE};
+            SetFileInformationByHandle(target, FileDispositionInfo, &disposition, sizeof(disposition));
+        } else {
+            state.bytesDone += size;
+        }
+        CloseHandle(target);
+        CloseHandle(source);
+        return ok && !cancelled;
+    }
+
+    bool streamCopy(const fs::path& from, const fs::path& to, uint64_t size) {
+        HANDLE source = CreateFileW(from.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (source == INVALID_HANDLE_VALUE) {
+            fail(from, systemMessage(GetLastError()));
+            return false;
+        }
+        HANDLE target = CreateFileW(to.c_str(), GENERIC_WRITE | DELETE, 0, nullptr,
+                                    overwrite ? CREATE_ALWAYS : CREATE_NEW, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (target == INVALID_HANDLE_VALUE) {
+            fail(to, systemMessage(GetLastError()));
+            CloseHandle(source);
+            return false;
+        }
+
+        // Reserving the final size up front avoids repeated extension of the target.
+        FILE_END_OF_FILE_INFO endOfFile{};
+        endOfFile.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+        SetFileInformationByHandle(target, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+
+        thread_local std::vector<char> buffer(STREAM_BUFFER);
+        uint64_t copied = 0;
+        bool ok = true;
+        while (!cancelled) {
+            DWORD read = 0;
+            DWORD written = 0;
+            if (!ReadFile(source, buffer.data(), STREAM_BUFFER, &read, nullptr)) {
+                fail(from, systemMessage(GetLastError()));
+                ok = false;
+                break;
+            }
+            if (read == 0) break;
+            if (!WriteFile(target, buffer.data(), read, &written, nullptr) || written != read) {
+                fail(to, systemMessage(GetLastError()));
+                ok = false;
+                break;
+            }
+            copied += read;
+            state.bytesDone += read;
+        }
+
+        ok = ok && !cancelled;
+        if (ok && copied != size) {
+            endOfFile.EndOfFile.QuadPart = static_cast<LONGLONG>(copied);
+            SetFileInformationByHandle(target, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+        }
+        if (!ok) {
+            FILE_DISPOSITION_INFO disposition{TRUE};
+            SetFileInformationByHandle(target, FileDispositionInfo, &disposition, sizeof(disposition));
+            state.bytesDone -= copied;
+        }
+        CloseHandle(target);
+        CloseHandle(source);
+        return ok;
+    }
+
+    // Carries over all three timestamps and the attribute bits; CopyFileExW keeps
+    // only the last write time.
+    void copyMetadata(const fs::path& from, const fs::path& to, bool directory) {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExW(from.c_str(), GetFileExInfoStandard, &data)) return;
+        HANDLE target = CreateFileW(to.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING, directory ? FILE_FLAG_BACKUP_SEMANTICS : 0, nullptr);
+        if (target != INVALID_HANDLE_VALUE) {
+            SetFileTime(target, &data.ftCreationTime, &data.ftLastAccessTime, &data.ftLastWriteTime);
+            CloseHandle(target);
+        }
+        DWORD preserved = FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_ARCHIVE;
+        if (data.dwFileAttributes & preserved) {
+            SetFileAttributesW(to.c_str(), data.dwFileAttributes & (preserved | FILE_ATTRIBUTE_DIRECTORY));
+        }
+    }
+};
+
+// Deletes a directory tree bottom-up on the thread pool. Every directory is listed
+// by its own task and its files are unlinked in batches; the directory itself goes
+// once its last child is gone. Names are removed with POSIX semantics, so a parent
+// is empty as soon as its children's handles close instead of waiting for pending
+// deletes to drain.
+class TreeRemover {
+public:
+    struct Counts {
+        std::atomic<uint64_t> files{0};
+        std::atomic<uint64_t> directories{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+
+    TreeRemover(ThreadPool& pool, bool dryRun) : pool(pool), dryRun(dryRun) {}
+
+    const Counts& counts() const { return totals; }
+    const std::vector<std::string>& errors() const { return failures; }
+    void cancel() { cancelled = true; }
+
+    bool remove(const fs::path& root, const std::function<void()>& report) {
+        TaskGroup group(pool);
+        auto node = std::make_shared<Node>();
+        node->path = root;
+        node->pending = 1;
+        group.run([this, &group, node] { listDirectory(group, node); });
+        while (!group.waitFor(std::chrono::milliseconds(REPORT_INTERVAL_MS))) report();
+        return failures.empty() && !cancelled;
+    }
+
+private:
+    struct Node {
+        fs::path path;
+        std::shared_ptr<Node> parent;
+        std::atomic<size_t> pending{0};
+    };
+
+    static constexpr size_t FILE_BATCH = 256;
+    static constexpr int REPORT_INTERVAL_MS = 200;
+
+    ThreadPool& pool;
+    bool dryRun;
+    std::atomic<bool> cancelled{false};
+    Counts totals;
+    std::mutex failureMutex;
+    std::vector<std::string> failures;
+
+    void fail(const fs::path& path, DWORD error) {
+        std::lock_guard<std::mutex> lock(failureMutex);
+        failures.push_back(path.u8string() + ": " + std::system_category().message(static_cast<int>(error)));
+    }
+
+    void listDirectory(TaskGroup& group, const std::shared_ptr<Node>& node) {
+        std::vector<std::pair<fs::path, uint64_t>> files;
+        // The directory handle is closed before the last reference is dropped: on
+        // volumes without POSIX delete semantics an open handle keeps the directory
+        // in place, and removing its parent would fail as not empty.
+        {
+            DirectoryReader reader(node->path);
+            bool complete = !cancelled && reader.forEach([&](const DirectoryReader::Entry& entry) {
+                fs::path child = node->path / std::wstring(entry.name, entry.nameLength);
+                // Junctions and symbolic links are removed as links, never followed.
+                if (entry.isDirectory() && !entry.isReparsePoint()) {
+                    auto sub = std::make_shared<Node>();
+                    sub->path = std::move(child);
+                    sub->parent = node;
+                    sub->pending = 1;
+                    node->pending++;
+                    group.run([this, &group, sub] { listDirectory(group, sub); });
+                    return;
+                }
+                files.emplace_back(std::move(child), entry.size);
+                if (files.size() == FILE_BATCH) {
+                    node->pending++;
+                    group.run([this, node, batch = std::move(files)] {
+                        removeFiles(batch);
+                        finish(node);
+                    });
+                    files.clear();
+                }
+            });
+            if (!complete && !cancelled) fail(node->path, reader.error());
+        }
+        removeFiles(files);
+        finish(node);
+    }
+
+    void removeFiles(const std::vector<std::pair<fs::path, uint64_t>>& files) {
+        for (const auto& [path, size] : files) {
+            if (cancelled) return;
+            if (dryRun || unlink(path, false)) {
+                totals.files++;
+                totals.bytes += size;
+            }
+        }
+    }
+
+    // Drops one reference; the last one removes the directory and releases its parent.
+    void finish(const std::shared_ptr<Node>& node) {
+        if (--node->pending != 0) return;
+        if (!cancelled && (dryRun || unlink(node->path, true))) {
+            totals.directories++;
+        }
+        if (node->parent) finish(node->parent);
+    }
+
+    bool unlink(const fs::path& path, bool directory) {
+        HANDLE handle = CreateFileW(path.c_str(), DELETE | FILE_READ_ATTRIBUTES | FILE_WRITE_ATTRIBUTES,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                    FILE_FLAG_OPEN_REPARSE_POINT | (directory ? FILE_FLAG_BACKUP_SEMANTICS : 0), nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            fail(path, GetLastError());
+            return false;
+        }
+
+        FILE_DISPOSITION_INFO_EX dispositionEx{FILE_DISPOSITION_FLAG_DELETE | FILE_DISPOSITION_FLAG_POSIX_SEMANTICS |
+                                               FILE_DISPOSITION_FLAG_IGNORE_READONLY_ATTRIBUTE};
+        bool ok = SetFileInformationByHandle(handle, FileDispositionInfoEx, &dispositionEx, sizeof(dispositionEx));
+        if (!ok) {
+            // File systems without POSIX delete (FAT, older NTFS) take the classic
+            // disposition, which refuses read-only files.
+            FILE_BASIC_INFO basic{};
+            if (GetFileInformationByHandleEx(handle, FileBasicInfo, &basic, sizeof(basic)) &&
+                (basic.FileAttributes & FILE_ATTRIBUTE_READONLY)) {
+                basic.FileAttributes &= ~static_cast<DWORD>(FILE_ATTRIBUTE_READONLY);
+                if (basic.FileAttributes == 0) basic.FileAttributes = FILE_ATTRIBUTE_NORMAL;
+                SetFileInformationByHandle(handle, FileBasicInfo, &basic, sizeof(basic));
+            }
+            FILE_DISPOSITION_INFO disposition{TRUE};
+            ok = SetFileInformationByHandle(handle, FileDispositionInfo, &disposition, sizeof(disposition));
+        }
+        DWORD error = ok ? 0 : GetLastError();
+        CloseHandle(handle);
+        if (!ok) fail(path, error);
+        return ok;
+    }
+};
+
+// Computes apparent and allocated sizes of a tree in parallel. Each directory's own
+// totals are cached under its file id and last write time; a directory whose time
+// is unchanged is not listed again, only opened to read that time. Content changes
+// to existing files do not touch the directory time and show up after a refresh.
+class DiskUsageScanner {
+public:
+    struct Usage {
+        uint64_t apparent = 0;
+        uint64_t allocated = 0;
+        uint64_t files = 0;
+        uint64_t directories = 0;
+    };
+
+    struct Line {
+        fs::path path;
+        size_t depth;
+        Usage usage;
+    };
+
+    struct Largest {
+        uint64_t allocated;
+        fs::path path;
+        bool directory;
+
+        bool operator>(const Largest& other) const { return allocated > other.allocated; }
+    };
+
+    static constexpr size_t MAX_TOP = 64;
+
+    class Cache {
+    public:
+        struct Directory {
+            uint64_t lastWriteTime = 0;
+            Usage own;
+            std::vector<std::wstring> subdirectories;
+            std::vector<std::pair<uint64_t, std::wstring>> largestFiles;
+        };
+
+        std::shared_ptr<const Directory> find(DWORD volume, uint64_t fileId, uint64_t lastWriteTime) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto byVolume = volumes.find(volume);
+            if (byVolume == volumes.end()) return nullptr;
+            auto it = byVolume->second.find(fileId);
+            if (it == byVolume->second.end() || it->second->lastWriteTime != lastWriteTime) return nullptr;
+            return it->second;
+        }
+
+        void store(DWORD volume, uint64_t fileId, std::shared_ptr<const Directory> directory) {
+            std::lock_guard<std::mutex> lock(mutex);
+            volumes[volume][fileId] = std::move(directory);
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            volumes.clear();
+        }
+
+    private:
+        std::mutex mutex;
+        // Directories by volume serial number, then by file id.
+        std::unordered_map<DWORD, std::unordered_map<uint64_t, std::shared_ptr<const Directory>>> volumes;
+    };
+
+    DiskUsageScanner(ThreadPool& pool, Cache& cache, size_t maxDepth, size_t topCount)
+        : pool(pool), cache(cache), maxDepth(maxDepth), topCount(std::min(topCount, MAX_TOP)) {}
+
+    void cancel() { cancelled = true; }
+    uint64_t scannedDirectories() const { return listed + reused; }
+    uint64_t listedDirectories() const { return listed; }
+    uint64_t reusedDirectories() const { return reused; }
+    const std::vector<std::string>& errors() const { return failures; }
+
+    Usage scan(const fs::path& root, const std::function<void()>& report) {
+        auto node = std::make_shared<Node>();
+        node->path = root;
+        {
+            TaskGroup group(pool);
+            group.run([this, &group, node] { visit(group, node); });
+            while (!group.waitFor(std::chrono::milliseconds(REPORT_INTERVAL_MS))) report();
+        }
+        return node->total();
+    }
+
+    // Directories up to the requested depth, each parent before its children.
+    std::vector<Line> lines() {
+        std::sort(collected.begin(), collected.end(), [](const Line& a, const Line& b) {
+            auto left = a.path.begin(), right = b.path.begin();
+            for (; left != a.path.end() && right != b.path.end() && *left == *right; ++left, ++right) {}
+            return left == a.path.end() ? right != b.path.end() : right != b.path.end() && *left < *right;
+        });
+        return collected;
+    }
+
+    std::vector<Largest> largest() {
+        std::vector<Largest> result;
+        while (!heap.empty()) {
+            result.push_back(heap.top());
+            heap.pop();
+        }
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+
+private:
+    struct Node {
+        fs::path path;
+        std::shared_ptr<Node> parent;
+        size_t depth = 0;
+        std::atomic<size_t> pending{1};
+        std::atomic<uint64_t> apparent{0};
+        std::atomic<uint64_t> allocated{0};
+        std::atomic<uint64_t> files{0};
+        std::atomic<uint64_t> directories{0};
+
+        void add(const Usage& usage) {
+            apparent += usage.apparent;
+            allocated += usage.allocated;
+            files += usage.files;
+            directories += usage.directories;
+        }
+
+        Usage total() const {
+            return Usage{apparent.load(), allocated.load(), files.load(), directories.load()};
+        }
+    };
+
+    static constexpr int REPORT_INTERVAL_MS = 200;
+
+    ThreadPool& pool;
+    Cache& cache;
+    size_t maxDepth;
+    size_t topCount;
+    std::atomic<bool> cancelled{false};
+    std::atomic<uint64_t> listed{0};
+    std::atomic<uint64_t> reused{0};
+    std::mutex resultMutex;
+    std::vector<Line> collected;
+    std::priority_queue<Largest, std::vector<Largest>, std::greater<Largest>> heap;
+    std::vector<std::string> failures;
+
+    void offer(uint64_t allocated, const fs::path& path, bool directory) {
+        if (topCount == 0) return;
+        if (heap.size() < topCount) {
+            heap.push(Largest{allocated, path, directory});
+        } else if (allocated > heap.top().allocated) {
+            heap.pop();
+            heap.push(Largest{allocated, path, directory});
+        }
+    }
+
+    void visit(TaskGroup& group, const std::shared_ptr<Node>& node) {
+        DirectoryReader reader(node->path);
+        DWORD volume = 0;
+        uint64_t fileId = 0;
+        uint64_t lastWriteTime = 0;
+        std::shared_ptr<const Cache::Directory> directory;
+        if (!cancelled && reader.identity(volume, fileId, lastWriteTime)) {
+            directory = cache.find(volume, fileId, lastWriteTime);
+            if (directory) {
+                reused++;
+            } else {
+                directory = list(reader, node->path, lastWriteTime);
+                if (directory) cache.store(volume, fileId, directory);
+            }
+        } else if (!cancelled) {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            failures.push_back(node->path.u8string() + ": " +
+                               std::system_category().message(static_cast<int>(reader.error())));
+        }
+
+        if (directory) {
+            node->add(directory->own);
+            {
+                std::lock_guard<std::mutex> lock(resultMutex);
+                for (const auto& [size, name] : directory->largestFiles) {
+                    if (heap.size() == topCount && size <= heap.top().allocated) break;
+                    offer(size, node->path / name, false);
+                }
+            }
+            for (const auto& name : directory->subdirectories) {
+                if (cancelled) break;
+                auto child = std::make_shared<Node>();
+                child->path = node->path / name;
+                child->parent = node;
+                child->depth = node->depth + 1;
+                node->pending++;
+                group.run([this, &group, child] { visit(group, child); });
+            }
+        }
+        finish(node);
+    }
+
+    std::shared_ptr<const Cache::Directory> list(DirectoryReader& reader, const fs::path& path, uint64_t lastWriteTime) {
+        auto directory = std::make_shared<Cache::Directory>();
+        directory->lastWriteTime = lastWriteTime;
+        auto& files = directory->largestFiles;
+        auto bySize = [](const auto& a, const auto& b) { return a.first > b.first; };
+        bool complete = reader.forEach([&](const DirectoryReader::Entry& entry) {
+            if (entry.isDirectory()) {
+                if (!entry.isReparsePoint()) directory->subdirectories.emplace_back(entry.name, entry.nameLength);
+                return;
+            }
+            directory->own.apparent += entry.size;
+            directory->own.allocated += entry.allocationSize;
+            directory->own.files++;
+            if (files.size() < MAX_TOP || entry.allocationSize > files.front().first) {
+                if (files.size() == MAX_TOP) {
+                    std::pop_heap(files.begin(), files.end(), bySize);
+                    files.pop_back();
+                }
+                files.emplace_back(entry.allocationSize, std::wstring(entry.name, entry.nameLength));
+                std::push_heap(files.begin(), files.end(), bySize);
+            }
+        });
+        if (!complete) {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            failures.push_back(path.u8string() + ": " + std::system_category().message(static_cast<int>(reader.error())));
+            return nullptr;
+        }
+        std::sort(files.begin(), files.end(), bySize);
+        listed++;
+        return directory;
+    }
+
+    void finish(const std::shared_ptr<Node>& node) {
+        if (--node->pending != 0) return;
+        Usage usage = node->total();
+        usage.directories++;
+        if (node->depth > 0) {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            offer(usage.allocated, node->path, true);
+        }
+        if (node->depth <= maxDepth) {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            collected.push_back(Line{node->path, node->depth, usage});
+        }
+        if (node->parent) {
+            node->parent->add(usage);
+            finish(node->parent);
+        }
+    }
+};
+
+// Streams a file through a transform with many reads and writes in flight. Requests
+// go to an I/O completion port and are reaped in batches; if the port cannot be
+// used, the same requests run as positional reads and writes on the thread pool.
+// All requests use buffers carved once from a page-aligned slab that lives as long
+// as the object, so steady-state streaming allocates nothing.
+class AsyncFileIO {
+public:
+    using Transform = std::function<void(const char* data, size_t size, bool last, std::vector<char>& out)>;
+
+    static constexpr DWORD BLOCK_SIZE = 1024 * 1024;
+    static constexpr size_t QUEUE_DEPTH = 8;
+
+    explicit AsyncFileIO(ThreadPool& pool) : pool(pool) {}
+
+    ~AsyncFileIO() {
+        if (slab) VirtualFree(slab, 0, MEM_RELEASE);
+    }
+
+    AsyncFileIO(const AsyncFileIO&) = delete;
+    AsyncFileIO& operator=(const AsyncFileIO&) = delete;
+
+    // Feeds `input` to `transform` in order, block by block, and writes whatever it
+    // appends to `output`. `outputSizeHint` preallocates the target when the output
+    // size is known, which keeps the writes from serializing on file extension.
+    bool transformFile(const fs::path& input, const fs::path& output, uint64_t outputSizeHint,
+                       const Transform& transform, std::string& error) {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        if (!slab) {
+            slab = static_cast<char*>(VirtualAlloc(nullptr, SLOTS * BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+            if (!slab) {
+                error = "Puffer konnte nicht reserviert werden";
+                return false;
+            }
+            for (size_t i = 0; i < SLOTS; ++i) requests[i].buffer = slab + i * BLOCK_SIZE;
+        }
+
+        Session session(*this);
+        if (!session.open(input, output, error)) return false;
+        return session.run(outputSizeHint, transform, error);
+    }
+
+private:
+    static constexpr size_t SLOTS = QUEUE_DEPTH * 2;
+    static constexpr ULONG COMPLETION_BATCH = 16;
+    // Transformed output waiting for a write slot. Past this, reads and transforms
+    // pause until writes drain; decompression can expand a block a hundredfold.
+    static constexpr size_t MAX_BACKLOG = BLOCK_SIZE * QUEUE_DEPTH * 4;
+
+    struct Request {
+        OVERLAPPED overlapped{};
+        char* buffer = nullptr;
+        uint64_t offset = 0;
+        DWORD length = 0;
+        bool write = false;
+    };
+
+    struct Completion {
+        Request* request;
+        DWORD bytes;
+        DWORD error;
+    };
+
+    class Session {
+    public:
+        explicit Session(AsyncFileIO& io) : io(io) {}
+
+        ~Session() {
+            if (port) CloseHandle(port);
+            if (source != INVALID_HANDLE_VALUE) CloseHandle(source);
+            if (target != INVALID_HANDLE_VALUE) CloseHandle(target);
+        }
+
+        bool open(const fs::path& input, const fs::path& output, std::string& error) {
+            source = CreateFileW(input.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                 FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (source != INVALID_HANDLE_VALUE) {
+                target = CreateFileW(output.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_OVERLAPPED, nullptr);
+            }
+            if (source == INVALID_HANDLE_VALUE || target == INVALID_HANDLE_VALUE) {
+                error = "Konnte Dateien nicht oeffnen";
+                return false;
+            }
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(source, &size)) {
+                error = "Dateigroesse nicht lesbar";
+                return false;
+            }
+            inputSize = static_cast<uint64_t>(size.QuadPart);
+
+            port = CreateIoCompletionPort(source, nullptr, 0, 0);
+            if (port && !CreateIoCompletionPort(target, port, 0, 0)) {
+                CloseHandle(port);
+                port = nullptr;
+            }
+            return true;
+        }
+
+        bool run(uint64_t outputSizeHint, const Transform& transform, std::string& error) {
+            if (outputSizeHint > 0) {
+                FILE_END_OF_FILE_INFO endOfFile{};
+                endOfFile.EndOfFile.QuadPart = static_cast<LONGLONG>(outputSizeHint);
+                SetFileInformationByHandle(target, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+            }
+
+            std::vector<Request*> freeReads;
+            std::vector<Request*> freeWrites;
+            for (size_t i = 0; i < QUEUE_DEPTH; ++i) {
+                freeReads.push_back(&io.requests[i]);
+                freeWrites.push_back(&io.requests[QUEUE_DEPTH + i]);
+            }
+
+            // Each transform output is queued whole; writes copy it out in block-sized
+            // pieces starting at `frontOffset` of the first chunk.
+            std::map<uint64_t, Request*> readyReads;
+            std::deque<std::vector<char>> backlog;
+            std::vector<char> produced;
+            std::vector<Completion> completions;
+            uint64_t readOffset = 0;
+            uint64_t processOffset = 0;
+            uint64_t writeOffset = 0;
+            size_t backlogBytes = 0;
+            size_t frontOffset = 0;
+            size_t inFlight = 0;
+            bool finished = false;
+            auto enqueue = [&] {
+                if (produced.empty()) return;
+                backlogBytes += produced.size();
+                backlog.push_back(std::move(produced));
+                produced = std::vector<char>();
+            };
+
+            if (inputSize == 0) {
+                transform(nullptr, 0, true, produced);
+                enqueue();
+                finished = true;
+            }
+
+            while (true) {
+                for (auto it = readyReads.find(processOffset);
+                     it != readyReads.end() && !failed && backlogBytes < MAX_BACKLOG; it = readyReads.find(processOffset)) {
+                    Request* request = it->second;
+                    readyReads.erase(it);
+                    processOffset += request->length;
+                    transform(request->buffer, request->length, processOffset == inputSize, produced);
+                    enqueue();
+                    finished = processOffset == inputSize;
+                    freeReads.push_back(request);
+                }
+
+                // Reads are issued only after the completed ones were processed, so a
+                // batch that freed every slot is refilled before waiting again.
+                while (!failed && !freeReads.empty() && readOffset < inputSize && backlogBytes < MAX_BACKLOG) {
+                    Request* request = freeReads.back();
+                    freeReads.pop_back();
+                    request->offset = readOffset;
+                    request->length = static_cast<DWORD>(std::min<uint64_t>(BLOCK_SIZE, inputSize - readOffset));
+                    request->write = false;
+                    readOffset += request->length;
+                    submit(request);
+                    ++inFlight;
+                }
+
+                while (!failed && !freeWrites.empty() && (backlogBytes >= BLOCK_SIZE || (finished && backlogBytes > 0))) {
+                    Request* request = freeWrites.back();
+                    freeWrites.pop_back();
+                    request->offset = writeOffset;
+                    request->length = static_cast<DWORD>(std::min<size_t>(BLOCK_SIZE, backlogBytes));
+                    request->write = true;
+                    for (DWORD copied = 0; copied < request->length;) {
+                        std::vector<char>& chunk = backlog.front();
+                        size_t take = std::min<size_t>(request->length - copied, chunk.size() - frontOffset);
+                        std::memcpy(request->buffer + copied, chunk.data() + frontOffset, take);
+                        copied += static_cast<DWORD>(take);
+                        frontOffset += take;
+                        if (frontOffset == chunk.size()) {
+                            // The drained chunk's allocation is reused for the next transform.
+                            if (produced.capacity() < chunk.capacity()) {
+                                produced = std::move(chunk);
+                                produced.clear();
+                            }
+                            backlog.pop_front();
+                            frontOffset = 0;
+                        }
+                    }
+                    backlogBytes -= request->length;
+                    writeOffset += request->length;
+                    submit(request);
+                    ++inFlight;
+                }
+
+                if (inFlight == 0 && (failed || (finished && backlogBytes == 0))) break;
+
+                completions.clear();
+                reap(completions);
+                for (const auto& completion : completions) {
+                    --inFlight;
+                    Request* request = completion.request;
+                    if (completion.error != 0 || completion.bytes != request->length) {
+                        failed = true;
+                        lastError = completion.error;
+                    }
+                    if (request->write) freeWrites.push_back(request);
+                    else if (failed) freeReads.push_back(request);
+                    else readyReads.emplace(request->offset, request);
+                }
+            }
+
+            if (failed) {
+                error = std::system_category().message(static_cast<int>(lastError ? lastError : ERROR_HANDLE_EOF));
+                return false;
+            }
+            FILE_END_OF_FILE_INFO endOfFile{};
+            endOfFile.EndOfFile.QuadPart = static_cast<LONGLONG>(writeOffset);
+            SetFileInformationByHandle(target, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+            return true;
+        }
+
+    private:
+        AsyncFileIO& io;
+        HANDLE source = INVALID_HANDLE_VALUE;
+        HANDLE target = INVALID_HANDLE_VALUE;
+        HANDLE port = nullptr;
+        uint64_t inputSize = 0;
+        bool failed = false;
+        DWORD lastError = 0;
+
+        std::mutex fallbackMutex;
+        std::condition_variable fallbackReady;
+        std::vector<Completion> fallbackDone;
+
+        void submit(Request* request) {
+            request->overlapped = OVERLAPPED{};
+            request->overlapped.Offset = static_cast<DWORD>(request->offset);
+            request->overlapped.OffsetHigh = static_cast<DWORD>(request->offset >> 32);
+            HANDLE file = request->write ? target : source;
+
+            if (port) {
+                BOOL ok = request->write
+                    ? WriteFile(file, request->buffer, request->length, nullptr, &request->overlapped)
+                    : ReadFile(file, request->buffer, request->length, nullptr, &request->overlapped);
+                DWORD error = ok ? 0 : GetLastError();
+                if (ok || error == ERROR_IO_PENDING) return;
+                // Failed submissions never reach the port; queue a synthetic completion.
+                PostQueuedCompletionStatus(port, 0, error, &request->overlapped);
+                return;
+            }
+
+            // Without a port each worker waits on its own event, since several
+            // requests on the same handle may be outstanding at once.
+            io.pool.enqueue([this, request, file] {
+                thread_local HANDLE event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+                request->overlapped.hEvent = event;
+                BOOL ok = request->write
+                    ? WriteFile(file, request->buffer, request->length, nullptr, &request->overlapped)
+                    : ReadFile(file, request->buffer, request->length, nullptr, &request->overlapped);
+                DWORD bytes = 0;
+                DWORD error = ok || GetLastError() == ERROR_IO_PENDING ? 0 : GetLastError();
+                if (error == 0 && !GetOverlappedResult(file, &request->overlapped, &bytes, TRUE)) {
+                    error = GetLastError();
+                }
+                std::lock_guard<std::mutex> lock(fallbackMutex);
+                fallbackDone.push_back(Completion{request, bytes, error});
+                fallbackReady.notify_one();
+            });
+        }
+
+        void reap(std::vector<Completion>& out) {
+            if (port) {
+                OVERLAPPED_ENTRY entries[COMPLETION_BATCH];
+                ULONG count = 0;
+                if (!GetQueuedCompletionStatusEx(port, entries, COMPLETION_BATCH, &count, INFINITE, FALSE)) return;
+                for (ULONG i = 0; i < count; ++i) {
+                    auto* request = reinterpret_cast<Request*>(entries[i].lpOverlapped);
+                    DWORD bytes = entries[i].dwNumberOfBytesTransferred;
+                    DWORD error = static_cast<DWORD>(entries[i].lpCompletionKey);
+                    if (error == 0 && request->overlapped.Internal != 0 &&
+                        !GetOverlappedResult(request->write ? target : source, &request->overlapped, &bytes, FALSE)) {
+                        error = GetLastError();
+                    }
+                    out.push_back(Completion{request, bytes, error});
+                }
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock(fallbackMutex);
+            fallbackReady.wait(lock, [this] { return !fallbackDone.empty(); });
+            out.swap(fallbackDone);
+        }
+    };
+
+    ThreadPool& pool;
+    std::mutex sessionMutex;
+    char* slab = nullptr;
+    Request requests[SLOTS];
+};
+
+class CpuFeatures {
+public:
+    static bool ssse3() { return get().hasSsse3; }
+    static bool sse41() { return get().hasSse41; }
+    static bool avx2() { return get().hasAvx2; }
+    static bool sha() { return get().hasSha; }
+
+private:
+    bool hasSsse3 = false;
+    bool hasSse41 = false;
+    bool hasAvx2 = false;
+    bool hasSha = false;
+
+    static const CpuFeatures& get() {
+        static const CpuFeatures features = detect();
+        return features;
+    }
+
+    TARGET_XSAVE static CpuFeatures detect() {
+        CpuFeatures features;
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+        __cpuid(info, 1);
+        features.hasSsse3 = (info[2] & (1 << 9)) != 0;
+        features.hasSse41 = (info[2] & (1 << 19)) != 0;
+        bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+        if (maxLeaf >= 7) {
+            __cpuidex(info, 7, 0);
+            features.hasAvx2 = osSavesYmm && (info[1] & (1 << 5)) != 0;
+            features.hasSha = features.hasSse41 && (info[1] & (1 << 29)) != 0;
+        }
+        return features;
+    }
+};
+
+// Keeps the memory manager reading a fixed window ahead of a sequential pass over a
+// mapped file, so the hash loop does not stall on one page fault after another.
+class MappedPrefetch {
+public:
+    MappedPrefetch(const void* base, uint64_t size) : base(static_cast<const char*>(base)), size(size) {}
+
+    void advance(uint64_t position) {
+        while (issued < size && issued < position + AHEAD) {
+            WIN32_MEMORY_RANGE_ENTRY range{const_cast<char*>(base + issued),
+                                           static_cast<SIZE_T>(std::min<uint64_t>(WINDOW, size - issued))};
+            PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+            issued += WINDOW;
+        }
+    }
+
+    static constexpr uint64_t WINDOW = 16 * 1024 * 1024;
+    static constexpr uint64_t AHEAD = 4 * WINDOW;
+
+private:
+    const char* base;
+    uint64_t size;
+    uint64_t issued = 0;
+};
+
+// XXH3 64-bit with seed 0 and the default secret, matching xxhsum -H3.
+class Xxh3 {
+public:
+    static uint64_t hash(const uint8_t* input, size_t length, MappedPrefetch* prefetch = nullptr) {
+        if (length <= 16) return hashShort(input, length);
+        if (length <= 128) return hash17to128(input, length);
+        if (length <= 240) return hash129to240(input, length);
+        return hashLong(input, length, prefetch);
+    }
+
+private:
+    static constexpr uint32_t PRIME32_1 = 0x9E3779B1U;
+    static constexpr uint32_t PRIME32_2 = 0x85EBCA77U;
+    static constexpr uint32_t PRIME32_3 = 0xC2B2AE3DU;
+    static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+    static constexpr uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+    static constexpr uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+    static constexpr size_t STRIPE_LEN = 64;
+    static constexpr size_t SECRET_SIZE = 192;
+    static constexpr size_t STRIPES_PER_BLOCK = (SECRET_SIZE - STRIPE_LEN) / 8;
+    static constexpr size_t BLOCK_LEN = STRIPE_LEN * STRIPES_PER_BLOCK;
+
+    alignas(64) static constexpr uint8_t SECRET[SECRET_SIZE] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    static uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint64_t read64(const uint8_t* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint64_t rotl64(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    static uint32_t swap32(uint32_t value) {
+        return ((value << 24) & 0xff000000) | ((value << 8) & 0x00ff0000) |
+               ((value >> 8) & 0x0000ff00) | ((value >> 24) & 0x000000ff);
+    }
+
+    static uint64_t swap64(uint64_t value) {
+        return (static_cast<uint64_t>(swap32(static_cast<uint32_t>(value))) << 32) | swap32(static_cast<uint32_t>(value >> 32));
+    }
+
+    static uint64_t mulFold64(uint64_t a, uint64_t b) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        uint64_t high;
+        uint64_t low = _umul128(a, b, &high);
+        return low ^ high;
+#else
+        unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#endif
+    }
+
+    static uint64_t avalanche64(uint64_t h) {
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        return h ^ (h >> 32);
+    }
+
+    static uint64_t avalanche(uint64_t h) {
+        h ^= h >> 37;
+        h *= PRIME_MX1;
+        return h ^ (h >> 32);
+    }
+
+    static uint64_t rrmxmx(uint64_t h, uint64_t length) {
+        h ^= rotl64(h, 49) ^ rotl64(h, 24);
+        h *= PRIME_MX2;
+        h ^= (h >> 35) + length;
+        h *= PRIME_MX2;
+        return h ^ (h >> 28);
+    }
+
+    static uint64_t mix16(const uint8_t* input, const uint8_t* secret) {
+        return mulFold64(read64(input) ^ read64(secret), read64(input + 8) ^ read64(secret + 8));
+    }
+
+    static uint64_t hashShort(const uint8_t* input, size_t length) {
+        if (length > 8) {
+            uint64_t low = read64(input) ^ (read64(SECRET + 24) ^ read64(SECRET + 32));
+            uint64_t high = read64(input + length - 8) ^ (read64(SECRET + 40) ^ read64(SECRET + 48));
+            return avalanche(length + swap64(low) + high + mulFold64(low, high));
+        }
+        if (length >= 4) {
+            uint64_t combined = read32(input + length - 4) + (static_cast<uint64_t>(read32(input)) << 32);
+            return rrmxmx(combined ^ (read64(SECRET + 8) ^ read64(SECRET + 16)), length);
+        }
+        if (length > 0) {
+            uint32_t combined = (static_cast<uint32_t>(input[0]) << 16) | (static_cast<uint32_t>(input[length >> 1]) << 24) |
+                                input[length - 1] | (static_cast<uint32_t>(length) << 8);
+            return avalanche64(combined ^ static_cast<uint64_t>(read32(SECRET) ^ read32(SECRET + 4)));
+        }
+        return avalanche64(read64(SECRET + 56) ^ read64(SECRET + 64));
+    }
+
+    static uint64_t hash17to128(const uint8_t* input, size_t length) {
+        uint64_t acc = length * PRIME64_1;
+        if (length > 32) {
+            if (length > 64) {
+                if (length > 96) {
+                    acc += mix16(input + 48, SECRET + 96);
+                    acc += mix16(input + length - 64, SECRET + 112);
+                }
+                acc += mix16(input + 32, SECRET + 64);
+                acc += mix16(input + length - 48, SECRET + 80);
+            }
+            acc += mix16(input + 16, SECRET + 32);
+            acc += mix16(input + length - 32, SECRET + 48);
+        }
+        acc += mix16(input, SECRET);
+        acc += mix16(input + length - 16, SECRET + 16);
+        return avalanche(acc);
+    }
+
+    static uint64_t hash129to240(const uint8_t* input, size_t length) {
+        uint64_t acc = length * PRIME64_1;
+        size_t rounds = length / 16;
+        for (size_t i = 0; i < 8; ++i) {
+            acc += mix16(input + 16 * i, SECRET + 16 * i);
+        }
+        acc = avalanche(acc);
+        for (size_t i = 8; i < rounds; ++i) {
+            acc += mix16(input + 16 * i, SECRET + 16 * (i - 8) + 3);
+        }
+        acc += mix16(input + length - 16, SECRET + 136 - 17);
+        return avalanche(acc);
+    }
+
+    using Accumulate = void (*)(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes);
+    using Scramble = void (*)(uint64_t* acc, const uint8_t* secret);
+
+    static void accumulateScalar(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes) {
+        for (size_t s = 0; s < stripes; ++s, input += STRIPE_LEN, secret += 8) {
+            for (size_t i = 0; i < 8; ++i) {
+                uint64_t value = read64(input + 8 * i);
+                uint64_t key = value ^ read64(secret + 8 * i);
+                acc[i ^ 1] += value;
+                acc[i] += static_cast<uint32_t>(key) * (key >> 32);
+            }
+        }
+    }
+
+    static void scrambleScalar(uint64_t* acc, const uint8_t* secret) {
+        for (size_t i = 0; i < 8; ++i) {
+            uint64_t value = acc[i] ^ (acc[i] >> 47);
+            acc[i] = (value ^ read64(secret + 8 * i)) * PRIME32_1;
+        }
+    }
+
+    static void accumulateSse2(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes) {
+        __m128i* xacc = reinterpret_cast<__m128i*>(acc);
+        for (size_t s = 0; s < stripes; ++s, input += STRIPE_LEN, secret += 8) {
+            for (size_t i = 0; i < 4; ++i) {
+                __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input) + i);
+                __m128i key = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i));
+                __m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+                __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                xacc[i] = _mm_add_epi64(product, _mm_add_epi64(xacc[i], swapped));
+            }
+        }
+    }
+
+    static void scrambleSse2(uint64_t* acc, const uint8_t* secret) {
+        __m128i* xacc = reinterpret_cast<__m128i*>(acc);
+        const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+        for (size_t i = 0; i < 4; ++i) {
+            __m128i value = _mm_xor_si128(xacc[i], _mm_srli_epi64(xacc[i], 47));
+            __m128i key = _mm_xor_si128(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i));
+            __m128i low = _mm_mul_epu32(key, prime);
+            __m128i high = _mm_mul_epu32(_mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            xacc[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+        }
+    }
+
+    TARGET_AVX2 static void accumulateAvx2(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes) {
+        __m256i* xacc = reinterpret_cast<__m256i*>(acc);
+        for (size_t s = 0; s < stripes; ++s, input += STRIPE_LEN, secret += 8) {
+            for (size_t i = 0; i < 2; ++i) {
+                __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input) + i);
+                __m256i key = _mm256_xor_si256(data, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret) + i));
+                __m256i product = _mm256_mul_epu32(key, _mm256_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+                __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                xacc[i] = _mm256_add_epi64(product, _mm256_add_epi64(xacc[i], swapped));
+            }
+        }
+    }
+
+    TARGET_AVX2 static void scrambleAvx2(uint64_t* acc, const uint8_t* secret) {
+        __m256i* xacc = reinterpret_cast<__m256i*>(acc);
+        const __m256i prime = _mm256_set1_epi32(static_cast<int>(PRIME32_1));
+        for (size_t i = 0; i < 2; ++i) {
+            __m256i value = _mm256_xor_si256(xacc[i], _mm256_srli_epi64(xacc[i], 47));
+            __m256i key = _mm256_xor_si256(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret) + i));
+            __m256i low = _mm256_mul_epu32(key, prime);
+            __m256i high = _mm256_mul_epu32(_mm256_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            xacc[i] = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+        }
+    }
+
+    static uint64_t hashLong(const uint8_t* input, size_t length, MappedPrefetch* prefetch) {
+        alignas(32) uint64_t acc[8] = {PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1};
+        Accumulate accumulate = CpuFeatures::avx2() ? accumulateAvx2 : accumulateSse2;
+        Scramble scramble = CpuFeatures::avx2() ? scrambleAvx2 : scrambleSse2;
+
+        size_t blocks = (length - 1) / BLOCK_LEN;
+        for (size_t n = 0; n < blocks; ++n) {
+            if (prefetch && n % PREFETCH_BLOCKS == 0) prefetch->advance(n * BLOCK_LEN);
+            accumulate(acc, input + n * BLOCK_LEN, SECRET, STRIPES_PER_BLOCK);
+            scramble(acc, SECRET + SECRET_SIZE - STRIPE_LEN);
+        }
+        size_t stripes = ((length - 1) - BLOCK_LEN * blocks) / STRIPE_LEN;
+        accumulate(acc, input + blocks * BLOCK_LEN, SECRET, stripes);
+        accumulate(acc, input + length - STRIPE_LEN, SECRET + SECRET_SIZE - STRIPE_LEN - 7, 1);
+
+        uint64_t result = length * PRIME64_1;
+        for (size_t i = 0; i < 4; ++i) {
+            result += mulFold64(acc[2 * i] ^ read64(SECRET + 11 + 16 * i), acc[2 * i + 1] ^ read64(SECRET + 11 + 16 * i + 8));
+        }
+        return avalanche(result);
+    }
+
+    static constexpr size_t PREFETCH_BLOCKS = 1024;
+};
+
+class Sha256 {
+public:
+    Sha256() {
+        std::memcpy(state, INITIAL, sizeof(state));
+    }
+
+    void update(const uint8_t* data, size_t length, MappedPrefetch* prefetch = nullptr) {
+        total += length;
+        if (buffered > 0) {
+            size_t take = std::min(length, BLOCK_SIZE - buffered);
+            std::memcpy(buffer + buffered, data, take);
+            buffered += take;
+            data += take;
+            length -= take;
+            if (buffered < BLOCK_SIZE) return;
+            compress(buffer, 1);
+            buffered = 0;
+        }
+        size_t processed = 0;
+        while (length - processed >= BLOCK_SIZE) {
+            if (prefetch) prefetch->advance(processed);
+            size_t blocks = std::min((length - processed) / BLOCK_SIZE, STEP_BLOCKS);
+            compress(data + processed, blocks);
+            processed += blocks * BLOCK_SIZE;
+        }
+        std::memcpy(buffer, data + processed, length - processed);
+        buffered = length - processed;
+    }
+
+    std::array<uint8_t, 32> finish() {
+        uint64_t bits = total * 8;
+        uint8_t padding[BLOCK_SIZE * 2] = {0x80};
+        size_t padLength = (buffered < 56 ? 56 : 120) - buffered;
+        for (int i = 0; i < 8; ++i) {
+            padding[padLength + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+        }
+        update(padding, padLength + 8);
+
+        std::array<uint8_t, 32> digest;
+        for (size_t i = 0; i < 8; ++i) {
+            for (size_t j = 0; j < 4; ++j) {
+                digest[4 * i + j] = static_cast<uint8_t>(state[i] >> (24 - 8 * j));
+            }
+        }
+        return digest;
+    }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64;
+    static constexpr size_t STEP_BLOCKS = MappedPrefetch::WINDOW / BLOCK_SIZE;
+
+    static constexpr uint32_t INITIAL[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    alignas(16) static constexpr uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+    uint32_t state[8];
+    uint8_t buffer[BLOCK_SIZE];
+    size_t buffered = 0;
+    uint64_t total = 0;
+
+    void compress(const uint8_t* data, size_t blocks) {
+        if (CpuFeatures::sha()) compressShaNi(state, data, blocks);
+        else compressScalar(state, data, blocks);
+    }
+
+    static uint32_t rotr(uint32_t value, int bits) {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    static void compressScalar(uint32_t* state, const uint8_t* data, size_t blocks) {
+        uint32_t w[64];
+        for (; blocks > 0; --blocks, data += BLOCK_SIZE) {
+            for (size_t i = 0; i < 16; ++i) {
+                w[i] = (static_cast<uint32_t>(data[4 * i]) << 24) | (static_cast<uint32_t>(data[4 * i + 1]) << 16) |
+                       (static_cast<uint32_t>(data[4 * i + 2]) << 8) | data[4 * i + 3];
+            }
+            for (size_t i = 16; i < 64; ++i) {
+                uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+            for (size_t i = 0; i < 64; ++i) {
+                uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+                uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+            state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        }
+    }
+
+    // SHA extensions: two rounds per sha256rnds2, with the message schedule done by
+    // sha256msg1/sha256msg2. The state is kept as ABEF/CDGH as the instructions expect.
+    TARGET_SHA static void compressShaNi(uint32_t* state, const uint8_t* data, size_t blocks) {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        __m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+        __m128i hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+        __m128i cdab = _mm_shuffle_epi32(dcba, 0xB1);
+        __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+        __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+        __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+        for (; blocks > 0; --blocks, data += BLOCK_SIZE) {
+            __m128i abefSaved = abef;
+            __m128i cdghSaved = cdgh;
+            __m128i message[4];
+            for (int i = 0; i < 4; ++i) {
+                message[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + i), byteSwap);
+            }
+            for (int i = 0; i < 16; ++i) {
+                __m128i words = _mm_add_epi32(message[i & 3], _mm_load_si128(reinterpret_cast<const __m128i*>(K) + i));
+                cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+                abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(words, 0x0E));
+                if (i < 12) {
+                    __m128i next = _mm_sha256msg1_epu32(message[i & 3], message[(i + 1) & 3]);
+                    next = _mm_add_epi32(next, _mm_alignr_epi8(message[(i + 3) & 3], message[(i + 2) & 3], 4));
+                    message[i & 3] = _mm_sha256msg2_epu32(next, message[(i + 3) & 3]);
+                }
+            }
+            abef = _mm_add_epi32(abef, abefSaved);
+            cdgh = _mm_add_epi32(cdgh, cdghSaved);
+        }
+
+        __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+        __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+    }
+};
+
+// BLAKE3 (hash mode, 32-byte output). Chunks are compressed four at a time in SSE2
+// lanes, and large inputs are split into power-of-two subtrees hashed on the thread
+// pool. The tree shape does not depend on the split, so every path gives the same
+// digest.
+class Blake3 {
+public:
+    static std::array<uint8_t, 32> hash(const uint8_t* input, size_t length, ThreadPool* pool = nullptr) {
+        Output root;
+        if (length <= CHUNK_LEN) {
+            root = chunkOutput(input, length, 0);
+        } else {
+            size_t left = leftLength(length);
+            CV leftCv, rightCv;
+            if (pool && length >= PARALLEL_MIN) {
+                size_t pieceChunks = PIECE_CHUNKS;
+                while (pieceChunks * CHUNK_LEN * TARGET_PIECES < length) pieceChunks *= 2;
+                size_t pieceBytes = pieceChunks * CHUNK_LEN;
+
+                std::vector<std::future<CV>> pieces;
+                schedule(*pool, input, 0, left, pieceBytes, pieces);
+                schedule(*pool, input, left, length - left, pieceBytes, pieces);
+                size_t next = 0;
+                leftCv = combine(0, left, pieceBytes, pieces, next);
+                rightCv = combine(left, length - left, pieceBytes, pieces, next);
+            } else {
+                leftCv = subtree(input, left, 0);
+                rightCv = subtree(input + left, length - left, left / CHUNK_LEN);
+            }
+            root = parentOutput(leftCv, rightCv);
+        }
+
+        std::array<uint32_t, 16> words = compress(root.cv, root.block, root.counter, root.blockLength, root.flags | ROOT);
+        std::array<uint8_t, 32> digest;
+        std::memcpy(digest.data(), words.data(), digest.size());
+        return digest;
+    }
+
+private:
+    using CV = std::array<uint32_t, 8>;
+
+    struct Output {
+        CV cv;
+        uint32_t block[16];
+        uint64_t counter;
+        uint32_t blockLength;
+        uint32_t flags;
+    };
+
+    static constexpr size_t CHUNK_LEN = 1024;
+    static constexpr size_t BLOCK_LEN = 64;
+    static constexpr size_t PIECE_CHUNKS = 1024;
+    static constexpr size_t TARGET_PIECES = 64;
+    static constexpr size_t PARALLEL_MIN = 4 * 1024 * 1024;
+    static constexpr uint32_t CHUNK_START = 1;
+    static constexpr uint32_t CHUNK_END = 2;
+    static constexpr uint32_t PARENT = 4;
+    static constexpr uint32_t ROOT = 8;
+
+    static constexpr CV IV = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                              0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+    static constexpr uint8_t PERMUTATION[16] = {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8};
+
+    static uint32_t rotr(uint32_t value, int bits) {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    static void g(uint32_t* v, int a, int b, int c, int d, uint32_t x, uint32_t y) {
+        v[a] = v[a] + v[b] + x;
+        v[d] = rotr(v[d] ^ v[a], 16);
+        v[c] = v[c] + v[d];
+        v[b] = rotr(v[b] ^ v[c], 12);
+        v[a] = v[a] + v[b] + y;
+        v[d] = rotr(v[d] ^ v[a], 8);
+        v[c] = v[c] + v[d];
+        v[b] = rotr(v[b] ^ v[c], 7);
+    }
+
+    static std::array<uint32_t, 16> compress(const CV& cv, const uint32_t* block, uint64_t counter,
+                                             uint32_t blockLength, uint32_t flags) {
+        uint32_t v[16] = {cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+                          IV[0], IV[1], IV[2], IV[3], static_cast<uint32_t>(counter),
+                          static_cast<uint32_t>(counter >> 32), blockLength, flags};
+        uint32_t m[16];
+        std::memcpy(m, block, sizeof(m));
+        for (int round = 0; round < 7; ++round) {
+            g(v, 0, 4, 8, 12, m[0], m[1]);
+            g(v, 1, 5, 9, 13, m[2], m[3]);
+            g(v, 2, 6, 10, 14, m[4], m[5]);
+            g(v, 3, 7, 11, 15, m[6], m[7]);
+            g(v, 0, 5, 10, 15, m[8], m[9]);
+            g(v, 1, 6, 11, 12, m[10], m[11]);
+            g(v, 2, 7, 8, 13, m[12], m[13]);
+            g(v, 3, 4, 9, 14, m[14], m[15]);
+            uint32_t permuted[16];
+            for (int i = 0; i < 16; ++i) permuted[i] = m[PERMUTATION[i]];
+            std::memcpy(m, permuted, sizeof(m));
+        }
+        std::array<uint32_t, 16> out;
+        for (int i = 0; i < 8; ++i) {
+            out[i] = v[i] ^ v[i + 8];
+            out[i + 8] = v[i + 8] ^ cv[i];
+        }
+        return out;
+    }
+
+    static CV chainingValue(const Output& output) {
+        auto words = compress(output.cv, output.block, output.counter, output.blockLength, output.flags);
+        CV cv;
+        std::copy(words.begin(), words.begin() + 8, cv.begin());
+        return cv;
+    }
+
+    static Output chunkOutput(const uint8_t* input, size_t length, uint64_t chunk) {
+        CV cv = IV;
+        uint32_t flags = CHUNK_START;
+        while (length > BLOCK_LEN) {
+            uint32_t block[16];
+            std::memcpy(block, input, BLOCK_LEN);
+            auto words = compress(cv, block, chunk, BLOCK_LEN, flags);
+            std::copy(words.begin(), words.begin() + 8, cv.begin());
+            flags = 0;
+            input += BLOCK_LEN;
+            length -= BLOCK_LEN;
+        }
+        Output output{cv, {}, chunk, static_cast<uint32_t>(length), flags | CHUNK_END};
+        std::memcpy(output.block, input, length);
+        return output;
+    }
+
+    static Output parentOutput(const CV& left, const CV& right) {
+        Output output{IV, {}, 0, BLOCK_LEN, PARENT};
+        std::copy(left.begin(), left.end(), output.block);
+        std::copy(right.begin(), right.end(), output.block + 8);
+        return output;
+    }
+
+    // Bytes in the left subtree: the largest power-of-two number of chunks that
+    // still leaves at least one byte for the right side.
+    static size_t leftLength(size_t length) {
+        size_t fullChunks = (length - 1) / CHUNK_LEN;
+        size_t power = 1;
+        while (power * 2 <= fullChunks) power *= 2;
+        return power * CHUNK_LEN;
+    }
+
+    static __m128i rotr16(__m128i x) {
+        return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1);
+    }
+
+    template<int Bits>
+    static __m128i rotr(__m128i x) {
+        return _mm_or_si128(_mm_srli_epi32(x, Bits), _mm_slli_epi32(x, 32 - Bits));
+    }
+
+    static void g4(__m128i* v, int a, int b, int c, int d, __m128i x, __m128i y) {
+        v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), x);
+        v[d] = rotr16(_mm_xor_si128(v[d], v[a]));
+        v[c] = _mm_add_epi32(v[c], v[d]);
+        v[b] = rotr<12>(_mm_xor_si128(v[b], v[c]));
+        v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), y);
+        v[d] = rotr<8>(_mm_xor_si128(v[d], v[a]));
+        v[c] = _mm_add_epi32(v[c], v[d]);
+        v[b] = rotr<7>(_mm_xor_si128(v[b], v[c]));
+    }
+
+    static void transpose(__m128i& a, __m128i& b, __m128i& c, __m128i& d) {
+        __m128i ab01 = _mm_unpacklo_epi32(a, b);
+        __m128i ab23 = _mm_unpackhi_epi32(a, b);
+        __m128i cd01 = _mm_unpacklo_epi32(c, d);
+        __m128i cd23 = _mm_unpackhi_epi32(c, d);
+        a = _mm_unpacklo_epi64(ab01, cd01);
+        b = _mm_unpackhi_epi64(ab01, cd01);
+        c = _mm_unpacklo_epi64(ab23, cd23);
+        d = _mm_unpackhi_epi64(ab23, cd23);
+    }
+
+    // Chaining values of four consecutive full chunks, one chunk per SSE2 lane.
+    static void chunks4(const uint8_t* input, uint64_t chunk, CV* out) {
+        __m128i cv[8];
+        for (int i = 0; i < 8; ++i) cv[i] = _mm_set1_epi32(static_cast<int>(IV[i]));
+        const __m128i counterLow = _mm_setr_epi32(static_cast<int>(chunk), static_cast<int>(chunk + 1),
+                                                  static_cast<int>(chunk + 2), static_cast<int>(chunk + 3));
+        const __m128i counterHigh = _mm_setr_epi32(static_cast<int>((chunk) >> 32), static_cast<int>((chunk + 1) >> 32),
+                                                   static_cast<int>((chunk + 2) >> 32), static_cast<int>((chunk + 3) >> 32));
+
+        for (size_t blockIndex = 0; blockIndex < CHUNK_LEN / BLOCK_LEN; ++blockIndex) {
+            __m128i m[16];
+            for (int group = 0; group < 4; ++group) {
+                for (int lane = 0; lane < 4; ++lane) {
+                    m[4 * group + lane] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                        input + lane * CHUNK_LEN + blockIndex * BLOCK_LEN + 16 * group));
+                }
+                transpose(m[4 * group], m[4 * group + 1], m[4 * group + 2], m[4 * group + 3]);
+            }
+
+            uint32_t flags = (blockIndex == 0 ? CHUNK_START : 0) | (blockIndex + 1 == CHUNK_LEN / BLOCK_LEN ? CHUNK_END : 0);
+            __m128i v[16] = {cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+                             _mm_set1_epi32(static_cast<int>(IV[0])), _mm_set1_epi32(static_cast<int>(IV[1])),
+                             _mm_set1_epi32(static_cast<int>(IV[2])), _mm_set1_epi32(static_cast<int>(IV[3])),
+                             counterLow, counterHigh, _mm_set1_epi32(BLOCK_LEN), _mm_set1_epi32(static_cast<int>(flags))};
+            for (int round = 0; round < 7; ++round) {
+                g4(v, 0, 4, 8, 12, m[0], m[1]);
+                g4(v, 1, 5, 9, 13, m[2], m[3]);
+                g4(v, 2, 6, 10, 14, m[4], m[5]);
+                g4(v, 3, 7, 11, 15, m[6], m[7]);
+                g4(v, 0, 5, 10, 15, m[8], m[9]);
+                g4(v, 1, 6, 11, 12, m[10], m[11]);
+                g4(v, 2, 7, 8, 13, m[12], m[13]);
+                g4(v, 3, 4, 9, 14, m[14], m[15]);
+                __m128i permuted[16];
+                for (int i = 0; i < 16; ++i) permuted[i] = m[PERMUTATION[i]];
+                std::copy(permuted, permuted + 16, m);
+            }
+            for (int i = 0; i < 8; ++i) cv[i] = _mm_xor_si128(v[i], v[i + 8]);
+        }
+
+        transpose(cv[0], cv[1], cv[2], cv[3]);
+        transpose(cv[4], cv[5], cv[6], cv[7]);
+        for (int lane = 0; lane < 4; ++lane) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out[lane].data()), cv[lane]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out[lane].data() + 4), cv[lane + 4]);
+        }
+    }
+
+    static CV merge(const CV* cvs, size_t count) {
+        if (count == 1) return cvs[0];
+        size_t left = 1;
+        while (left * 2 <= count - 1) left *= 2;
+        return chainingValue(parentOutput(merge(cvs, left), merge(cvs + left, count - left)));
+    }
+
+    // Chaining value of a non-root subtree starting at chunk index `chunk`.
+    static CV subtree(const uint8_t* input, size_t length, uint64_t chunk) {
+        size_t count = (length + CHUNK_LEN - 1) / CHUNK_LEN;
+        if (count > PIECE_CHUNKS) {
+            size_t left = leftLength(length);
+            return chainingValue(parentOutput(subtree(input, left, chunk),
+                                              subtree(input + left, length - left, chunk + left / CHUNK_LEN)));
+        }
+
+        std::vector<CV> cvs(count);
+        size_t full = length / CHUNK_LEN;
+        size_t i = 0;
+        for (; i + 4 <= full; i += 4) {
+            chunks4(input + i * CHUNK_LEN, chunk + i, &cvs[i]);
+        }
+        for (; i < count; ++i) {
+            size_t size = std::min(CHUNK_LEN, length - i * CHUNK_LEN);
+            cvs[i] = chainingValue(chunkOutput(input + i * CHUNK_LEN, size, chunk + i));
+        }
+        return merge(cvs.data(), count);
+    }
+
+    static void schedule(ThreadPool& pool, const uint8_t* input, size_t offset, size_t length, size_t pieceBytes,
+                         std::vector<std::future<CV>>& pieces) {
+        if (length <= pieceBytes) {
+            pieces.push_back(pool.enqueue([input, offset, length] {
+                WIN32_MEMORY_RANGE_ENTRY range{const_cast<uint8_t*>(input + offset), length};
+                PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+                return subtree(input + offset, length, offset / CHUNK_LEN);
+            }));
+            return;
+        }
+        size_t left = leftLength(length);
+        schedule(pool, input, offset, left, pieceBytes, pieces);
+        schedule(pool, input, offset + left, length - left, pieceBytes, pieces);
+    }
+
+    static CV combine(size_t offset, size_t length, size_t pieceBytes, std::vector<std::future<CV>>& pieces, size_t& next) {
+        if (length <= pieceBytes) return pieces[next++].get();
+        size_t left = leftLength(length);
+        CV leftCv = combine(offset, left, pieceBytes, pieces, next);
+        CV rightCv = combine(offset + left, length - left, pieceBytes, pieces, next);
+        return chainingValue(parentOutput(leftCv, rightCv));
+    }
+};
+
+// RFC 4648 base64. The encoder turns 12 (SSSE3) or 24 (AVX2) input bytes into 16 or
+// 32 characters per step: a byte shuffle and two multiplies spread every 3-byte group
+// over four 6-bit indices, and a 16-entry shuffle table maps those to characters. The
+// decoder classifies characters with range compares, so a byte outside the alphabet
+// is caught for a whole vector at once, and packs each four 6-bit values back into
+// three bytes with multiply-adds. The vector loops stop at the first invalid vector;
+// it and the leftovers go through table-driven scalar code, which also serves CPUs
+// without SSSE3 and pinpoints errors.
+class Base64 {
+public:
+    static size_t encodedSize(size_t size) { return (size + 2) / 3 * 4; }
+    static size_t decodedCapacity(size_t size) { return size / 4 * 3; }
+
+    // Writes encodedSize(size) characters to `out`, padded with '='.
+    static void encode(const uint8_t* in, size_t size, char* out) {
+        size_t done = 0;
+        if (CpuFeatures::avx2()) done = encodeAvx2(in, size, out);
+        else if (CpuFeatures::ssse3()) done = encodeSsse3(in, size, out);
+        in += done;
+        out += done / 3 * 4;
+        size -= done;
+
+        size_t i = 0;
+        for (; i + 3 <= size; i += 3, out += 4) {
+            uint32_t value = static_cast<uint32_t>(in[i]) << 16 | static_cast<uint32_t>(in[i + 1]) << 8 | in[i + 2];
+            out[0] = ALPHABET[value >> 18];
+            out[1] = ALPHABET[(value >> 12) & 0x3F];
+            out[2] = ALPHABET[(value >> 6) & 0x3F];
+            out[3] = ALPHABET[value & 0x3F];
+        }
+        if (i < size) {
+            uint32_t value = static_cast<uint32_t>(in[i]) << 16 | (i + 1 < size ? static_cast<uint32_t>(in[i + 1]) << 8 : 0);
+            out[0] = ALPHABET[value >> 18];
+            out[1] = ALPHABET[(value >> 12) & 0x3F];
+            out[2] = i + 1 < size ? ALPHABET[(value >> 6) & 0x3F] : '=';
+            out[3] = '=';
+        }
+    }
+
+    // Decodes padded base64 into `out`, which must hold decodedCapacity(size) bytes,
+    // and returns the number of bytes written. A length that is not a multiple of
+    // four, characters outside the alphabet, padding anywhere but at the end and set
+    // bits after the last byte are rejected, with `errorAt` set to the position.
+    static std::optional<size_t> decode(const char* in, size_t size, uint8_t* out, size_t& errorAt) {
+        if (size % 4 != 0) {
+            errorAt = size;
+            return std::nullopt;
+        }
+        if (size == 0) return 0;
+
+        size_t body = size - 4;
+        size_t i = 0;
+        if (CpuFeatures::avx2()) i = decodeAvx2(in, body, out);
+        else if (CpuFeatures::ssse3()) i = decodeSsse3(in, body, out);
+        size_t written = i / 4 * 3;
+
+        const auto& table = decodeTable();
+        for (; i < body; i += 4, written += 3) {
+            uint32_t a = table[static_cast<uint8_t>(in[i])];
+            uint32_t b = table[static_cast<uint8_t>(in[i + 1])];
+            uint32_t c = table[static_cast<uint8_t>(in[i + 2])];
+            uint32_t d = table[static_cast<uint8_t>(in[i + 3])];
+            if ((a | b | c | d) & INVALID) {
+                errorAt = firstInvalid(in + i, 4) + i;
+                return std::nullopt;
+            }
+            uint32_t value = a << 18 | b << 12 | c << 6 | d;
+            out[written] = static_cast<uint8_t>(value >> 16);
+            out[written + 1] = static_cast<uint8_t>(value >> 8);
+            out[written + 2] = static_cast<uint8_t>(value);
+        }
+
+        const char* last = in + body;
+        size_t padding = last[3] == '=' ? (last[2] == '=' ? 2 : 1) : 0;
+        size_t significant = 4 - padding;
+        if (size_t bad = firstInvalid(last, significant); bad < significant) {
+            errorAt = body + bad;
+            return std::nullopt;
+        }
+        uint32_t value = 0;
+        for (size_t k = 0; k < significant; ++k) value |= static_cast<uint32_t>(table[static_cast<uint8_t>(last[k])]) << (18 - 6 * k);
+        if ((padding == 1 && (value & 0xFF)) || (padding == 2 && (value & 0xFFFF))) {
+            errorAt = body + significant - 1;
+            return std::nullopt;
+        }
+        for (size_t k = 0; k < 3 - padding; ++k) out[written++] = static_cast<uint8_t>(value >> (16 - 8 * k));
+        return written;
+    }
+
+private:
+    static constexpr char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static constexpr uint8_t INVALID = 0x80;
+
+    static const std::array<uint8_t, 256>& decodeTable() {
+        static const std::array<uint8_t, 256> table = [] {
+            std::array<uint8_t, 256> values;
+            values.fill(INVALID);
+            for (uint8_t i = 0; i < 64; ++i) values[static_cast<uint8_t>(ALPHABET[i])] = i;
+            return values;
+        }();
+        return table;
+    }
+
+    static size_t firstInvalid(const char* in, size_t count) {
+        const auto& table = decodeTable();
+        size_t k = 0;
+        while (k < count && !(table[static_cast<uint8_t>(in[k])] & INVALID)) ++k;
+        return k;
+    }
+
+    // Splits each 3-byte group of the shuffled input into four 6-bit indices, one per
+    // byte, and turns those into characters: ranges 0-25, 26-51, 52-61, 62 and 63
+    // each need one offset, picked from a table by a saturating subtract.
+    TARGET_SSSE3 static __m128i encodeVector(__m128i input) {
+        __m128i shuffled = _mm_shuffle_epi8(input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        __m128i high = _mm_mulhi_epu16(_mm_and_si128(shuffled, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+        __m128i low = _mm_mullo_epi16(_mm_and_si128(shuffled, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(high, low);
+        __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+        const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+        return _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range));
+    }
+
+    TARGET_AVX2 static __m256i encodeVector(__m256i input) {
+        const __m256i order = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                               1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+        __m256i shuffled = _mm256_shuffle_epi8(input, order);
+        __m256i high = _mm256_mulhi_epu16(_mm256_and_si256(shuffled, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+        __m256i low = _mm256_mullo_epi16(_mm256_and_si256(shuffled, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(high, low);
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+        const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                 '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                                 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                 '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+        return _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range));
+    }
+
+    // Each step reads 16 bytes and uses 12 of them, so it stops 4 bytes early.
+    TARGET_SSSE3 static size_t encodeSsse3(const uint8_t* in, size_t size, char* out) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 12, out += 16) {
+            __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), encodeVector(input));
+        }
+        return i;
+    }
+
+    TARGET_AVX2 static size_t encodeAvx2(const uint8_t* in, size_t size, char* out) {
+        size_t i = 0;
+        for (; i + 28 <= size; i += 24, out += 32) {
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+            __m256i input = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), encodeVector(input));
+        }
+        return i;
+    }
+
+    // Maps characters to their 6-bit values, or reports through `valid` which bytes
+    // are outside the alphabet. Bytes from 0x80 up compare as negative and fall
+    // through every range.
+    static __m128i between(__m128i input, char low, char high) {
+        return _mm_and_si128(_mm_cmpgt_epi8(input, _mm_set1_epi8(static_cast<char>(low - 1))),
+                             _mm_cmpgt_epi8(_mm_set1_epi8(static_cast<char>(high + 1)), input));
+    }
+
+    TARGET_AVX2 static __m256i between(__m256i input, char low, char high) {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(input, _mm256_set1_epi8(static_cast<char>(low - 1))),
+                                _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(high + 1)), input));
+    }
+
+    TARGET_SSSE3 static __m128i decodeVector(__m128i input, bool& valid) {
+        __m128i upper = between(input, 'A', 'Z');
+        __m128i lower = between(input, 'a', 'z');
+        __m128i digit = between(input, '0', '9');
+        __m128i plus = _mm_cmpeq_epi8(input, _mm_set1_epi8('+'));
+        __m128i slash = _mm_cmpeq_epi8(input, _mm_set1_epi8('/'));
+        __m128i known = _mm_or_si128(_mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, plus)), slash);
+        valid = _mm_movemask_epi8(known) == 0xFFFF;
+        __m128i shift = _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+                                     _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                                                  _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')),
+                                                               _mm_and_si128(slash, _mm_set1_epi8(63 - '/')))));
+        __m128i values = _mm_add_epi8(input, shift);
+        __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        return _mm_shuffle_epi8(groups, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    }
+
+    TARGET_AVX2 static __m256i decodeVector(__m256i input, bool& valid) {
+        __m256i upper = between(input, 'A', 'Z');
+        __m256i lower = between(input, 'a', 'z');
+        __m256i digit = between(input, '0', '9');
+        __m256i plus = _mm256_cmpeq_epi8(input, _mm256_set1_epi8('+'));
+        __m256i slash = _mm256_cmpeq_epi8(input, _mm256_set1_epi8('/'));
+        __m256i known = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, plus)), slash);
+        valid = _mm256_movemask_epi8(known) == -1;
+        __m256i shift = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')), _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a'))),
+            _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')),
+                            _mm256_or_si256(_mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')),
+                                            _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')))));
+        __m256i values = _mm256_add_epi8(input, shift);
+        __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        __m256i groups = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        __m256i packed = _mm256_shuffle_epi8(groups, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                                      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+    }
+
+    // Each step stores 16 bytes of which 12 are output; stopping 24 characters before
+    // the end keeps the overhang inside the caller's buffer.
+    TARGET_SSSE3 static size_t decodeSsse3(const char* in, size_t size, uint8_t* out) {
+        size_t i = 0;
+        for (; i + 24 <= size; i += 16, out += 12) {
+            bool valid;
+            __m128i bytes = decodeVector(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), valid);
+            if (!valid) break;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), bytes);
+        }
+        return i;
+    }
+
+    TARGET_AVX2 static size_t decodeAvx2(const char* in, size_t size, uint8_t* out) {
+        size_t i = 0;
+        for (; i + 48 <= size; i += 32, out += 24) {
+            bool valid;
+            __m256i bytes = decodeVector(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)), valid);
+            if (!valid) break;
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), bytes);
+        }
+        return i;
+    }
+};
+
+// Finds files with identical contents in three narrowing stages: equal size, then
+// equal hashes of the first and last 4 KB, then equal hashes of the whole file. Only
+// the last stage reads whole files, and only for the candidates that are left. Hashes
+// are cached by file id, size and last write time, so repeating a search over an
+// unchanged tree reads nothing but the directories.
+class DuplicateFinder {
+public:
+    enum class LinkMode { Hard, Clone };
+
+    // One entry per distinct file; a file reached under several hard-linked names
+    // lists all of them, since space is only freed once every name is replaced.
+    struct Group {
+        uint64_t size;
+        std::vector<std::vector<fs::path>> files;
+
+        uint64_t reclaimable() const { return size * (files.size() - 1); }
+    };
+
+    class Cache {
+    public:
+        struct Hashes {
+            uint64_t size = 0;
+            uint64_t lastWriteTime = 0;
+            uint64_t partial = 0;
+            uint64_t full = 0;
+            bool hasFull = false;
+        };
+
+        bool find(DWORD volume, uint64_t fileId, uint64_t size, uint64_t lastWriteTime, Hashes& hashes) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto byVolume = volumes.find(volume);
+            if (byVolume == volumes.end()) return false;
+            auto it = byVolume->second.find(fileId);
+            if (it == byVolume->second.end() || it->second.size != size || it->second.lastWriteTime != lastWriteTime) return false;
+            hashes = it->second;
+            return true;
+        }
+
+        void store(DWORD volume, uint64_t fileId, const Hashes& hashes) {
+            std::lock_guard<std::mutex> lock(mutex);
+            volumes[volume][fileId] = hashes;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            volumes.clear();
+        }
+
+    private:
+        std::mutex mutex;
+        // Hashes by volume serial number, then by file id.
+        std::unordered_map<DWORD, std::unordered_map<uint64_t, Hashes>> volumes;
+    };
+
+    DuplicateFinder(ThreadPool& pool, Cache& cache, uint64_t minSize)
+        : pool(pool), cache(cache), minSize(std::max<uint64_t>(minSize, 1)) {}
+
+    void cancel() { cancelled = true; }
+    uint64_t scannedFiles() const { return scanned; }
+    uint64_t partialHashes() const { return partialHashed; }
+    uint64_t fullHashes() const { return fullHashed; }
+    uint64_t cacheHits() const { return cached; }
+    uint64_t linkedFiles() const { return linked; }
+    const std::vector<std::string>& errors() const { return failures; }
+
+    std::vector<Group> find(const fs::path& root, const std::function<void()>& report) {
+        // Reparse points are not followed, so every file found is on the root's volume.
+        {
+            DirectoryReader reader(root);
+            uint64_t fileId = 0;
+            uint64_t lastWriteTime = 0;
+            reader.identity(volume, fileId, lastWriteTime);
+        }
+        {
+            TaskGroup group(pool);
+            group.run([this, &group, root] { walk(group, root); });
+            while (!group.waitFor(std::chrono::milliseconds(REPORT_INTERVAL_MS))) report();
+        }
+        for (auto& candidate : candidates) std::sort(candidate.names.begin(), candidate.names.end());
+        narrow();
+        hashStage(false, report);
+        narrow();
+        hashStage(true, report);
+        narrow();
+
+        std::vector<Group> groups;
+        for (size_t begin = 0; begin < candidates.size() && !cancelled;) {
+            Group group{candidates[begin].size, {}};
+            size_t end = begin;
+            for (; end < candidates.size() && sameClass(candidates[begin], candidates[end]); ++end) {
+                group.files.push_back(std::move(candidates[end].names));
+            }
+            groups.push_back(std::move(group));
+            begin = end;
+        }
+        candidates.clear();
+        std::sort(groups.begin(), groups.end(), [](const Group& a, const Group& b) {
+            return a.reclaimable() > b.reclaimable();
+        });
+        return groups;
+    }
+
+    // Cluster size of the volume holding `path` if it supports block cloning, else 0.
+    static DWORD cloneClusterSize(const fs::path& path) {
+        wchar_t root[MAX_PATH];
+        DWORD flags = 0;
+        if (!GetVolumePathNameW(fs::absolute(path).c_str(), root, MAX_PATH) ||
+            !GetVolumeInformationW(root, nullptr, 0, nullptr, nullptr, &flags, nullptr, 0) ||
+            !(flags & FILE_SUPPORTS_BLOCK_REFCOUNTING)) {
+            return 0;
+        }
+        DWORD sectorsPerCluster = 0, bytesPerSector = 0, freeClusters = 0, totalClusters = 0;
+        if (!GetDiskFreeSpaceW(root, &sectorsPerCluster, &bytesPerSector, &freeClusters, &totalClusters)) return 0;
+        return sectorsPerCluster * bytesPerSector;
+    }
+
+    // Replaces every file of a group except the first by a hard link to, or a block
+    // clone of, the first. Contents are compared byte by byte before anything is
+    // replaced, so a hash collision can never destroy data. Returns the bytes freed.
+    uint64_t link(const std::vector<Group>& groups, LinkMode mode, DWORD clusterSize,
+                  const std::function<void()>& report) {
+        std::atomic<uint64_t> freed{0};
+        TaskGroup group(pool);
+        for (const auto& duplicates : groups) {
+            group.run([this, &duplicates, &freed, mode, clusterSize] {
+                const fs::path& keeper = duplicates.files[0].front();
+                for (size_t i = 1; i < duplicates.files.size() && !cancelled; ++i) {
+                    bool all = true;
+                    for (const auto& name : duplicates.files[i]) {
+                        if (replace(keeper, name, duplicates.size, mode, clusterSize)) linked++;
+                        else all = false;
+                    }
+                    if (all) freed += duplicates.size;
+                }
+            });
+        }
+        while (!group.waitFor(std::chrono::milliseconds(REPORT_INTERVAL_MS))) report();
+        return freed;
+    }
+
+private:
+    struct Candidate {
+        std::vector<fs::path> names;
+        uint64_t size;
+        uint64_t fileId;
+        uint64_t lastWriteTime;
+        uint64_t hash = 0;
+        bool valid = true;
+    };
+
+    static constexpr size_t PARTIAL_SPAN = 4096;
+    static constexpr size_t BATCH_FILES = 256;
+    static constexpr uint64_t BATCH_BYTES = 64 * 1024 * 1024;
+    static constexpr uint64_t CLONE_CHUNK = 1ull << 30;
+    static constexpr int REPORT_INTERVAL_MS = 200;
+
+    ThreadPool& pool;
+    Cache& cache;
+    uint64_t minSize;
+    DWORD volume = 0;
+    std::atomic<bool> cancelled{false};
+    std::atomic<uint64_t> scanned{0};
+    std::atomic<uint64_t> partialHashed{0};
+    std::atomic<uint64_t> fullHashed{0};
+    std::atomic<uint64_t> cached{0};
+    std::atomic<uint64_t> linked{0};
+    std::mutex mutex;
+    std::vector<Candidate> candidates;
+    std::unordered_map<uint64_t, size_t> byId;
+    std::vector<std::string> failures;
+
+    void fail(const fs::path& path, const std::string& message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        failures.push_back(path.u8string() + ": " + message);
+    }
+
+    static std::string systemMessage(DWORD error) {
+        return std::system_category().message(static_cast<int>(error));
+    }
+
+    static bool sameClass(const Candidate& a, const Candidate& b) {
+        return a.size == b.size && a.hash == b.hash;
+    }
+
+    void walk(TaskGroup& group, const fs::path& directory) {
+        DirectoryReader reader(directory);
+        std::vector<Candidate> found;
+        std::vector<fs::path> subdirectories;
+        bool complete = reader.forEach([&](const DirectoryReader::Entry& entry) {
+            if (entry.isReparsePoint()) return;
+            fs::path path = directory / std::wstring(entry.name, entry.nameLength);
+            if (entry.isDirectory()) subdirectories.push_back(std::move(path));
+            else if (entry.size >= minSize) found.push_back(Candidate{{std::move(path)}, entry.size, entry.fileId, entry.lastWriteTime});
+        });
+        if (!complete) fail(directory, systemMessage(reader.error()));
+
+        scanned += found.size();
+        {
+            // Hard links of one file share its id and occupy its space only once.
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& candidate : found) {
+                auto [it, added] = byId.emplace(candidate.fileId, candidates.size());
+                if (added) candidates.push_back(std::move(candidate));
+                else candidates[it->second].names.push_back(std::move(candidate.names.front()));
+            }
+        }
+        for (auto& subdirectory : subdirectories) {
+            if (cancelled) break;
+            group.run([this, &group, subdirectory = std::move(subdirectory)] { walk(group, subdirectory); });
+        }
+    }
+
+    // Keeps only candidates that share size and current hash with at least one other
+    // file, ordered so that each class is contiguous with its paths sorted.
+    void narrow() {
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                        [](const Candidate& candidate) { return !candidate.valid; }),
+                         candidates.end());
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+            return std::tie(a.size, a.hash, a.names) < std::tie(b.size, b.hash, b.names);
+        });
+        size_t kept = 0;
+        for (size_t begin = 0; begin < candidates.size();) {
+            size_t end = begin + 1;
+            while (end < candidates.size() && sameClass(candidates[begin], candidates[end])) ++end;
+            if (end - begin >= 2) {
+                for (size_t i = begin; i < end; ++i, ++kept) {
+                    if (kept != i) candidates[kept] = std::move(candidates[i]);
+                }
+            }
+            begin = end;
+        }
+        candidates.resize(kept);
+    }
+
+    // Hashes all candidates on the pool, small files in batches. Files small enough
+    // for the partial hash to cover them completely keep it as their full hash.
+    void hashStage(bool full, const std::function<void()>& report) {
+        TaskGroup group(pool);
+        for (size_t begin = 0; begin < candidates.size() && !cancelled;) {
+            size_t end = begin;
+            uint64_t bytes = 0;
+            while (end < candidates.size() && end - begin < BATCH_FILES && bytes < BATCH_BYTES) {
+                bytes += full ? candidates[end].size : 2 * PARTIAL_SPAN;
+                ++end;
+            }
+            group.run([this, begin, end, full] {
+                for (size_t i = begin; i < end && !cancelled; ++i) {
+                    Candidate& candidate = candidates[i];
+                    if (full && candidate.size <= 2 * PARTIAL_SPAN) continue;
+                    auto hash = full ? fullHash(candidate) : partialHash(candidate);
+                    if (hash) candidate.hash = *hash;
+                    else candidate.valid = false;
+                }
+            });
+            begin = end;
+        }
+        while (!group.waitFor(std::chrono::milliseconds(REPORT_INTERVAL_MS))) report();
+    }
+
+    static bool readAt(HANDLE file, uint8_t* buffer, size_t size, uint64_t offset) {
+        OVERLAPPED position{};
+        position.Offset = static_cast<DWORD>(offset);
+        position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD read = 0;
+        return size == 0 || (ReadFile(file, buffer, static_cast<DWORD>(size), &read, &position) && read == size);
+    }
+
+    std::optional<uint64_t> partialHash(const Candidate& candidate) {
+        Cache::Hashes hashes;
+        if (cache.find(volume, candidate.fileId, candidate.size, candidate.lastWriteTime, hashes)) {
+            cached++;
+            return hashes.partial;
+        }
+
+        HANDLE file = CreateFileW(candidate.names.front().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, 0, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            fail(candidate.names.front(), systemMessage(GetLastError()));
+            return std::nullopt;
+        }
+        uint8_t buffer[2 * PARTIAL_SPAN];
+        size_t head = static_cast<size_t>(std::min<uint64_t>(candidate.size, PARTIAL_SPAN));
+        size_t tail = static_cast<size_t>(std::min<uint64_t>(candidate.size - head, PARTIAL_SPAN));
+        bool ok = readAt(file, buffer, head, 0) && readAt(file, buffer + head, tail, candidate.size - tail);
+        DWORD error = GetLastError();
+        CloseHandle(file);
+        if (!ok) {
+            fail(candidate.names.front(), systemMessage(error));
+            return std::nullopt;
+        }
+
+        hashes = Cache::Hashes{candidate.size, candidate.lastWriteTime, Xxh3::hash(buffer, head + tail), 0, false};
+        if (candidate.size <= 2 * PARTIAL_SPAN) {
+            hashes.full = hashes.partial;
+            hashes.hasFull = true;
+        }
+        cache.store(volume, candidate.fileId, hashes);
+        partialHashed++;
+        return hashes.partial;
+    }
+
+    std::optional<uint64_t> fullHash(const Candidate& candidate) {
+        Cache::Hashes hashes;
+        bool known = cache.find(volume, candidate.fileId, candidate.size, candidate.lastWriteTime, hashes);
+        if (known && hashes.hasFull) {
+            cached++;
+            return hashes.full;
+        }
+
+        MappedFile mapped(candidate.names.front());
+        if (!mapped.isOpen() || mapped.size() != candidate.size) {
+            fail(candidate.names.front(), mapped.isOpen() ? "Datei wurde waehrend der Suche geaendert" : systemMessage(GetLastError()));
+            return std::nullopt;
+        }
+        MappedPrefetch prefetch(mapped.data(), mapped.size());
+        uint64_t hash = Xxh3::hash(reinterpret_cast<const uint8_t*>(mapped.data()), static_cast<size_t>(mapped.size()), &prefetch);
+        if (known) {
+            hashes.full = hash;
+            hashes.hasFull = true;
+            cache.store(volume, candidate.fileId, hashes);
+        }
+        fullHashed++;
+        return hash;
+    }
+
+    bool replace(const fs::path& keeper, const fs::path& duplicate, uint64_t size, LinkMode mode, DWORD clusterSize) {
+        {
+            MappedFile original(keeper);
+            MappedFile copy(duplicate);
+            if (!original.isOpen() || !copy.isOpen() || original.size() != size || copy.size() != size ||
+                std::memcmp(original.data(), copy.data(), static_cast<size_t>(size)) != 0) {
+                fail(duplicate, "Inhalt stimmt nicht mit " + keeper.u8string() + " ueberein, nicht ersetzt");
+                return false;
+            }
+        }
+
+        // The link is created under a temporary name and renamed over the duplicate,
+        // so the duplicate's name never disappears, even if linking fails halfway.
+        fs::path temporary = duplicate;
+        temporary += L".dupes~";
+        bool created = mode == LinkMode::Hard ? CreateHardLinkW(temporary.c_str(), keeper.c_str(), nullptr) != FALSE
+                                              : cloneTo(keeper, temporary, size, clusterSize);
+        if (!created) {
+            fail(duplicate, systemMessage(GetLastError()));
+            return false;
+        }
+        if (!MoveFileExW(temporary.c_str(), duplicate.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+            DWORD error = GetLastError();
+            DeleteFileW(temporary.c_str());
+            fail(duplicate, systemMessage(error));
+            return false;
+        }
+        return true;
+    }
+
+    static bool cloneTo(const fs::path& from, const fs::path& to, uint64_t size, DWORD clusterSize) {
+        HANDLE source = CreateFileW(from.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING, 0, nullptr);
+        if (source == INVALID_HANDLE_VALUE) return false;
+        HANDLE target = CreateFileW(to.c_str(), GENERIC_READ | GENERIC_WRITE | DELETE, 0, nullptr, CREATE_NEW, 0, nullptr);
+        if (target == INVALID_HANDLE_VALUE) {
+            DWORD error = GetLastError();
+            CloseHandle(source);
+            SetLastError(error);
+            return false;
+        }
+
+        DWORD returned = 0;
+        BY_HANDLE_FILE_INFORMATION info{};
+        GetFileInformationByHandle(source, &info);
+        bool ok = !(info.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) ||
+                  DeviceIoControl(target, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr);
+        FILE_END_OF_FILE_INFO endOfFile{};
+        endOfFile.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+        ok = ok && SetFileInformationByHandle(target, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+
+        uint64_t rounded = (size + clusterSize - 1) / clusterSize * clusterSize;
+        for (uint64_t offset = 0; ok && offset < rounded; offset += CLONE_CHUNK) {
+            DUPLICATE_EXTENTS_DATA extents{};
+            extents.FileHandle = source;
+            extents.SourceFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+            extents.TargetFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+            extents.ByteCount.QuadPart = static_cast<LONGLONG>(std::min(CLONE_CHUNK, rounded - offset));
+            ok = DeviceIoControl(target, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &extents, sizeof(extents),
+                                 nullptr, 0, &returned, nullptr);
+        }
+
+        DWORD error = GetLastError();
+        if (!ok) {
+            FILE_DISPOSITION_INFO disposition{TRUE};
+            SetFileInformationByHandle(target, FileDispositionInfo, &disposition, sizeof(disposition));
+        }
+        CloseHandle(target);
+        CloseHandle(source);
+        SetLastError(error);
+        return ok;
+    }
+};
+
+// Quantile sketch with relative accuracy (DDSketch). Values fall into buckets whose
+// bounds grow by gamma = (1 + a) / (1 - a), so every quantile is reported within a
+// relative error of a, using a few thousand counters for any amount of data. Sketches
+// of separate parts of the data merge by adding their counters.
+class QuantileSketch {
+public:
+    explicit QuantileSketch(double accuracy = 0.01)
+        : gamma((1 + accuracy) / (1 - accuracy)), inverseLogGamma(1 / std::log(gamma)) {}
+
+    void add(double value) {
+        if (value > MIN_MAGNITUDE) positive.add(key(value), 1);
+        else if (value < -MIN_MAGNITUDE) negative.add(key(-value), 1);
+        else ++zeros;
+    }
+
+    void merge(const QuantileSketch& other) {
+        positive.merge(other.positive);
+        negative.merge(other.negative);
+        zeros += other.zeros;
+    }
+
+    uint64_t count() const { return positive.total + negative.total + zeros; }
+
+    // Value at quantile `q` in [0, 1]; the sketch must not be empty.
+    double quantile(double q) const {
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count() - 1));
+        if (rank < negative.total) {
+            uint64_t seen = 0;
+            for (size_t i = negative.counts.size(); i-- > 0;) {
+                seen += negative.counts[i];
+                if (seen > rank) return -value(negative.offset + static_cast<int>(i));
+            }
+        }
+        rank -= std::min(rank, negative.total);
+        if (rank < zeros) return 0;
+        rank -= zeros;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < positive.counts.size(); ++i) {
+            seen += positive.counts[i];
+            if (seen > rank) return value(positive.offset + static_cast<int>(i));
+        }
+        return 0;
+    }
+
+private:
+    static constexpr double MIN_MAGNITUDE = 1e-12;
+
+    // Counters for a contiguous range of bucket keys, grown at either end on demand.
+    struct Store {
+        int offset = 0;
+        std::vector<uint64_t> counts;
+        uint64_t total = 0;
+
+        void add(int key, uint64_t n) {
+            if (counts.empty()) {
+                offset = key;
+                counts.assign(1, 0);
+            } else if (key < offset) {
+                counts.insert(counts.begin(), static_cast<size_t>(offset - key), 0);
+                offset = key;
+            } else if (key >= offset + static_cast<int>(counts.size())) {
+                counts.resize(static_cast<size_t>(key - offset + 1), 0);
+            }
+            counts[static_cast<size_t>(key - offset)] += n;
+            total += n;
+        }
+
+        void merge(const Store& other) {
+            for (size_t i = 0; i < other.counts.size(); ++i) {
+                if (other.counts[i] > 0) add(other.offset + static_cast<int>(i), other.counts[i]);
+            }
+        }
+    };
+
+    double gamma;
+    double inverseLogGamma;
+    Store positive;
+    Store negative;
+    uint64_t zeros = 0;
+
+    // Magnitudes are clamped to the finite range, which bounds the key and keeps the
+    // conversion to int defined.
+    int key(double magnitude) const {
+        magnitude = std::min(magnitude, std::numeric_limits<double>::max());
+        return static_cast<int>(std::ceil(std::log(magnitude) * inverseLogGamma));
+    }
+
+    // Midpoint of bucket `k`, (gamma^(k-1), gamma^k], in the relative sense.
+    double value(int k) const {
+        return 2 * std::pow(gamma, k) / (gamma + 1);
+    }
+};
+
+// Aggregates one numeric column of a delimited file, optionally per value of a second
+// column. The mapped file is split into line-aligned chunks that are scanned on the
+// thread pool. A scan finds separators and line feeds 64 bytes at a time with vector
+// compares and walks the resulting bit masks, so only the wanted fields are looked at
+// byte by byte. Each chunk fills its own table of partial states, merged at the end;
+// group keys are views into the mapping and are copied only then. Quotes around a
+// field are stripped, but separators inside quotes are not recognized.
+class ColumnAggregator {
+public:
+    struct Summary {
+        uint64_t count = 0;
+        double sum = 0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        QuantileSketch sketch;
+
+        void add(double value) {
+            ++count;
+            sum += value;
+            min = std::min(min, value);
+            max = std::max(max, value);
+            sketch.add(value);
+        }
+
+        void merge(const Summary& other) {
+            count += other.count;
+            sum += other.sum;
+            min = std::min(min, other.min);
+            max = std::max(max, other.max);
+            sketch.merge(other.sketch);
+        }
+    };
+
+    ColumnAggregator(ThreadPool& pool, const char* data, uint64_t size, char separator)
+        : pool(pool), data(data), size(size), separator(separator) {}
+
+    void cancel() { cancelled = true; }
+    uint64_t scannedBytes() const { return scanned; }
+    uint64_t skippedRows() const { return skipped; }
+
+    // Zero-based columns; without a group column everything lands in the group "".
+    // Calls `report` periodically from the calling thread while chunks are scanned.
+    template<class Report>
+    std::map<std::string, Summary> run(size_t valueColumn, std::optional<size_t> groupColumn, bool skipHeader,
+                                       Report&& report) {
+        const char* begin = data;
+        const char* end = data + size;
+        if (skipHeader) begin = nextLine(begin, end);
+
+        std::vector<std::pair<const char*, const char*>> chunks;
+        for (const char* chunk = begin; chunk < end;) {
+            const char* chunkEnd = chunk + std::min<uint64_t>(CHUNK_SIZE, static_cast<uint64_t>(end - chunk));
+            chunkEnd = nextLine(chunkEnd - 1, end);
+            chunks.emplace_back(chunk, chunkEnd);
+            chunk = chunkEnd;
+        }
+
+        std::vector<Partial> partials(chunks.size());
+        {
+            TaskGroup group(pool);
+            for (size_t i = 0; i < chunks.size(); ++i) {
+                group.run([this, &chunks, &partials, i, valueColumn, groupColumn] {
+                    scan(chunks[i].first, chunks[i].second, valueColumn, groupColumn, partials[i]);
+                });
+            }
+            while (!group.waitFor(std::chrono::milliseconds(REPORT_INTERVAL_MS))) report();
+        }
+
+        std::map<std::string, Summary> merged;
+        for (const auto& partial : partials) {
+            for (const auto& [key, summary] : partial) merged[std::string(key)].merge(summary);
+        }
+        return merged;
+    }
+
+private:
+    using Partial = std::unordered_map<std::string_view, Summary>;
+    using MaskFunction = uint64_t (*)(const char* block, char separator);
+
+    static constexpr uint64_t CHUNK_SIZE = 64 * 1024 * 1024;
+    static constexpr size_t BLOCK = 64;
+    static constexpr uint64_t PROGRESS_STEP = 1024 * 1024;
+    static constexpr int REPORT_INTERVAL_MS = 200;
+
+    ThreadPool& pool;
+    const char* data;
+    uint64_t size;
+    char separator;
+    std::atomic<bool> cancelled{false};
+    std::atomic<uint64_t> scanned{0};
+    std::atomic<uint64_t> skipped{0};
+
+    static const char* nextLine(const char* from, const char* end) {
+        const void* lineFeed = std::memchr(from, '\n', static_cast<size_t>(end - from));
+        return lineFeed ? static_cast<const char*>(lineFeed) + 1 : end;
+    }
+
+    // Bit i is set where block[i] is the separator or a line feed.
+    static uint64_t structuralSse2(const char* block, char separator) {
+        const __m128i sep = _mm_set1_epi8(separator);
+        const __m128i lineFeed = _mm_set1_epi8('\n');
+        uint64_t mask = 0;
+        for (int i = 0; i < 4; ++i) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block) + i);
+            __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(bytes, sep), _mm_cmpeq_epi8(bytes, lineFeed));
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hits))) << (16 * i);
+        }
+        return mask;
+    }
+
+    TARGET_AVX2 static uint64_t structuralAvx2(const char* block, char separator) {
+        const __m256i sep = _mm256_set1_epi8(separator);
+        const __m256i lineFeed = _mm256_set1_epi8('\n');
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block) + 1);
+        uint32_t lowMask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(low, sep), _mm256_cmpeq_epi8(low, lineFeed))));
+        uint32_t highMask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(high, sep), _mm256_cmpeq_epi8(high, lineFeed))));
+        return static_cast<uint64_t>(highMask) << 32 | lowMask;
+    }
+
+    static std::string_view trim(const char* begin, const char* end) {
+        while (begin < end && (*begin == ' ' || *begin == '"')) ++begin;
+        while (end > begin && (end[-1] == ' ' || end[-1] == '"' || end[-1] == '\r')) --end;
+        return std::string_view(begin, static_cast<size_t>(end - begin));
+    }
+
+    void scan(const char* begin, const char* end, size_t valueColumn, std::optional<size_t> groupColumn,
+              Partial& partial) {
+        MappedPrefetch prefetch(begin, static_cast<uint64_t>(end - begin));
+        MaskFunction structural = CpuFeatures::avx2() ? structuralAvx2 : structuralSse2;
+        size_t groupIndex = groupColumn.value_or(SIZE_MAX);
+        Summary* ungrouped = groupColumn ? nullptr : &partial[std::string_view()];
+        uint64_t skippedHere = 0;
+
+        size_t field = 0;
+        const char* fieldStart = begin;
+        std::string_view value;
+        std::string_view key;
+        bool hasValue = false;
+        bool hasKey = !groupColumn;
+
+        auto boundary = [&](const char* at) {
+            if (field == valueColumn) {
+                value = trim(fieldStart, at);
+                hasValue = true;
+            }
+            if (field == groupIndex) {
+                key = trim(fieldStart, at);
+                hasKey = true;
+            }
+            if (at == end || *at == '\n') {
+                double number = 0;
+                auto [next, ec] = std::from_chars(value.data(), value.data() + value.size(), number);
+                // from_chars accepts "inf" and "nan"; they are counted as rows without a number.
+                if (hasValue && hasKey && ec == std::errc() && next == value.data() + value.size() && std::isfinite(number)) {
+                    (ungrouped ? *ungrouped : partial[key]).add(number);
+                } else if (field > 0 || !trim(fieldStart, at).empty()) {
+                    ++skippedHere;
+                }
+                field = 0;
+                hasValue = false;
+                hasKey = !groupColumn;
+            } else {
+                ++field;
+            }
+            fieldStart = at + 1;
+        };
+
+        const char* p = begin;
+        const char* reported = begin;
+        for (; p + BLOCK <= end && !cancelled; p += BLOCK) {
+            for (uint64_t mask = structural(p, separator); mask != 0; mask &= mask - 1) {
+                unsigned long bit;
+                _BitScanForward64(&bit, mask);
+                boundary(p + bit);
+            }
+            if (static_cast<uint64_t>(p - reported) >= PROGRESS_STEP) {
+                prefetch.advance(static_cast<uint64_t>(p - begin));
+                scanned += static_cast<uint64_t>(p - reported);
+                reported = p;
+            }
+        }
+        for (; p < end && !cancelled; ++p) {
+            if (*p == separator || *p == '\n') boundary(p);
+        }
+        if (!cancelled && fieldStart < end) boundary(end);
+        scanned += static_cast<uint64_t>(end - reported);
+        skipped += skippedHere;
+    }
+};
+
+// Radix sorts for large in-memory arrays. Strings go through an in-place MSD radix
+// sort (American flag) that reads each byte once per level into a digit cache; small
+// buckets fall back to multikey quicksort, which never compares a common prefix
+// twice. Integer keys get one MSD pass on the highest byte in which they differ and
+// then LSD passes inside every bucket. With a pool, the buckets of the first pass are
+// sorted in parallel. Ranges of items with equal keys go to `tie`, which may order
+// them further.
+class RadixSort {
+public:
+    // Below this size std::sort is faster.
+    static constexpr size_t THRESHOLD = 4096;
+
+    // `digit(item, depth)` is 0 past the end of the key and the key byte + 1 before.
+    template<class T, class Digit, class Tie>
+    static void sortStrings(T* items, size_t count, const Digit& digit, const Tie& tie, ThreadPool* pool) {
+        std::vector<uint16_t> oracle(count);
+        msd(items, count, 0, oracle.data(), digit, tie, pool);
+    }
+
+    template<class T, class Key, class Tie>
+    static void sortKeys(T* items, size_t count, const Key& key, const Tie& tie, ThreadPool* pool) {
+        if (count < 2) return;
+        uint64_t first = key(items[0]);
+        uint64_t differing = 0;
+        for (size_t i = 1; i < count; ++i) differing |= key(items[i]) ^ first;
+        if (differing == 0) {
+            tie(items, count);
+            return;
+        }
+        unsigned long top;
+        _BitScanReverse64(&top, differing);
+        unsigned shift = top >= KEY_DIGIT_BITS ? static_cast<unsigned>(top) + 1 - KEY_DIGIT_BITS : 0;
+
+        std::vector<uint16_t> oracle(count);
+        std::vector<size_t> sizes(KEY_BUCKETS);
+        for (size_t i = 0; i < count; ++i) {
+            ++sizes[oracle[i] = static_cast<uint16_t>((key(items[i]) >> shift) & (KEY_BUCKETS - 1))];
+        }
+        permute<KEY_BUCKETS>(items, oracle.data(), sizes.data());
+        forEachBucket<KEY_BUCKETS>(items, sizes.data(), pool, [&](T* bucket, size_t size) { lsd(bucket, size, shift, key, tie); });
+    }
+
+    // Maps doubles to integers with the same order; -0 and NaN map like 0.
+    static uint64_t orderedKey(double value) {
+        if (value == 0 || value != value) value = 0;
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits >> 63 ? ~bits : bits | (uint64_t(1) << 63);
+    }
+
+private:
+    static constexpr size_t BUCKETS = 257;
+    // The first pass over integer keys uses wider digits, so that the buckets the LSD
+    // passes work on fit into the cache.
+    static constexpr unsigned KEY_DIGIT_BITS = 11;
+    static constexpr size_t KEY_BUCKETS = size_t(1) << KEY_DIGIT_BITS;
+    static constexpr size_t MULTIKEY_THRESHOLD = 64;
+    static constexpr size_t INSERTION_THRESHOLD = 12;
+    static constexpr size_t PARALLEL_BUCKET = 16384;
+
+    // Moves every item into the bucket its cached digit names, in place.
+    template<size_t Buckets, class T>
+    static void permute(T* items, uint16_t* oracle, const size_t* sizes) {
+        size_t next[Buckets];
+        size_t end[Buckets];
+        size_t position = 0;
+        for (size_t b = 0; b < Buckets; ++b) {
+            next[b] = position;
+            position += sizes[b];
+            end[b] = position;
+        }
+        for (size_t b = 0; b < Buckets; ++b) {
+            while (next[b] < end[b]) {
+                size_t i = next[b];
+                uint16_t d = oracle[i];
+                if (d == b) {
+                    ++next[b];
+                    continue;
+                }
+                T item = std::move(items[i]);
+                do {
+                    size_t j = next[d]++;
+                    std::swap(item, items[j]);
+                    std::swap(d, oracle[j]);
+                } while (d != b);
+                items[i] = std::move(item);
+                oracle[i] = d;
+                ++next[b];
+            }
+        }
+    }
+
+    // Runs `sort(bucket, size)` for every bucket with more than one item; large
+    // buckets go to the pool when there is one.
+    template<size_t Buckets, class T, class Sort>
+    static void forEachBucket(T* items, const size_t* sizes, ThreadPool* pool, const Sort& sort) {
+        std::optional<TaskGroup> group;
+        if (pool) group.emplace(*pool);
+        size_t start = 0;
+        for (size_t b = 0; b < Buckets; ++b) {
+            T* bucket = items + start;
+            size_t size = sizes[b];
+            start += size;
+            if (size < 2) continue;
+            if (group && size >= PARALLEL_BUCKET) group->run([&sort, bucket, size] { sort(bucket, size); });
+            else sort(bucket, size);
+        }
+    }
+
+    template<class T, class Digit, class Tie>
+    static void msd(T* items, size_t count, size_t depth, uint16_t* oracle, const Digit& digit, const Tie& tie,
+                    ThreadPool* pool) {
+        for (;; ++depth) {
+            if (count < MULTIKEY_THRESHOLD) {
+                multikey(items, count, depth, digit, tie);
+                return;
+            }
+            size_t sizes[BUCKETS] = {};
+            for (size_t i = 0; i < count; ++i) ++sizes[oracle[i] = static_cast<uint16_t>(digit(items[i], depth))];
+            if (sizes[0] == count) {
+                tie(items, count);
+                return;
+            }
+            // A byte shared by all items starts a common prefix, which is skipped at once.
+            if (sizes[oracle[0]] == count) {
+                size_t shared = SIZE_MAX;
+                for (size_t i = 1; i < count && shared > depth + 1; ++i) {
+                    size_t at = depth + 1;
+                    while (at < shared) {
+                        unsigned byte = digit(items[0], at);
+                        if (byte == 0 || byte != digit(items[i], at)) break;
+                        ++at;
+                    }
+                    shared = at;
+                }
+                depth = shared - 1;
+                continue;
+            }
+
+            permute<BUCKETS>(items, oracle, sizes);
+            if (sizes[0] > 1) tie(items, sizes[0]);
+            size_t ended = sizes[0];
+            sizes[0] = 0;
+            forEachBucket<BUCKETS>(items + ended, sizes, pool, [&](T* bucket, size_t size) {
+                msd(bucket, size, depth + 1, oracle + (bucket - items), digit, tie, nullptr);
+            });
+            return;
+        }
+    }
+
+    template<class T, class Digit>
+    static int compareFrom(const T& a, const T& b, size_t depth, const Digit& digit) {
+        for (;; ++depth) {
+            unsigned x = digit(a, depth);
+            unsigned y = digit(b, depth);
+            if (x != y) return x < y ? -1 : 1;
+            if (x == 0) return 0;
+        }
+    }
+
+    template<class T, class Digit, class Tie>
+    static void multikey(T* items, size_t count, size_t depth, const Digit& digit, const Tie& tie) {
+        while (count > INSERTION_THRESHOLD) {
+            unsigned a = digit(items[0], depth);
+            unsigned b = digit(items[count / 2], depth);
+            unsigned c = digit(items[count - 1], depth);
+            unsigned pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+            size_t less = 0;
+            size_t i = 0;
+            size_t greater = count;
+            while (i < greater) {
+                unsigned d = digit(items[i], depth);
+                if (d < pivot) std::swap(items[less++], items[i++]);
+                else if (d > pivot) std::swap(items[i], items[--greater]);
+                else ++i;
+            }
+            multikey(items, less, depth, digit, tie);
+            multikey(items + greater, count - greater, depth, digit, tie);
+            if (pivot == 0) {
+                if (greater - less > 1) tie(items + less, greater - less);
+                return;
+            }
+            items += less;
+            count = greater - less;
+            ++depth;
+        }
+        for (size_t i = 1; i < count; ++i) {
+            for (size_t j = i; j > 0 && compareFrom(items[j - 1], items[j], depth, digit) > 0; --j) {
+                std::swap(items[j - 1], items[j]);
+            }
+        }
+        for (size_t i = 0; i < count;) {
+            size_t j = i + 1;
+            while (j < count && compareFrom(items[i], items[j], depth, digit) == 0) ++j;
+            if (j - i > 1) tie(items + i, j - i);
+            i = j;
+        }
+    }
+
+    // Sorts by the low `bits` bits of the key; the higher bits are equal in a bucket.
+    template<class T, class Key, class Tie>
+    static void lsd(T* items, size_t count, unsigned bits, const Key& key, const Tie& tie) {
+        if (count < MULTIKEY_THRESHOLD) {
+            std::sort(items, items + count, [&key](const T& a, const T& b) { return key(a) < key(b); });
+        } else {
+            std::vector<T> buffer(count);
+            T* from = items;
+            T* to = buffer.data();
+            for (unsigned shift = 0; shift < bits; shift += 8) {
+                size_t sizes[256] = {};
+                for (size_t i = 0; i < count; ++i) ++sizes[(key(from[i]) >> shift) & 0xff];
+                if (sizes[(key(from[0]) >> shift) & 0xff] == count) continue;
+                size_t next[256];
+                for (size_t d = 0, position = 0; d < 256; position += sizes[d++]) next[d] = position;
+                for (size_t i = 0; i < count; ++i) to[next[(key(from[i]) >> shift) & 0xff]++] = from[i];
+                std::swap(from, to);
+            }
+            if (from != items) std::copy(from, from + count, items);
+        }
+        for (size_t i = 0; i < count;) {
+            uint64_t value = key(items[i]);
+            size_t j = i + 1;
+            while (j < count && key(items[j]) == value) ++j;
+            if (j - i > 1) tie(items + i, j - i);
+            i = j;
+        }
+    }
+};
+
+// Sorts text files of any size line by line within a memory budget. The input is read
+// in large sequential blocks, and each block is sorted on the thread pool and written
+// out as a run while the next one is read. Lines stay in the block they were read
+// into, which serves as the arena; the sort moves small records that cache the first
+// 8 key bytes as an integer, so most comparisons never touch the text. The runs are
+// then merged through a loser tree, which costs one comparison per tree level and
+// line. Input that fits into a single block goes straight to the output.
+class ExternalSorter {
+public:
+    struct Options {
+        size_t keyField = 0;    // 1-based, blank-separated; 0 sorts by the whole line
+        bool numeric = false;
+        bool unique = false;    // keeps only the first line of every key
+        uint64_t memoryBudget = 512ull * 1024 * 1024;
+        fs::path temporaryDirectory;
+    };
+
+    using Sink = std::function<bool(const char* data, size_t size)>;
+
+    ExternalSorter(ThreadPool& pool, Options options) : pool(pool), options(std::move(options)) {}
+
+    // Half of the physical memory that is currently available.
+    static uint64_t defaultBudget() {
+        MEMORYSTATUSEX memInfo;
+        memInfo.dwLength = sizeof(MEMORYSTATUSEX);
+        if (!GlobalMemoryStatusEx(&memInfo)) return Options().memoryBudget;
+        return std::max<uint64_t>(MIN_BUDGET, memInfo.ullAvailPhys / 2);
+    }
+
+    void cancel() { cancelled = true; }
+    uint64_t readBytes() const { return bytesRead; }
+    uint64_t mergedBytes() const { return bytesMerged; }
+    size_t runCount() const { return runs; }
+
+    // Passes the sorted lines, each terminated by "\n", to `sink` in large slices.
+    // Calls `report` periodically from the calling thread. Returns false on errors,
+    // with `error` set, and when cancelled.
+    template<class Report>
+    bool sort(const fs::path& input, const Sink& sink, std::string& error, Report&& report) {
+        HANDLE file = CreateFileW(input.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            error = "Eingabe konnte nicht geoeffnet werden";
+            return false;
+        }
+        std::vector<fs::path> runFiles;
+        bool ok = generateRuns(file, sink, runFiles, error, report);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        if (ok && !runFiles.empty()) ok = mergeRuns(runFiles, sink, error, report);
+        for (const auto& path : temporaries) DeleteFileW(path.c_str());
+        temporaries.clear();
+        return ok && !cancelled;
+    }
+
+private:
+    struct Record {
+        uint64_t prefix;     // first key bytes big-endian, or the order-preserving bits of a number
+        const char* line;
+        uint32_t length;     // without the "\n"
+        uint32_t keyStart;
+        uint32_t keyLength;
+    };
+
+    struct Block {
+        std::unique_ptr<char[]> text;
+        size_t capacity = 0;
+        std::vector<Record> records;
+    };
+
+    // Reads a run back in large slices; a line stays valid until the next call.
+    struct RunReader {
+        HANDLE file = INVALID_HANDLE_VALUE;
+        std::unique_ptr<char[]> buffer;
+        size_t capacity = 0;
+        size_t begin = 0;
+        size_t end = 0;
+        bool atEnd = false;
+        bool failed = false;
+
+        ~RunReader() {
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        }
+
+        bool next(const char*& line, size_t& length) {
+            for (;;) {
+                const void* lineFeed = std::memchr(buffer.get() + begin, '\n', end - begin);
+                if (lineFeed || (atEnd && begin < end)) {
+                    line = buffer.get() + begin;
+                    length = lineFeed ? static_cast<size_t>(static_cast<const char*>(lineFeed) - line) : end - begin;
+                    begin += lineFeed ? length + 1 : length;
+                    return true;
+                }
+                if (atEnd) return false;
+                std::memmove(buffer.get(), buffer.get() + begin, end - begin);
+                end -= begin;
+                begin = 0;
+                if (end == capacity) {
+                    std::unique_ptr<char[]> grown(new char[capacity * 2]);
+                    std::memcpy(grown.get(), buffer.get(), end);
+                    buffer = std::move(grown);
+                    capacity *= 2;
+                }
+                DWORD got = 0;
+                if (!ReadFile(file, buffer.get() + end, static_cast<DWORD>(std::min(capacity - end, IO_SLICE)), &got, nullptr)) {
+                    failed = true;
+                    return false;
+                }
+                atEnd = got == 0;
+                end += got;
+            }
+        }
+    };
+
+    // Buffers lines for `sink` and drops repeated keys when the options ask for it.
+    class LineWriter {
+    public:
+        LineWriter(const ExternalSorter& sorter, const Sink& sink) : sorter(sorter), sink(sink) {
+            buffer.reserve(WRITE_BUFFER);
+        }
+
+        bool put(const Record& record) {
+            if (sorter.options.unique) {
+                if (hasPrevious && sorter.sameKey(previous, record)) return true;
+                previousText.assign(record.line, record.length);
+                previous = record;
+                previous.line = previousText.data();
+                hasPrevious = true;
+            }
+            if (buffer.size() + record.length + 1 > WRITE_BUFFER && !flush()) return false;
+            buffer.insert(buffer.end(), record.line, record.line + record.length);
+            buffer.push_back('\n');
+            return true;
+        }
+
+        bool flush() {
+            bool ok = buffer.empty() || sink(buffer.data(), buffer.size());
+            buffer.clear();
+            return ok;
+        }
+
+    private:
+        const ExternalSorter& sorter;
+        const Sink& sink;
+        std::vector<char> buffer;
+        std::string previousText;
+        Record previous{};
+        bool hasPrevious = false;
+    };
+
+    static constexpr size_t BLOCKS = 4;
+    static constexpr uint64_t MIN_BUDGET = 64 * 1024 * 1024;
+    static constexpr size_t IO_SLICE = 64 * 1024 * 1024;
+    static constexpr size_t WRITE_BUFFER = 8 * 1024 * 1024;
+    static constexpr size_t MIN_MERGE_BUFFER = 256 * 1024;
+    static constexpr size_t MAX_MERGE_BUFFER = 64 * 1024 * 1024;
+    static constexpr uint64_t REPORT_EVERY_LINES = 1 << 16;
+    static constexpr int REPORT_INTERVAL_MS = 200;
+
+    ThreadPool& pool;
+    Options options;
+    std::vector<fs::path> temporaries;
+    std::atomic<bool> cancelled{false};
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<uint64_t> bytesMerged{0};
+    std::atomic<size_t> runs{0};
+
+    static bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+    Record makeRecord(const char* line, size_t length) const {
+        size_t end = length;
+        if (end > 0 && line[end - 1] == '\r') --end;
+        size_t keyStart = 0;
+        size_t keyEnd = end;
+        if (options.keyField > 0) {
+            size_t at = 0;
+            size_t field = 0;
+            while (field < options.keyField) {
+                while (at < end && isBlank(line[at])) ++at;
+                keyStart = at;
+                while (at < end && !isBlank(line[at])) ++at;
+                ++field;
+                if (at == end) break;
+            }
+            if (field < options.keyField) keyStart = end;
+            keyEnd = at;
+        }
+
+        Record record{0, line, static_cast<uint32_t>(length), static_cast<uint32_t>(keyStart),
+                      static_cast<uint32_t>(keyEnd - keyStart)};
+        const char* key = line + keyStart;
+        if (options.numeric) {
+            const char* keyLimit = line + keyEnd;
+            while (key < keyLimit && isBlank(*key)) ++key;
+            if (key < keyLimit && *key == '+') ++key;
+            double value = 0;
+            std::from_chars(key, keyLimit, value);
+            record.prefix = RadixSort::orderedKey(value);
+        } else {
+            size_t packed = std::min<size_t>(record.keyLength, 8);
+            for (size_t i = 0; i < packed; ++i) {
+                record.prefix |= static_cast<uint64_t>(static_cast<unsigned char>(key[i])) << (56 - 8 * i);
+            }
+        }
+        return record;
+    }
+
+    // Orders keys whose cached prefixes are equal.
+    static int compareKeyTails(const Record& a, const Record& b) {
+        size_t common = std::min(a.keyLength, b.keyLength);
+        if (common > 8) {
+            int order = std::memcmp(a.line + a.keyStart + 8, b.line + b.keyStart + 8, common - 8);
+            if (order != 0) return order;
+        }
+        return (a.keyLength > b.keyLength) - (a.keyLength < b.keyLength);
+    }
+
+    // Equal keys fall back to the whole line, so the output does not depend on the
+    // order in which lines were read.
+    int compare(const Record& a, const Record& b) const {
+        if (a.prefix != b.prefix) return a.prefix < b.prefix ? -1 : 1;
+        if (!options.numeric) {
+            int order = compareKeyTails(a, b);
+            if (order != 0) return order;
+        }
+        int order = std::memcmp(a.line, b.line, std::min(a.length, b.length));
+        if (order != 0) return order;
+        return (a.length > b.length) - (a.length < b.length);
+    }
+
+    bool sameKey(const Record& a, const Record& b) const {
+        return a.prefix == b.prefix && (options.numeric || compareKeyTails(a, b) == 0);
+    }
+
+    void sortBlock(Block& block, size_t size, bool parallel) {
+        block.records.clear();
+        const char* text = block.text.get();
+        for (size_t start = 0; start < size;) {
+            const void* lineFeed = std::memchr(text + start, '\n', size - start);
+            size_t end = lineFeed ? static_cast<size_t>(static_cast<const char*>(lineFeed) - text) : size;
+            block.records.push_back(makeRecord(text + start, end - start));
+            start = end + 1;
+        }
+        auto less = [this](const Record& a, const Record& b) { return compare(a, b) < 0; };
+        auto tie = [&less](Record* first, size_t count) { std::sort(first, first + count, less); };
+        Record* records = block.records.data();
+        size_t count = block.records.size();
+        ThreadPool* buckets = parallel ? &pool : nullptr;
+        if (count < RadixSort::THRESHOLD) {
+            std::sort(records, records + count, less);
+        } else if (options.numeric) {
+            RadixSort::sortKeys(records, count, [](const Record& record) { return record.prefix; }, tie, buckets);
+        } else {
+            RadixSort::sortStrings(records, count, [](const Record& record, size_t depth) -> unsigned {
+                if (depth >= record.keyLength) return 0;
+                if (depth < 8) return static_cast<unsigned>(record.prefix >> (56 - 8 * depth) & 0xff) + 1;
+                return static_cast<unsigned char>(record.line[record.keyStart + depth]) + 1u;
+            }, tie, buckets);
+        }
+    }
+
+    static bool writeFile(HANDLE file, const char* data, size_t size) {
+        while (size > 0) {
+            DWORD slice = static_cast<DWORD>(std::min(size, IO_SLICE));
+            DWORD written = 0;
+            if (!WriteFile(file, data, slice, &written, nullptr) || written != slice) return false;
+            data += slice;
+            size -= slice;
+        }
+        return true;
+    }
+
+    fs::path temporaryPath() {
+        fs::path directory = options.temporaryDirectory;
+        if (directory.empty()) {
+            std::error_code ec;
+            directory = fs::temp_directory_path(ec);
+        }
+        fs::path path = directory / ("sort-" + std::to_string(GetCurrentProcessId()) + "-" +
+                                     std::to_string(temporaries.size()) + ".tmp");
+        temporaries.push_back(path);
+        return path;
+    }
+
+    // Writes `records` to a new temporary file.
+    bool writeRun(const fs::path& path, const std::vector<Record>& records) {
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                  FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        Sink toFile = [file](const char* data, size_t size) { return writeFile(file, data, size); };
+        LineWriter writer(*this, toFile);
+        bool ok = true;
+        for (size_t i = 0; ok && i < records.size() && !cancelled; ++i) ok = writer.put(records[i]);
+        ok = ok && writer.flush();
+        CloseHandle(file);
+        return ok;
+    }
+
+    // Fills blocks from `file` and turns each into a sorted run on the pool. A block
+    // ends at its last line feed; the partial line moves on to the next block, and a
+    // block without any line feed grows until the line fits. Closes `file` early when
+    // the whole input fits into the first block and is written to `sink` directly.
+    template<class Report>
+    bool generateRuns(HANDLE& file, const Sink& sink, std::vector<fs::path>& runFiles, std::string& error,
+                      Report& report) {
+        size_t blockSize = static_cast<size_t>(std::max(MIN_BUDGET, options.memoryBudget) / BLOCKS / 3);
+        std::vector<Block> blocks(BLOCKS);
+        std::vector<Block*> idle;
+        for (auto& block : blocks) idle.push_back(&block);
+        std::mutex mutex;
+        std::condition_variable released;
+        std::string failure;
+        std::string carry;
+        bool atEnd = false;
+
+        TaskGroup group(pool);
+        while (!atEnd && !cancelled) {
+            Block* block;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (!released.wait_for(lock, std::chrono::milliseconds(REPORT_INTERVAL_MS), [&] { return !idle.empty(); })) {
+                    lock.unlock();
+                    report();
+                    lock.lock();
+                }
+                if (!failure.empty()) break;
+                block = idle.back();
+                idle.pop_back();
+            }
+            // The carry left behind by a block that grew for a long line can be
+            // larger than any idle block; it needs room for at least one more read.
+            if (block->capacity < blockSize || block->capacity <= carry.size()) {
+                size_t capacity = std::max(blockSize, carry.size() * 2);
+                block->text.reset(new char[capacity]);
+                block->capacity = capacity;
+            }
+
+            std::memcpy(block->text.get(), carry.data(), carry.size());
+            size_t used = carry.size();
+            size_t complete = 0;
+            bool readFailed = false;
+            for (;;) {
+                while (used < block->capacity && !atEnd) {
+                    DWORD got = 0;
+                    DWORD slice = static_cast<DWORD>(std::min(block->capacity - used, IO_SLICE));
+                    if (!ReadFile(file, block->text.get() + used, slice, &got, nullptr)) {
+                        readFailed = true;
+                        break;
+                    }
+                    atEnd = got == 0;
+                    used += got;
+                    bytesRead += got;
+                }
+                complete = used;
+                if (atEnd || readFailed) break;
+                while (complete > 0 && block->text[complete - 1] != '\n') --complete;
+                if (complete > 0 || used < block->capacity) break;
+                std::unique_ptr<char[]> grown(new char[block->capacity * 2]);
+                std::memcpy(grown.get(), block->text.get(), used);
+                block->text = std::move(grown);
+                block->capacity *= 2;
+            }
+            carry.assign(block->text.get() + complete, used - complete);
+            if (readFailed) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failure = "Eingabe konnte nicht gelesen werden";
+                break;
+            }
+
+            if (atEnd && runFiles.empty()) {
+                CloseHandle(file);
+                file = INVALID_HANDLE_VALUE;
+                sortBlock(*block, complete, true);
+                LineWriter writer(*this, sink);
+                for (size_t i = 0; i < block->records.size() && !cancelled; ++i) {
+                    if (!writer.put(block->records[i])) {
+                        error = "Ausgabe konnte nicht geschrieben werden";
+                        return false;
+                    }
+                }
+                if (!writer.flush()) {
+                    error = "Ausgabe konnte nicht geschrieben werden";
+                    return false;
+                }
+                return true;
+            }
+
+            fs::path path = temporaryPath();
+            runFiles.push_back(path);
+            group.run([this, block, complete, path, &mutex, &released, &idle, &failure] {
+                sortBlock(*block, complete, false);
+                bool ok = writeRun(path, block->records);
+                ++runs;
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ok && failure.empty()) failure = "Temporaere Datei '" + path.u8string() + "' konnte nicht geschrieben werden";
+                idle.push_back(block);
+                released.notify_one();
+            });
+        }
+        while (!group.waitFor(std::chrono::milliseconds(REPORT_INTERVAL_MS))) report();
+        if (!failure.empty()) {
+            error = failure;
+            return false;
+        }
+        return true;
+    }
+
+    // Merges runs in passes of at most as many files as the budget has read buffers
+    // for; normally a single pass goes straight to `sink`.
+    template<class Report>
+    bool mergeRuns(std::vector<fs::path> runFiles, const Sink& sink, std::string& error, Report& report) {
+        size_t fanIn = static_cast<size_t>(std::max<uint64_t>(2, options.memoryBudget / (4 * MIN_MERGE_BUFFER)));
+        while (runFiles.size() > fanIn && !cancelled) {
+            std::vector<fs::path> pass(runFiles.begin(), runFiles.begin() + fanIn);
+            runFiles.erase(runFiles.begin(), runFiles.begin() + fanIn);
+            fs::path merged = temporaryPath();
+            HANDLE file = CreateFileW(merged.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                      FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                error = "Temporaere Datei '" + merged.u8string() + "' konnte nicht angelegt werden";
+                return false;
+            }
+            Sink toFile = [file](const char* data, size_t size) { return writeFile(file, data, size); };
+            bool ok = mergePass(pass, toFile, error, report);
+            CloseHandle(file);
+            if (!ok) return false;
+            for (const auto& path : pass) DeleteFileW(path.c_str());
+            runFiles.push_back(merged);
+        }
+        return cancelled || mergePass(runFiles, sink, error, report);
+    }
+
+    template<class Report>
+    bool mergePass(const std::vector<fs::path>& runFiles, const Sink& sink, std::string& error, Report& report) {
+        size_t count = runFiles.size();
+        size_t bufferSize = static_cast<size_t>(std::clamp<uint64_t>(options.memoryBudget / (count + 1),
+                                                                     MIN_MERGE_BUFFER, MAX_MERGE_BUFFER));
+        std::vector<RunReader> readers(count);
+        std::vector<Record> heads(count);
+        std::vector<char> active(count);
+        auto advance = [&](size_t i) {
+            const char* line;
+            size_t length;
+            active[i] = readers[i].next(line, length);
+            if (active[i]) heads[i] = makeRecord(line, length);
+        };
+        for (size_t i = 0; i < count; ++i) {
+            readers[i].file = CreateFileW(runFiles[i].c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                          FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (readers[i].file == INVALID_HANDLE_VALUE) {
+                error = "Temporaere Datei '" + runFiles[i].u8string() + "' konnte nicht geoeffnet werden";
+                return false;
+            }
+            readers[i].buffer.reset(new char[bufferSize]);
+            readers[i].capacity = bufferSize;
+            advance(i);
+        }
+
+        // Exhausted runs lose against everything; ties go to the earlier run.
+        auto beats = [&](size_t a, size_t b) {
+            if (!active[a] || !active[b]) return active[a] > active[b];
+            int order = compare(heads[a], heads[b]);
+            return order != 0 ? order < 0 : a < b;
+        };
+        // Leaves are the nodes count..2*count-1 of an implicit binary tree; every inner
+        // node keeps the loser of its match and loser[0] the overall winner.
+        std::vector<size_t> loser(count);
+        {
+            std::vector<size_t> winner(2 * count);
+            for (size_t i = 0; i < count; ++i) winner[count + i] = i;
+            for (size_t node = count - 1; node > 0; --node) {
+                size_t a = winner[2 * node];
+                size_t b = winner[2 * node + 1];
+                if (!beats(a, b)) std::swap(a, b);
+                winner[node] = a;
+                loser[node] = b;
+            }
+            loser[0] = winner[1];
+        }
+
+        LineWriter writer(*this, sink);
+        uint64_t lines = 0;
+        auto reported = std::chrono::steady_clock::now();
+        while (active[loser[0]] && !cancelled) {
+            size_t winner = loser[0];
+            if (!writer.put(heads[winner])) {
+                error = "Ausgabe konnte nicht geschrieben werden";
+                return false;
+            }
+            bytesMerged += heads[winner].length + 1;
+            advance(winner);
+            for (size_t node = (winner + count) / 2; node > 0; node /= 2) {
+                if (beats(loser[node], winner)) std::swap(loser[node], winner);
+            }
+            loser[0] = winner;
+            if (++lines % REPORT_EVERY_LINES == 0 &&
+                std::chrono::steady_clock::now() - reported >= std::chrono::milliseconds(REPORT_INTERVAL_MS)) {
+                report();
+                reported = std::chrono::steady_clock::now();
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (readers[i].failed) {
+                error = "Temporaere Datei '" + runFiles[i].u8string() + "' konnte nicht gelesen werden";
+                return false;
+            }
+        }
+        if (!writer.flush()) {
+            error = "Ausgabe konnte nicht geschrieben werden";
+            return false;
+        }
+        return true;
+    }
+};
+
+// Arithmetic expressions compiled once into bytecode for a stack machine. Every
+// subexpression without variables is folded into a constant while parsing. The
+// machine runs one instruction at a time over a batch of rows, so each instruction is
+// a plain loop over arrays that the compiler can vectorize, and dispatch is paid per
+// batch instead of per row.
+class MathExpression {
+public:
+    // Values of one variable: one per row, or a single one shared by all rows.
+    struct Input {
+        const double* values = nullptr;
+        bool perRow = false;
+    };
+
+    // Compiled expressions by source text, least recently used evicted first.
+    class Cache {
+    public:
+        std::shared_ptr<const MathExpression> get(const std::string& source, std::string& error) {
+            if (auto it = entries.find(source); it != entries.end()) {
+                it->second.lastUsed = ++useCounter;
+                return it->second.expression;
+            }
+            auto compiled = compile(source, error);
+            if (!compiled) return nullptr;
+            entries[source] = Entry{compiled, ++useCounter};
+            evictIfNeeded();
+            return compiled;
+        }
+
+    private:
+        struct Entry {
+            std::shared_ptr<const MathExpression> expression;
+            uint64_t lastUsed;
+        };
+
+        static constexpr size_t MAX_EXPRESSIONS = 256;
+
+        std::map<std::string, Entry> entries;
+        uint64_t useCounter = 0;
+
+        void evictIfNeeded() {
+            if (entries.size() <= MAX_EXPRESSIONS) return;
+            auto oldest = std::min_element(entries.begin(), entries.end(),
+                [](const auto& a, const auto& b) { return a.second.lastUsed < b.second.lastUsed; });
+            entries.erase(oldest);
+        }
+    };
+
+    static constexpr size_t BATCH = 1024;
+
+    static std::shared_ptr<const MathExpression> compile(std::string_view source, std::string& error) {
+        auto expression = std::make_shared<MathExpression>();
+        Parser parser(source, *expression);
+        if (!parser.run(error)) return nullptr;
+        return expression;
+    }
+
+    // Variable names in slot order; evaluate() takes one Input per name.
+    const std::vector<std::string>& variables() const { return names; }
+
+    // Writes the value for each of `count` rows to `out`.
+    void evaluate(const Input* inputs, size_t count, double* out) const {
+        size_t width = std::min(BATCH, count);
+        std::vector<double> stack(depth * width);
+        auto slot = [&](size_t index) { return stack.data() + index * width; };
+        for (size_t begin = 0; begin < count; begin += width) {
+            size_t n = std::min(width, count - begin);
+            size_t top = 0;
+            for (const Instruction& instruction : code) {
+                switch (instruction.op) {
+                case Op::Constant:
+                    std::fill(slot(top), slot(top) + n, constants[instruction.operand]);
+                    ++top;
+                    break;
+                case Op::Variable: {
+                    const Input& input = inputs[instruction.operand];
+                    if (input.perRow) std::copy(input.values + begin, input.values + begin + n, slot(top));
+                    else std::fill(slot(top), slot(top) + n, *input.values);
+                    ++top;
+                    break;
+                }
+                case Op::Negate:
+                    unaryLoop(slot(top - 1), n, [](double a) { return -a; });
+                    break;
+                case Op::Call:
+                    if (FUNCTIONS[instruction.operand].arity == 1) {
+                        callLoop(static_cast<Function>(instruction.operand), slot(top - 1), n);
+                    } else {
+                        callLoop(static_cast<Function>(instruction.operand), slot(top - 2), slot(top - 1), n);
+                        --top;
+                    }
+                    break;
+                default:
+                    binaryLoop(instruction.op, slot(top - 2), slot(top - 1), n);
+                    --top;
+                    break;
+                }
+            }
+            std::copy(slot(0), slot(0) + n, out + begin);
+        }
+    }
+
+private:
+    enum class Op : uint8_t { Constant, Variable, Negate, Add, Subtract, Multiply, Divide, Modulo, Power, Call };
+
+    enum class Function : uint8_t {
+        Sin, Cos, Tan, Asin, Acos, Atan, Sqrt, Abs, Exp, Ln, Log10, Log2, Floor, Ceil, Round, Min, Max, Pow, Atan2
+    };
+
+    struct FunctionInfo {
+        const char* name;
+        int arity;
+    };
+
+    static constexpr FunctionInfo FUNCTIONS[] = {
+        {"sin", 1}, {"cos", 1}, {"tan", 1}, {"asin", 1}, {"acos", 1}, {"atan", 1}, {"sqrt", 1}, {"abs", 1},
+        {"exp", 1}, {"ln", 1}, {"log", 1}, {"log2", 1}, {"floor", 1}, {"ceil", 1}, {"round", 1},
+        {"min", 2}, {"max", 2}, {"pow", 2}, {"atan2", 2}
+    };
+
+    struct Instruction {
+        Op op;
+        uint32_t operand;
+    };
+
+    std::vector<Instruction> code;
+    std::vector<double> constants;
+    std::vector<std::string> names;
+    size_t depth = 0;
+
+    static double apply(Op op, double a, double b) {
+        switch (op) {
+        case Op::Add: return a + b;
+        case Op::Subtract: return a - b;
+        case Op::Multiply: return a * b;
+        case Op::Divide: return a / b;
+        case Op::Modulo: return std::fmod(a, b);
+        case Op::Power: return std::pow(a, b);
+        default: return -a;
+        }
+    }
+
+    static double call(Function function, double a, double b) {
+        switch (function) {
+        case Function::Sin: return std::sin(a);
+        case Function::Cos: return std::cos(a);
+        case Function::Tan: return std::tan(a);
+        case Function::Asin: return std::asin(a);
+        case Function::Acos: return std::acos(a);
+        case Function::Atan: return std::atan(a);
+        case Function::Sqrt: return std::sqrt(a);
+        case Function::Abs: return std::fabs(a);
+        case Function::Exp: return std::exp(a);
+        case Function::Ln: return std::log(a);
+        case Function::Log10: return std::log10(a);
+        case Function::Log2: return std::log2(a);
+        case Function::Floor: return std::floor(a);
+        case Function::Ceil: return std::ceil(a);
+        case Function::Round: return std::round(a);
+        case Function::Min: return std::min(a, b);
+        case Function::Max: return std::max(a, b);
+        case Function::Pow: return std::pow(a, b);
+        case Function::Atan2: return std::atan2(a, b);
+        }
+        return 0;
+    }
+
+    template<class F>
+    static void unaryLoop(double* a, size_t n, F f) {
+        for (size_t i = 0; i < n; ++i) a[i] = f(a[i]);
+    }
+
+    template<class F>
+    static void binaryLoop(double* a, const double* b, size_t n, F f) {
+        for (size_t i = 0; i < n; ++i) a[i] = f(a[i], b[i]);
+    }
+
+    // One loop per operator, so each body is a single arithmetic instruction.
+    static void binaryLoop(Op op, double* a, const double* b, size_t n) {
+        switch (op) {
+        case Op::Add: binaryLoop(a, b, n, [](double x, double y) { return x + y; }); break;
+        case Op::Subtract: binaryLoop(a, b, n, [](double x, double y) { return x - y; }); break;
+        case Op::Multiply: binaryLoop(a, b, n, [](double x, double y) { return x * y; }); break;
+        case Op::Divide: binaryLoop(a, b, n, [](double x, double y) { return x / y; }); break;
+        default: binaryLoop(a, b, n, [op](double x, double y) { return apply(op, x, y); }); break;
+        }
+    }
+
+    static void callLoop(Function function, double* a, size_t n) {
+        switch (function) {
+        case Function::Sqrt: unaryLoop(a, n, [](double x) { return std::sqrt(x); }); break;
+        case Function::Abs: unaryLoop(a, n, [](double x) { return std::fabs(x); }); break;
+        case Function::Floor: unaryLoop(a, n, [](double x) { return std::floor(x); }); break;
+        case Function::Ceil: unaryLoop(a, n, [](double x) { return std::ceil(x); }); break;
+        default: unaryLoop(a, n, [function](double x) { return call(function, x, 0); }); break;
+        }
+    }
+
+    static void callLoop(Function function, double* a, const double* b, size_t n) {
+        switch (function) {
+        case Function::Min: binaryLoop(a, b, n, [](double x, double y) { return y < x ? y : x; }); break;
+        case Function::Max: binaryLoop(a, b, n, [](double x, double y) { return x < y ? y : x; }); break;
+        default: binaryLoop(a, b, n, [function](double x, double y) { return call(function, x, y); }); break;
+        }
+    }
+
+    // Recursive descent over
+    //   sum     := product (('+' | '-') product)*
+    //   product := unary (('*' | '/' | '%') unary)*
+    //   unary   := ('-' | '+') unary | power
+    //   power   := primary ('^' unary)?
+    //   primary := number | name | name '(' sum (',' sum)* ')' | '(' sum ')'
+    // into a tree whose constant subtrees are folded as they are built.
+    class Parser {
+    public:
+        Parser(std::string_view text, MathExpression& target) : text(text), target(target) {}
+
+        bool run(std::string& message) {
+            int root = sum();
+            skipSpace();
+            if (!error.empty() || position < text.size()) {
+                message = error.empty() ? "Unerwartetes Zeichen '" + std::string(1, text[position]) +
+                                              "' an Position " + std::to_string(position + 1)
+                                        : error;
+                return false;
+            }
+            size_t height = 0;
+            emit(root, height);
+            return true;
+        }
+
+    private:
+        struct Node {
+            Op op;
+            double value;
+            uint32_t operand;
+            int left;
+            int right;
+        };
+
+        std::string_view text;
+        MathExpression& target;
+        std::vector<Node> nodes;
+        size_t position = 0;
+        std::string error;
+
+        void skipSpace() {
+            while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) ++position;
+        }
+
+        bool accept(char c) {
+            skipSpace();
+            if (position < text.size() && text[position] == c) {
+                ++position;
+                return true;
+            }
+            return false;
+        }
+
+        int fail(const std::string& message) {
+            if (error.empty()) error = message;
+            return -1;
+        }
+
+        bool isConstant(int node) const { return node >= 0 && nodes[node].op == Op::Constant; }
+
+        int add(Node node) {
+            nodes.push_back(node);
+            return static_cast<int>(nodes.size() - 1);
+        }
+
+        int constant(double value) { return add(Node{Op::Constant, value, 0, -1, -1}); }
+
+        int binary(Op op, int left, int right) {
+            if (left < 0 || right < 0) return -1;
+            if (isConstant(left) && isConstant(right)) return constant(apply(op, nodes[left].value, nodes[right].value));
+            return add(Node{op, 0, 0, left, right});
+        }
+
+        int sum() {
+            int left = product();
+            while (error.empty()) {
+                if (accept('+')) left = binary(Op::Add, left, product());
+                else if (accept('-')) left = binary(Op::Subtract, left, product());
+                else break;
+            }
+            return left;
+        }
+
+        int product() {
+            int left = unary();
+            while (error.empty()) {
+                if (accept('*')) left = binary(Op::Multiply, left, unary());
+                else if (accept('/')) left = binary(Op::Divide, left, unary());
+                else if (accept('%')) left = binary(Op::Modulo, left, unary());
+                else break;
             }
+            return left;
+        }
 
-            if (tokens.empty()) continue;
+        int unary() {
+            if (accept('-')) {
+                int operand = unary();
+                if (operand < 0) return -1;
+                if (isConstant(operand)) return constant(-nodes[operand].value);
+                return add(Node{Op::Negate, 0, 0, operand, -1});
+            }
+            if (accept('+')) return unary();
+            return power();
+        }
 
-            if (tokens[0] == "quit") break;
+        int power() {
+            int base = primary();
+            if (error.empty() && accept('^')) return binary(Op::Power, base, unary());
+            return base;
+        }
 
-            if (tokens[0] == "add") {
-                std::cout << "Neue Zeile: ";
-                std::string newLine;
-                std::getline(std::cin, newLine);
-                editor.addLine(newLine);
-            } else if (tokens[0] == "edit" && tokens.size() > 1) {
-                size_t lineNumber = std::stoul(tokens[1]);
-                std::cout << "Neue Inhalte: ";
-                std::string newContent;
-                std::getline(std::cin, newContent);
-                editor.editLine(lineNumber, newContent);
-            } else if (tokens[0] == "delete" && tokens.size() > 1) {
-                size_t lineNumber = std::stoul(tokens[1]);
-                editor.deleteLine(lineNumber);
-            } else if (tokens[0] == "save") {
-                editor.save();
-                std::cout << "Datei gespeichert.\n";
+        int primary() {
+            skipSpace();
+            if (position >= text.size()) return fail("Unerwartetes Ende des Ausdrucks");
+            char c = text[position];
+            if (accept('(')) {
+                int inner = sum();
+                if (error.empty() && !accept(')')) return fail("Fehlende schliessende Klammer");
+                return inner;
+            }
+            if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+                double value = 0;
+                auto [end, ec] = std::from_chars(text.data() + position, text.data() + text.size(), value);
+                if (ec != std::errc()) return fail("Ungueltige Zahl an Position " + std::to_string(position + 1));
+                position = static_cast<size_t>(end - text.data());
+                return constant(value);
+            }
+            if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                size_t start = position;
+                while (position < text.size() && (std::isalnum(static_cast<unsigned char>(text[position])) || text[position] == '_')) {
+                    ++position;
+                }
+                std::string name(text.substr(start, position - start));
+                if (accept('(')) return call(name);
+                if (name == "pi") return constant(3.14159265358979323846);
+                if (name == "e") return constant(2.71828182845904523536);
+                return variable(name);
             }
+            return fail("Unerwartetes Zeichen '" + std::string(1, c) + "' an Position " + std::to_string(position + 1));
         }
-        return CommandResult(CommandResult::Status::Success, "File edited successfully");
-    }
 
-    std::string getHelp() const override { return "Oeffnet einen einfachen Texteditor"; }
-    std::string getUsage() const override { return "edit <dateiname>"; }
-    bool validateArgs(const std::vector<std::string>& args) const override {
-        return !args.empty() && args.size() == 1;
-    }
-};
+        int variable(const std::string& name) {
+            auto& names = target.names;
+            auto it = std::find(names.begin(), names.end(), name);
+            if (it == names.end()) it = names.insert(names.end(), name);
+            return add(Node{Op::Variable, 0, static_cast<uint32_t>(it - names.begin()), -1, -1});
+        }
 
-class ProcessManager {
-public:
-    static void listProcesses() {
-        system("tasklist");
-    }
+        int call(const std::string& name) {
+            auto info = std::find_if(std::begin(FUNCTIONS), std::end(FUNCTIONS),
+                                     [&](const FunctionInfo& f) { return name == f.name; });
+            if (info == std::end(FUNCTIONS)) return fail("Unbekannte Funktion: " + name);
+            std::vector<int> arguments{sum()};
+            while (error.empty() && accept(',')) arguments.push_back(sum());
+            if (error.empty() && !accept(')')) return fail("Fehlende schliessende Klammer nach " + name);
+            if (!error.empty()) return -1;
+            if (static_cast<int>(arguments.size()) != info->arity) {
+                return fail("Funktion " + name + " erwartet " + std::to_string(info->arity) + " Argument(e)");
+            }
+            auto function = static_cast<uint32_t>(info - std::begin(FUNCTIONS));
+            int left = arguments[0];
+            int right = info->arity == 2 ? arguments[1] : -1;
+            if (isConstant(left) && (right < 0 || isConstant(right))) {
+                return constant(MathExpression::call(static_cast<Function>(function), nodes[left].value,
+                                                     right < 0 ? 0 : nodes[right].value));
+            }
+            return add(Node{Op::Call, 0, function, left, right});
+        }
 
-    static void killProcess(const std::string& pid) {
-        system(("taskkill /PID " + pid + " /F").c_str());
-    }
+        // Post-order, so operands are on the stack when their operator runs.
+        void emit(int index, size_t& height) {
+            const Node& node = nodes[index];
+            if (node.left >= 0) emit(node.left, height);
+            if (node.right >= 0) emit(node.right, height);
+            uint32_t operand = node.operand;
+            if (node.op == Op::Constant) {
+                operand = static_cast<uint32_t>(target.constants.size());
+                target.constants.push_back(node.value);
+            }
+            target.code.push_back(Instruction{node.op, operand});
+            if (node.op == Op::Constant || node.op == Op::Variable) {
+                target.depth = std::max(target.depth, ++height);
+            } else if (node.right >= 0) {
+                --height;
+            }
+        }
+    };
 };
 
-class PerformanceMetrics {
-private:
-    static inline std::map<std::string, std::chrono::microseconds> metrics;
-    static inline std::mutex metricsMutex;
-
+// xoshiro256++ (Blackman and Vigna): 256 bits of state and a few cycles per 64-bit
+// output. jump() advances the state by 2^128 outputs, so streams split off one seed
+// by jumping never overlap in practice.
+class Xoshiro256 {
 public:
-    static void record(const std::string& operation, std::chrono::microseconds duration) {
-        std::lock_guard<std::mutex> lock(metricsMutex);
-        metrics[operation] += duration;
-    }
-
-    static void displayMetrics() {
-        std::lock_guard<std::mutex> lock(metricsMutex);
-        for (const auto& [op, duration] : metrics) {
-            std::cout << op << ": " << duration.count() / 1000.0 << "ms\n";
+    // SplitMix64 spreads the seed over the state, as recommended by the authors.
+    explicit Xoshiro256(uint64_t seed) {
+        for (auto& word : state) {
+            seed += 0x9e3779b97f4a7c15;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            word = z ^ (z >> 31);
         }
     }
-};
-
-class ThreadPool {
-private:
-    std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
-    std::mutex queue_mutex;
-    std::condition_variable condition;
-    bool stop;
 
-public:
-    ThreadPool(size_t threads) : stop(false) {
-        for(size_t i = 0; i < threads; ++i)
-            workers.emplace_back([this] {
-                while(true) {
-                    std::function<void()> task;
-                    {
-                        std::unique_lock<std::mutex> lock(queue_mutex);
-                        condition.wait(lock, [this] { 
-                            return stop || !tasks.empty(); 
-                        });
-                        if(stop && tasks.empty())
-                            return;
-                        task = std::move(tasks.front());
-                        tasks.pop();
-                    }
-                    task();
-                }
-            });
+    uint64_t next() {
+        uint64_t result = rotl(state[0] + state[3], 23) + state[0];
+        uint64_t shifted = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= shifted;
+        state[3] = rotl(state[3], 45);
+        return result;
     }
 
-    template<class F>
-    void enqueue(F&& f) {
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            tasks.emplace(std::forward<F>(f));
+    // Uniform in [0, range) without modulo bias (Lemire's multiply-shift, which
+    // almost never divides); a range of 0 stands for 2^64.
+    uint64_t below(uint64_t range) {
+        if (range == 0) return next();
+        uint64_t high;
+        uint64_t low = multiply(next(), range, high);
+        if (low < range) {
+            uint64_t threshold = (0 - range) % range;
+            while (low < threshold) low = multiply(next(), range, high);
         }
-        condition.notify_one();
+        return high;
     }
 
-    ~ThreadPool() {
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            stop = true;
+    void fill(char* out, size_t size) {
+        for (; size >= 8; out += 8, size -= 8) {
+            uint64_t value = next();
+            std::memcpy(out, &value, 8);
+        }
+        if (size > 0) {
+            uint64_t value = next();
+            std::memcpy(out, &value, size);
         }
-        condition.notify_all();
-        for(std::thread &worker: workers)
-            worker.join();
     }
-};
-
-class ConcreteCommand : public Command {
-private:
-    std::function<void(const std::vector<std::string>&)> executeFunc;
-    std::string helpText;
-    std::string usageText;
-
-public:
-    ConcreteCommand(
-        std::function<void(const std::vector<std::string>&)> exec,
-        std::string help,
-        std::string usage
-    ) : executeFunc(std::move(exec)),
-        helpText(std::move(help)),
-        usageText(std::move(usage)) {}
 
-    CommandResult execute(const std::vector<std::string>& args) override {
-        executeFunc(args);
-        return CommandResult(CommandResult::Status::Success, "Command executed");
+    void jump() {
+        static constexpr uint64_t JUMP[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+        uint64_t jumped[4] = {};
+        for (uint64_t word : JUMP) {
+            for (int bit = 0; bit < 64; ++bit) {
+                if (word & (uint64_t(1) << bit)) {
+                    for (int i = 0; i < 4; ++i) jumped[i] ^= state[i];
+                }
+                next();
+            }
+        }
+        std::memcpy(state, jumped, sizeof(state));
     }
 
-    std::string getHelp() const override {
-        return helpText;
-    }
+private:
+    uint64_t state[4];
 
-    std::string getUsage() const override {
-        return usageText;
+    static uint64_t rotl(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
     }
 
-    bool validateArgs(const std::vector<std::string>& args) const override {
-        return true;
+    static uint64_t multiply(uint64_t a, uint64_t b, uint64_t& high) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        return _umul128(a, b, &high);
+#else
+        unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        high = static_cast<uint64_t>(product >> 64);
+        return static_cast<uint64_t>(product);
+#endif
     }
 };
 
@@ -409,7 +7198,8 @@ class TerminalUI {
 private:
     const int WINDOW_WIDTH = 120;
     const int WINDOW_HEIGHT = 30;
-    
+    static constexpr int HEADER_ROWS = 5;
+
     struct Theme {
         int backgroundColor;
         int textColor;
@@ -438,10 +7228,30 @@ private:
         "│"     
     };
 
+    FrameRenderer headerRenderer{WINDOW_WIDTH, HEADER_ROWS, FrameRenderer::Anchor::Screen};
+    FrameRenderer promptRenderer{WINDOW_WIDTH - 1, 1, FrameRenderer::Anchor::CurrentLine};
+    std::vector<std::pair<std::string, WORD>> promptSegments;
+    GitStatusCache gitStatus;
+    const SystemStatsSampler* statsSampler = nullptr;
+
 public:
+    void attachThreadPool(ThreadPool& pool) {
+        gitStatus.attachThreadPool(pool);
+    }
+
+    void attachStatsSampler(const SystemStatsSampler& sampler) {
+        statsSampler = &sampler;
+    }
+
     void initializeWindow() {
         SetConsoleOutputCP(CP_UTF8);
         SetConsoleCP(CP_UTF8);
+
+        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD mode = 0;
+        if (GetConsoleMode(hConsole, &mode)) {
+            SetConsoleMode(hConsole, mode | ENABLE_PROCESSED_OUTPUT | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+        }
         
         std::string cmd = "mode con: cols=" + std::to_string(WINDOW_WIDTH) + 
                          " lines=" + std::to_string(WINDOW_HEIGHT);
@@ -452,44 +7262,127 @@ public:
     }
 
     void drawHeader() {
-        ConsoleColor::set(currentTheme.headerColor, currentTheme.backgroundColor);
-        
-        
-        std::cout << "╔" << std::string(WINDOW_WIDTH - 2, currentTheme.headerBorder[0]) << "╗\n";
-        
-        
-        std::string title = " AETHER TERMINAL ";
-        std::string subtitle = " Modern Command Line Interface ";
-        
-        drawCenteredText(title, true);
-        drawCenteredText(subtitle, false);
+        ScreenBuffer& frame = headerRenderer.frame();
+        WORD border = attr(currentTheme.headerColor);
+        frame.clear(attr(currentTheme.textColor));
+
+        char32_t borderGlyph = U'═';
+        if (!currentTheme.headerBorder.empty()) {
+            size_t pos = 0;
+            borderGlyph = ScreenBuffer::decodeUtf8(currentTheme.headerBorder, pos);
+        }
         
+        frame.put(0, 0, "╔", border);
+        frame.fill(0, 1, WINDOW_WIDTH - 2, borderGlyph, border);
+        frame.put(0, WINDOW_WIDTH - 1, "╗", border);
         
-        std::cout << "╚" << std::string(WINDOW_WIDTH - 2, currentTheme.headerBorder[0]) << "╝\n";
+        drawCenteredText(frame, 1, " AETHER TERMINAL ", true);
+        drawCenteredText(frame, 2, " Modern Command Line Interface ", false);
         
+        frame.put(3, 0, "╚", border);
+        frame.fill(3, 1, WINDOW_WIDTH - 2, borderGlyph, border);
+        frame.put(3, WINDOW_WIDTH - 1, "╝", border);
         
-        drawStatusBar();
+        drawStatusBar(frame, 4);
         
-        resetColors();
+        headerRenderer.present(HEADER_ROWS, 0, attr(currentTheme.textColor));
     }
 
     void drawPrompt(const std::string& currentDir) {
+        promptSegments.clear();
+        promptSegments.emplace_back(currentTheme.promptSymbol + " ", attr(currentTheme.promptColor));
+        promptSegments.emplace_back(shortenPath(currentDir), attr(currentTheme.highlightColor));
         
-        ConsoleColor::set(currentTheme.promptColor, currentTheme.backgroundColor);
-        std::cout << "\n" << currentTheme.promptSymbol << " ";
-        
-        ConsoleColor::set(currentTheme.highlightColor, currentTheme.backgroundColor);
-        std::cout << shortenPath(currentDir);
-        
-        
-        std::string gitBranch = getGitBranch();
+        std::string gitBranch = getGitBranch(currentDir);
         if (!gitBranch.empty()) {
-            ConsoleColor::set(currentTheme.successColor, currentTheme.backgroundColor);
-            std::cout << " [" << gitBranch << "]";
+            promptSegments.emplace_back(" [" + gitBranch + "]", attr(currentTheme.successColor));
         }
         
-        ConsoleColor::set(currentTheme.textColor, currentTheme.backgroundColor);
-        std::cout << " → ";
+        promptSegments.emplace_back(" → ", attr(currentTheme.textColor));
+
+        std::cout << "\n";
+        promptRenderer.assumeBlank(attr(currentTheme.textColor));
+        updatePromptInput("", 0);
+    }
+
+    // Re-renders the prompt line; only cells that changed since the last call are written.
+    void updatePromptInput(const std::string& input, size_t cursorPos) {
+        ScreenBuffer& frame = promptRenderer.frame();
+        WORD textAttr = attr(currentTheme.textColor);
+        frame.clear(textAttr);
+
+        int col = 0;
+        for (const auto& [text, segmentAttr] : promptSegments) {
+            col = frame.put(0, col, text, segmentAttr);
+        }
+
+        size_t available = static_cast<size_t>(std::max(frame.getWidth() - col - 1, 1));
+        size_t firstVisible = cursorPos > available ? cursorPos - available : 0;
+        int inputStart = col;
+        for (size_t i = firstVisible; i < input.size() && col < frame.getWidth(); ++i) {
+            frame.fill(0, col++, 1, static_cast<unsigned char>(input[i]), textAttr);
+        }
+
+        int cursorCol = std::min(inputStart + static_cast<int>(cursorPos - firstVisible), frame.getWidth() - 1);
+        promptRenderer.present(0, cursorCol, textAttr);
+    }
+
+    int getWidth() const {
+        return WINDOW_WIDTH;
+    }
+
+    void showPager(const ScrollbackBuffer& buffer, const std::string& title) {
+        WORD statusAttr = static_cast<WORD>((currentTheme.textColor << 4) | currentTheme.backgroundColor);
+        Pager pager(WINDOW_WIDTH, WINDOW_HEIGHT, attr(currentTheme.textColor), statusAttr);
+        pager.run(buffer, title);
+    }
+
+    bool showProcesses(ProcessTable& table, ProcessTable::SortKey sortKey, std::chrono::milliseconds interval) {
+        WORD headerAttr = static_cast<WORD>((currentTheme.textColor << 4) | currentTheme.backgroundColor);
+        ProcessView view(WINDOW_WIDTH, WINDOW_HEIGHT, attr(currentTheme.textColor), headerAttr);
+        return view.run(table, sortKey, interval);
+    }
+
+    void drawCompletions(const std::vector<std::string>& completions, size_t total) {
+        std::ostringstream out;
+        out << "\n";
+        size_t maxLength = 0;
+        for (const auto& c : completions) {
+            maxLength = std::max(maxLength, c.length());
+        }
+
+        size_t columns = std::max(size_t{1}, static_cast<size_t>(WINDOW_WIDTH) / (maxLength + 2));
+        size_t col = 0;
+
+        for (const auto& completion : completions) {
+            out << std::left << std::setw(maxLength + 2) << completion;
+            if (++col >= columns) {
+                out << "\n";
+                col = 0;
+            }
+        }
+        if (col != 0) out << "\n";
+        if (total > completions.size()) {
+            out << "... " << total - completions.size() << " weitere\n";
+        }
+        std::cout << out.str();
+    }
+
+    // Completes the token before the cursor in place. Several candidates are listed
+    // and the prompt is drawn again below them.
+    void completeInput(TabCompleter& completer, std::string& input, size_t& cursorPos) {
+        auto completion = completer.complete(input, cursorPos);
+        if (completion.totalCandidates == 0) return;
+
+        if (completion.replacement.size() >= cursorPos - completion.replaceFrom) {
+            input = input.substr(0, completion.replaceFrom) + completion.replacement + input.substr(cursorPos);
+            cursorPos = completion.replaceFrom + completion.replacement.size();
+        }
+        if (completion.totalCandidates > 1) {
+            drawCompletions(completion.candidates, completion.totalCandidates);
+            drawPrompt(fs::current_path().string());
+        }
+        updatePromptInput(input, cursorPos);
     }
 
     void drawError(const std::string& message) {
@@ -515,17 +7408,20 @@ public:
 
     void clearScreen() {
         system("cls");
+        headerRenderer.invalidate();
     }
 
 private:
-    void drawStatusBar() {
-        ConsoleColor::set(currentTheme.promptColor, currentTheme.backgroundColor);
-        
-        
-        MEMORYSTATUSEX memInfo;
-        memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-        GlobalMemoryStatusEx(&memInfo);
-        int memoryUsage = static_cast<int>(memInfo.dwMemoryLoad);
+    WORD attr(int textColor) const {
+        return static_cast<WORD>((currentTheme.backgroundColor << 4) | textColor);
+    }
+
+    // The header is drawn once at startup and scrolls away with the output, so it
+    // shows only what a single sample gets right; the CPU load needs two samples
+    // and is left to sysinfo and top.
+    void drawStatusBar(ScreenBuffer& frame, int row) {
+        SystemSnapshot stats = statsSampler ? statsSampler->snapshot() : SystemSnapshot{};
+        int memoryUsage = stats.memoryLoad;
         
         
         auto now = std::chrono::system_clock::now();
@@ -535,25 +7431,21 @@ private:
         
         
         std::string status = " RAM: " + std::to_string(memoryUsage) + "% | " + ss.str();
-        std::cout << std::string(WINDOW_WIDTH - status.length() - 1, ' ') << status << "\n";
+        frame.put(row, WINDOW_WIDTH - static_cast<int>(status.length()) - 1, status, attr(currentTheme.promptColor));
     }
 
-    std::string getGitBranch() {
-        return "";
+    std::string getGitBranch(const std::string& currentDir) {
+        return gitStatus.describe(fs::path(currentDir));
     }
 
-    void drawCenteredText(const std::string& text, bool isTitle) {
-        int padding = (WINDOW_WIDTH - 2 - text.length()) / 2;
-        std::cout << currentTheme.separator;
-        
-        if (isTitle) {
-            ConsoleColor::set(currentTheme.highlightColor, currentTheme.backgroundColor);
-        }
-        
-        std::cout << std::string(padding, ' ') << text 
-                 << std::string(WINDOW_WIDTH - 2 - padding - text.length(), ' ');
-        
-        std::cout << currentTheme.separator << "\n";
+    void drawCenteredText(ScreenBuffer& frame, int row, const std::string& text, bool isTitle) {
+        int length = static_cast<int>(ScreenBuffer::columnCount(text));
+        int padding = (WINDOW_WIDTH - 2 - length) / 2;
+        WORD border = attr(currentTheme.headerColor);
+
+        frame.put(row, 0, currentTheme.separator, border);
+        frame.put(row, 1 + padding, text, isTitle ? attr(currentTheme.highlightColor) : border);
+        frame.put(row, WINDOW_WIDTH - 1, currentTheme.separator, border);
     }
 
     std::string shortenPath(const std::string& path) {
@@ -593,9 +7485,35 @@ private:
                 cmd = aliases[cmd];
             }
 
+            bool paged = false;
+            if (args.size() >= 2 && args[args.size() - 2] == "|" &&
+                (args.back() == "less" || args.back() == "more")) {
+                paged = true;
+                args.resize(args.size() - 2);
+            }
+
             if (auto it = commands.find(cmd); it != commands.end()) {
                 if (it->second->validateArgs(args)) {
-                    it->second->execute(args);
+                    if (paged) {
+                        // writeOutput falls back to std::cout while it is redirected, so
+                        // only full-screen views still reach the console directly.
+                        scrollback.clear();
+                        ScrollbackStreamBuf capture(scrollback);
+                        std::streambuf* previous = std::cout.rdbuf(&capture);
+                        std::streambuf* previousErrors = std::cerr.rdbuf(&capture);
+                        try {
+                            it->second->execute(args);
+                        } catch (...) {
+                            std::cout.rdbuf(previous);
+                            std::cerr.rdbuf(previousErrors);
+                            throw;
+                        }
+                        std::cout.rdbuf(previous);
+                        std::cerr.rdbuf(previousErrors);
+                        ui.showPager(scrollback, cmd);
+                    } else {
+                        it->second->execute(args);
+                    }
                     
                     auto end = std::chrono::high_resolution_clock::now();
                     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
@@ -632,6 +7550,21 @@ private:
     std::map<std::string, int> currentTheme{defaultTheme};
     std::vector<std::string> commandHistory;
     std::map<std::string, std::string> aliases;
+    std::map<std::string, std::string> settings;
+    SystemStatsSampler statsSampler;
+    TabCompleter completer;
+    ScrollbackBuffer scrollback;
+    std::streambuf* consoleOutput = std::cout.rdbuf();
+    static constexpr size_t OUTPUT_SLICE = 4 * 1024 * 1024;
+    static constexpr size_t PARALLEL_SORT_THRESHOLD = 100000;
+    static constexpr uint64_t RANDOM_NUMBER_BLOCK = 64 * 1024;
+    static constexpr uint64_t RANDOM_BYTE_BLOCK = 4 * 1024 * 1024;
+    static constexpr size_t RANDOM_ROUND = 8;
+    static constexpr size_t COLUMN_GAP = 2;
+    static constexpr int WATCH_DEBOUNCE_MS = 200;
+    static constexpr int WATCH_MAX_DELAY_FACTOR = 10;
+    MathExpression::Cache mathCache;
+    std::map<std::string, double> mathVariables;
     std::unique_ptr<TaskManager> taskManager;
     std::thread taskThread;
     int historyIndex{-1};
@@ -639,6 +7572,9 @@ private:
     std::atomic<bool> isRunning{true};
     std::vector<std::thread> workerThreads;
     ThreadPool threadPool{4};
+    AsyncFileIO fileIO{threadPool};
+    DiskUsageScanner::Cache diskUsageCache;
+    DuplicateFinder::Cache duplicateCache;
 
     std::vector<std::string> parseCommand(const std::string& commandLine) {
         std::vector<std::string> args;
@@ -707,7 +7643,7 @@ private:
         commands["readfile"] = std::make_unique<ConcreteCommand>(
             [this](const auto& args) { readFromFile(args); },
             "Liest den Inhalt einer Datei",
-            "readfile <dateiname>"
+            "readfile <dateiname> [--head N | --tail N] [--follow] [--page]"
         );
 
         commands["create"] = std::make_unique<ConcreteCommand>(
@@ -718,14 +7654,26 @@ private:
 
         commands["delete"] = std::make_unique<ConcreteCommand>(
             [this](const auto& args) { deleteFile(args); },
-            "Löscht eine Datei",
-            "delete <dateiname>"
+            "Löscht eine Datei oder mit -r einen Verzeichnisbaum",
+            "delete <pfad> [-r] [--dry-run]"
+        );
+
+        commands["copy"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { transferFiles(args, false); },
+            "Kopiert Dateien und Verzeichnisse",
+            "copy <quelle> <ziel> [--force]"
+        );
+
+        commands["move"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { transferFiles(args, true); },
+            "Verschiebt Dateien und Verzeichnisse",
+            "move <quelle> <ziel> [--force]"
         );
 
         commands["list"] = std::make_unique<ConcreteCommand>(
-            [this](const auto& args) { listFiles(); },
-            "Listet Dateien im aktuellen Verzeichnis auf",
-            "list"
+            [this](const auto& args) { listFiles(args); },
+            "Listet Dateien eines Verzeichnisses auf",
+            "list [pfad] [-l] [-a] [--sort name|size|time|none] [-r]"
         );
 
         commands["encrypt"] = std::make_unique<ConcreteCommand>(
@@ -759,15 +7707,19 @@ private:
         );
 
         commands["ps"] = std::make_unique<ConcreteCommand>(
-            [](const auto&) { ProcessManager::listProcesses(); },
+            [this](const auto& args) { listProcesses(args); },
             "Zeigt laufende Prozesse an",
-            "ps"
+            "ps [--sort pid|name|cpu|mem] [--filter text]"
+        );
+
+        commands["top"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { showTop(args); },
+            "Zeigt laufend aktualisierte Prozesse mit CPU-Auslastung an",
+            "top [--sort cpu|mem|pid|name] [--interval ms]"
         );
 
         commands["kill"] = std::make_unique<ConcreteCommand>(
-            [](const auto& args) { 
-                if (!args.empty()) ProcessManager::killProcess(args[0]); 
-            },
+            [this](const auto& args) { killProcess(args); },
             "Beendet einen Prozess",
             "kill <pid>"
         );
@@ -784,6 +7736,66 @@ private:
             "stats"
         );
 
+        commands["hash"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { hashString(args); },
+            "Berechnet Pruefsummen von Text oder Dateien",
+            "hash <text> | hash --file <pfad> [--algo xxh3|sha256|blake3]"
+        );
+
+        commands["base64"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { base64Operation(args); },
+            "Kodiert oder dekodiert Text oder Dateien in Base64",
+            "base64 <encode|decode> <text> | base64 <encode|decode> --file <eingabedatei> <ausgabedatei>"
+        );
+
+        commands["math"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { performMathOperation(args); },
+            "Berechnet mathematische Ausdruecke",
+            "math <ausdruck> | math <name> = <ausdruck> | math --over <datei> <ausdruck> [--col N] [--sep c]"
+        );
+
+        commands["du"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { showDiskUsage(args); },
+            "Zeigt die Speicherbelegung eines Verzeichnisbaums an",
+            "du [pfad] [--depth N] [--top K] [--refresh]"
+        );
+
+        commands["dupes"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { findDuplicates(args); },
+            "Findet Dateien mit identischem Inhalt",
+            "dupes [pfad] [--min-size N] [--link hard|clone] [--refresh]"
+        );
+
+        commands["sort"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { sortItems(args); },
+            "Sortiert Elemente oder die Zeilen einer Datei",
+            "sort [-n] [-u] <element>... | sort --file <datei> [--out datei] [-k spalte] [-n] [-u] [--memory MB] [--temp verzeichnis]"
+        );
+
+        commands["random"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { generateRandom(args); },
+            "Erzeugt Zufallszahlen oder Zufallsdaten",
+            "random [--count N] [--range a b] [--seed s] [--out datei] | random --bytes N --out datei [--seed s]"
+        );
+
+        commands["agg"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { aggregateColumn(args); },
+            "Aggregiert eine Spalte einer CSV-/TSV-Datei",
+            "agg <datei> <spalte> [--group-by spalte] [--sep c]"
+        );
+
+        commands["watch"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { watchPath(args); },
+            "Fuehrt einen Befehl aus, sobald sich Dateien aendern",
+            "watch <pfad> [--recursive] [--debounce ms] -- <befehl>"
+        );
+
+        commands["sysinfo"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { showSystemInfo(args); },
+            "Zeigt Systeminformationen an",
+            "sysinfo [--interval <ms>]"
+        );
+
         commands["edit"] = std::make_unique<EditCommand>(*this);
     }
 
@@ -805,6 +7817,15 @@ public:
     }
 
     void run() {
+        loadSettings();
+        statsSampler.setInterval(std::chrono::milliseconds(settingAsInt("sysinfo.interval_ms", 1000)));
+        statsSampler.start();
+        scrollback.setCapacity(static_cast<size_t>(settingAsInt("scrollback.max_mb", 64)) * 1024 * 1024);
+        ConsoleInterrupt::install();
+
+        ui.attachThreadPool(threadPool);
+        ui.attachStatsSampler(statsSampler);
+        completer.attachThreadPool(threadPool);
         ui.initializeWindow();
         ui.drawHeader();
         printWelcomeMessage();
@@ -813,6 +7834,7 @@ public:
         loadAliases();
         loadThemes();
         registerCommands();
+        completer.rebuild(commands, aliases);
 
         std::string command;
         while (true) {
@@ -843,7 +7865,8 @@ public:
 
         while (true) {
             editor.display();
-            std::cout << "\nEditor-Befehle: add, edit <zeilennummer>, delete <zeilennummer>, save, quit\n";
+            std::cout << "\nEditor-Befehle: add, edit <zeilennummer>, delete <zeilennummer>, goto <zeilennummer>,\n"
+                      << "                find <text>, next, replace <alt> [neu] [all], undo, redo, save, quit\n";
             std::cout << "Befehl: ";
             std::getline(std::cin, command);
 
@@ -870,9 +7893,21 @@ public:
             } else if (tokens[0] == "delete" && tokens.size() > 1) {
                 size_t lineNumber = std::stoul(tokens[1]);
                 editor.deleteLine(lineNumber);
+            } else if (tokens[0] == "goto" && tokens.size() > 1) {
+                editor.scrollTo(std::stoul(tokens[1]));
+            } else if (tokens[0] == "find" && tokens.size() > 1) {
+                editor.find(SimpleTextEditor::argumentsOf(command));
+            } else if (tokens[0] == "next") {
+                editor.findNext();
+            } else if (tokens[0] == "undo") {
+                editor.undo();
+            } else if (tokens[0] == "redo") {
+                editor.redo();
+            } else if (tokens[0] == "replace" && tokens.size() > 1) {
+                editor.replace(SimpleTextEditor::argumentsOf(command));
             } else if (tokens[0] == "save") {
-                editor.save();
-                std::cout << "Datei gespeichert.\n";
+                if (editor.save()) std::cout << "Datei gespeichert.\n";
+                else std::cerr << "Fehler: Datei konnte nicht gespeichert werden.\n";
             } else if (tokens[0] == "quit") {
                 break;
             } else {
@@ -921,7 +7956,7 @@ private:
         commands["readfile"] = std::make_unique<ConcreteCommand>(
             [this](const auto& args) { readFromFile(args); },
             "Liest den Inhalt einer Datei",
-            "readfile <dateiname>"
+            "readfile <dateiname> [--head N | --tail N] [--follow] [--page]"
         );
 
         commands["create"] = std::make_unique<ConcreteCommand>(
@@ -932,14 +7967,26 @@ private:
 
         commands["delete"] = std::make_unique<ConcreteCommand>(
             [this](const auto& args) { deleteFile(args); },
-            "Löscht eine Datei",
-            "delete <dateiname>"
+            "Löscht eine Datei oder mit -r einen Verzeichnisbaum",
+            "delete <pfad> [-r] [--dry-run]"
+        );
+
+        commands["copy"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { transferFiles(args, false); },
+            "Kopiert Dateien und Verzeichnisse",
+            "copy <quelle> <ziel> [--force]"
+        );
+
+        commands["move"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { transferFiles(args, true); },
+            "Verschiebt Dateien und Verzeichnisse",
+            "move <quelle> <ziel> [--force]"
         );
 
         commands["list"] = std::make_unique<ConcreteCommand>(
-            [this](const auto& args) { listFiles(); },
-            "Listet Dateien im aktuellen Verzeichnis auf",
-            "list"
+            [this](const auto& args) { listFiles(args); },
+            "Listet Dateien eines Verzeichnisses auf",
+            "list [pfad] [-l] [-a] [--sort name|size|time|none] [-r]"
         );
 
         commands["encrypt"] = std::make_unique<ConcreteCommand>(
@@ -973,29 +8020,93 @@ private:
         );
 
         commands["ps"] = std::make_unique<ConcreteCommand>(
-            [](const auto&) { ProcessManager::listProcesses(); },
+            [this](const auto& args) { listProcesses(args); },
             "Zeigt laufende Prozesse an",
-            "ps"
+            "ps [--sort pid|name|cpu|mem] [--filter text]"
+        );
+
+        commands["top"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { showTop(args); },
+            "Zeigt laufend aktualisierte Prozesse mit CPU-Auslastung an",
+            "top [--sort cpu|mem|pid|name] [--interval ms]"
         );
 
         commands["kill"] = std::make_unique<ConcreteCommand>(
-            [](const auto& args) { 
-                if (!args.empty()) ProcessManager::killProcess(args[0]); 
-            },
+            [this](const auto& args) { killProcess(args); },
             "Beendet einen Prozess",
             "kill <pid>"
         );
 
-        commands["benchmark"] = std::make_unique<ConcreteCommand>(
-            [this](const auto&) { runBenchmark(); },
-            "Führt einen Systemtest durch",
-            "benchmark"
+        commands["benchmark"] = std::make_unique<ConcreteCommand>(
+            [this](const auto&) { runBenchmark(); },
+            "Führt einen Systemtest durch",
+            "benchmark"
+        );
+
+        commands["stats"] = std::make_unique<ConcreteCommand>(
+            [](const auto&) { PerformanceMetrics::displayMetrics(); },
+            "Zeigt Leistungsmetriken an",
+            "stats"
+        );
+
+        commands["hash"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { hashString(args); },
+            "Berechnet Pruefsummen von Text oder Dateien",
+            "hash <text> | hash --file <pfad> [--algo xxh3|sha256|blake3]"
+        );
+
+        commands["base64"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { base64Operation(args); },
+            "Kodiert oder dekodiert Text oder Dateien in Base64",
+            "base64 <encode|decode> <text> | base64 <encode|decode> --file <eingabedatei> <ausgabedatei>"
+        );
+
+        commands["math"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { performMathOperation(args); },
+            "Berechnet mathematische Ausdruecke",
+            "math <ausdruck> | math <name> = <ausdruck> | math --over <datei> <ausdruck> [--col N] [--sep c]"
+        );
+
+        commands["du"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { showDiskUsage(args); },
+            "Zeigt die Speicherbelegung eines Verzeichnisbaums an",
+            "du [pfad] [--depth N] [--top K] [--refresh]"
+        );
+
+        commands["dupes"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { findDuplicates(args); },
+            "Findet Dateien mit identischem Inhalt",
+            "dupes [pfad] [--min-size N] [--link hard|clone] [--refresh]"
+        );
+
+        commands["sort"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { sortItems(args); },
+            "Sortiert Elemente oder die Zeilen einer Datei",
+            "sort [-n] [-u] <element>... | sort --file <datei> [--out datei] [-k spalte] [-n] [-u] [--memory MB] [--temp verzeichnis]"
+        );
+
+        commands["random"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { generateRandom(args); },
+            "Erzeugt Zufallszahlen oder Zufallsdaten",
+            "random [--count N] [--range a b] [--seed s] [--out datei] | random --bytes N --out datei [--seed s]"
+        );
+
+        commands["agg"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { aggregateColumn(args); },
+            "Aggregiert eine Spalte einer CSV-/TSV-Datei",
+            "agg <datei> <spalte> [--group-by spalte] [--sep c]"
+        );
+
+        commands["watch"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { watchPath(args); },
+            "Fuehrt einen Befehl aus, sobald sich Dateien aendern",
+            "watch <pfad> [--recursive] [--debounce ms] -- <befehl>"
         );
 
-        commands["stats"] = std::make_unique<ConcreteCommand>(
-            [](const auto&) { PerformanceMetrics::displayMetrics(); },
-            "Zeigt Leistungsmetriken an",
-            "stats"
+        commands["sysinfo"] = std::make_unique<ConcreteCommand>(
+            [this](const auto& args) { showSystemInfo(args); },
+            "Zeigt Systeminformationen an",
+            "sysinfo [--interval <ms>]"
         );
 
         commands["edit"] = std::make_unique<EditCommand>(*this);
@@ -1051,6 +8162,32 @@ private:
         }
     }
 
+    void loadSettings() {
+        std::ifstream settingsFile("settings.txt");
+        std::string line;
+        while (std::getline(settingsFile, line)) {
+            size_t pos = line.find("=");
+            if (pos != std::string::npos) {
+                settings[line.substr(0, pos)] = line.substr(pos + 1);
+            }
+        }
+    }
+
+    void saveSettings() {
+        std::ofstream settingsFile("settings.txt");
+        for (const auto& [key, value] : settings) {
+            settingsFile << key << "=" << value << "\n";
+        }
+    }
+
+    long long settingAsInt(const std::string& key, long long fallback) const {
+        auto it = settings.find(key);
+        if (it == settings.end()) return fallback;
+        long long value = fallback;
+        auto [ptr, ec] = std::from_chars(it->second.data(), it->second.data() + it->second.size(), value);
+        return ec == std::errc() ? value : fallback;
+    }
+
     void loadThemes() {
         std::ifstream themeFile("themes.txt");
         if (themeFile.is_open()) {
@@ -1079,7 +8216,7 @@ private:
 
     std::string getCommandInput() {
         std::string input;
-        int cursorPos = 0;
+        size_t cursorPos = 0;
         
         while (true) {
             if (_kbhit()) {
@@ -1089,38 +8226,35 @@ private:
                     std::cout << '\n';
                     return input;
                 }
+                else if (ch == '\t') {
+                    ui.completeInput(completer, input, cursorPos);
+                }
                 else if (ch == 8) { 
                     if (!input.empty() && cursorPos > 0) {
                         input.erase(--cursorPos, 1);
-                        
-                        std::cout << "\b \b" << input.substr(cursorPos);
+                        ui.updatePromptInput(input, cursorPos);
                     }
                 }
                 else if (ch == 224) { 
                     ch = _getch();
                     if (ch == 72) { 
                         if (!commandHistory.empty() && historyIndex < commandHistory.size() - 1) {
-                            
-                            std::cout << "\r" << std::string(input.length() + 3, ' ');
                             input = commandHistory[++historyIndex];
                             cursorPos = input.length();
-                            ui.drawPrompt(fs::current_path().string());
-                            std::cout << input;
+                            ui.updatePromptInput(input, cursorPos);
                         }
                     }
                     else if (ch == 80) { 
                         if (historyIndex > 0) {
-                            std::cout << "\r" << std::string(input.length() + 3, ' ');
                             input = commandHistory[--historyIndex];
                             cursorPos = input.length();
-                            ui.drawPrompt(fs::current_path().string());
-                            std::cout << input;
+                            ui.updatePromptInput(input, cursorPos);
                         }
                     }
                 }
                 else if (ch >= 32 && ch <= 126) { 
                     input.insert(cursorPos++, 1, (char)ch);
-                    std::cout << (char)ch;
+                    ui.updatePromptInput(input, cursorPos);
                 }
             }
         }
@@ -1162,6 +8296,7 @@ private:
         aliases[args[0]] = args[1];
         std::cout << "Alias gesetzt: " << args[0] << " -> " << args[1] << std::endl;
         saveAliases();
+        completer.rebuild(commands, aliases);
     }
 
     void createFile(const std::vector<std::string>& args) {
@@ -1177,22 +8312,358 @@ private:
         }
     }
 
+    // Paths whose removal would take the system or a user's data with it.
+    static std::string protectedReason(const fs::path& target) {
+        fs::path normal = target.lexically_normal();
+        if (normal == normal.root_path() || normal.relative_path().empty()) {
+            return "Laufwerks- oder Stammverzeichnis";
+        }
+
+        auto contains = [](const fs::path& outer, const fs::path& inner) {
+            auto relative = inner.lexically_normal().lexically_relative(outer.lexically_normal());
+            return !relative.empty() && *relative.begin() != "..";
+        };
+        auto same = [](const fs::path& a, const fs::path& b) {
+            return _wcsicmp(a.lexically_normal().c_str(), b.lexically_normal().c_str()) == 0;
+        };
+
+        wchar_t buffer[MAX_PATH];
+        DWORD length = GetEnvironmentVariableW(L"USERPROFILE", buffer, MAX_PATH);
+        if (length > 0 && length < MAX_PATH) {
+            fs::path profile(buffer);
+            if (contains(normal, profile)) return "enthaelt das Benutzerprofil";
+            if (same(normal.parent_path(), profile.parent_path())) return "Benutzerprofil";
+        }
+        UINT windowsLength = GetWindowsDirectoryW(buffer, MAX_PATH);
+        if (windowsLength > 0 && windowsLength < MAX_PATH && contains(normal, fs::path(buffer))) {
+            return "enthaelt das Windows-Verzeichnis";
+        }
+        if (contains(normal, fs::current_path())) {
+            return "enthaelt das aktuelle Verzeichnis";
+        }
+        return {};
+    }
+
     void deleteFile(const std::vector<std::string>& args) {
-        if (args.empty()) {
-            std::cout << "Verwendung: delete <dateiname>\n";
+        bool recursive = false;
+        bool dryRun = false;
+        std::string target;
+        for (const auto& arg : args) {
+            if (arg == "-r") recursive = true;
+            else if (arg == "--dry-run") dryRun = true;
+            else target = arg;
+        }
+        if (target.empty()) {
+            std::cout << "Verwendung: delete <pfad> [-r] [--dry-run]\n";
+            return;
+        }
+
+        std::error_code ec;
+        fs::path path = fs::absolute(fs::u8path(target), ec);
+        auto status = fs::symlink_status(path, ec);
+        if (!recursive || status.type() != fs::file_type::directory) {
+            if (dryRun) {
+                std::cout << (fs::exists(status) ? "Wuerde '" + target + "' loeschen.\n" : "'" + target + "' existiert nicht.\n");
+            } else if (fs::remove(path, ec)) {
+                std::cout << "Datei '" << target << "' geloescht.\n";
+            } else {
+                std::cerr << "Fehler: Datei '" << target << "' konnte nicht geloescht werden.\n";
+            }
+            return;
+        }
+
+        std::string reason = protectedReason(path);
+        if (!reason.empty()) {
+            std::cerr << "Fehler: '" << target << "' wird nicht geloescht (" << reason << ").\n";
+            return;
+        }
+
+        TreeRemover remover(threadPool, dryRun);
+        auto start = std::chrono::steady_clock::now();
+        auto report = [&] {
+            if (ConsoleInterrupt::requested()) remover.cancel();
+            std::cout << "\r  " << remover.counts().files << " Dateien, " << remover.counts().directories
+                      << " Verzeichnisse " << (dryRun ? "gezaehlt" : "geloescht") << "   " << std::flush;
+        };
+        ConsoleInterrupt::reset();
+        bool ok = remover.remove(path, report);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "\r" << std::string(60, ' ') << "\r";
+        for (const auto& error : remover.errors()) {
+            std::cerr << "Fehler: " << error << "\n";
+        }
+        const auto& counts = remover.counts();
+        if (ConsoleInterrupt::requested()) std::cout << "Abgebrochen. ";
+        std::cout << counts.files << " Dateien und " << counts.directories << " Verzeichnisse ("
+                  << std::fixed << std::setprecision(1) << counts.bytes / (1024.0 * 1024.0) << " MB) "
+                  << (dryRun ? "wuerden geloescht" : "geloescht") << " in " << seconds << " s.\n";
+        if (!ok && !ConsoleInterrupt::requested()) {
+            std::cerr << remover.errors().size() << " Eintraege konnten nicht geloescht werden.\n";
+        }
+    }
+
+    void transferFiles(const std::vector<std::string>& args, bool move) {
+        std::vector<std::string> paths;
+        bool overwrite = false;
+        for (const auto& arg : args) {
+            if (arg == "--force" || arg == "-f") overwrite = true;
+            else paths.push_back(arg);
+        }
+        const char* name = move ? "move" : "copy";
+        if (paths.size() != 2) {
+            std::cout << "Verwendung: " << name << " <quelle> <ziel> [--force]\n";
+            return;
+        }
+
+        std::error_code ec;
+        fs::path source = fs::absolute(fs::u8path(paths[0]), ec);
+        fs::path target = fs::absolute(fs::u8path(paths[1]), ec);
+        if (!fs::exists(source, ec)) {
+            std::cerr << "Fehler: '" << paths[0] << "' existiert nicht.\n";
+            return;
+        }
+        if (fs::is_directory(target, ec)) {
+            target /= source.filename();
+        }
+        if (fs::equivalent(source, target, ec)) {
+            std::cerr << "Fehler: Quelle und Ziel sind identisch.\n";
+            return;
+        }
+        if (fs::exists(target, ec) && !overwrite) {
+            std::cerr << "Fehler: '" << target.u8string() << "' existiert bereits (--force zum Ueberschreiben).\n";
             return;
         }
-        if (fs::remove(args[0])) {
-            std::cout << "Datei '" << args[0] << "' geloescht.\n";
+        if (fs::is_directory(source, ec)) {
+            auto relative = target.lexically_normal().lexically_relative(source.lexically_normal());
+            if (!relative.empty() && *relative.begin() != "..") {
+                std::cerr << "Fehler: Ein Verzeichnis kann nicht in sich selbst kopiert werden.\n";
+                return;
+            }
+        }
+
+        FileTransfer transfer(threadPool, overwrite);
+        auto start = std::chrono::steady_clock::now();
+        auto report = [&] {
+            if (ConsoleInterrupt::requested()) transfer.cancel();
+            const auto& progress = transfer.progress();
+            uint64_t total = std::max<uint64_t>(progress.totalBytes, 1);
+            std::cout << "\r  " << progress.filesDone << "/" << progress.totalFiles << " Dateien, "
+                      << progress.bytesDone / (1024 * 1024) << " / " << progress.totalBytes / (1024 * 1024) << " MB ("
+                      << progress.bytesDone * 100 / total << " %)   " << std::flush;
+        };
+
+        ConsoleInterrupt::reset();
+        bool ok = move ? transfer.move(source, target, report) : transfer.copy(source, target, report);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const auto& progress = transfer.progress();
+        std::cout << "\r" << std::string(60, ' ') << "\r";
+        for (const auto& error : transfer.errors()) {
+            std::cerr << "Fehler: " << error << "\n";
+        }
+        if (ConsoleInterrupt::requested()) {
+            std::cout << "Abgebrochen nach " << progress.filesDone << " Dateien.\n";
+        } else if (ok && transfer.renamedInPlace()) {
+            std::cout << "'" << paths[0] << "' nach '" << target.u8string() << "' verschoben.\n";
+        } else if (ok) {
+            std::cout << progress.filesDone << " Datei(en) " << (move ? "verschoben" : "kopiert") << ", "
+                      << std::fixed << std::setprecision(1) << progress.bytesDone / (1024.0 * 1024.0) << " MB in "
+                      << seconds << " s";
+            if (seconds > 0 && progress.bytesDone > 0) {
+                std::cout << " (" << progress.bytesDone / (1024.0 * 1024.0) / seconds << " MB/s)";
+            }
+            std::cout << "\n";
         } else {
-            std::cerr << "Fehler: Datei '" << args[0] << "' konnte nicht geloescht werden.\n";
+            std::cerr << transfer.errors().size() << " Fehler, " << progress.filesDone << " von "
+                      << progress.totalFiles << " Dateien uebertragen.\n";
+        }
+    }
+
+    struct ListItem {
+        uint64_t key;
+        size_t nameOffset;
+        uint32_t nameLength;
+        DWORD attributes;
+        uint64_t size;
+        uint64_t lastWriteTime;
+    };
+
+    static unsigned char foldByte(unsigned char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c + 32) : c;
+    }
+
+    // Case-insensitive ASCII order without locale lookups. The first eight folded
+    // bytes are packed big-endian into `key`, which settles most comparisons.
+    static uint64_t foldedPrefix(const char* name, size_t length) {
+        uint64_t key = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            key = (key << 8) | (i < length ? foldByte(static_cast<unsigned char>(name[i])) : 0);
+        }
+        return key;
+    }
+
+    static bool nameLess(const ListItem& a, const ListItem& b, const std::string& names) {
+        if (a.key != b.key) return a.key < b.key;
+        const char* left = names.data() + a.nameOffset;
+        const char* right = names.data() + b.nameOffset;
+        size_t common = std::min(a.nameLength, b.nameLength);
+        for (size_t i = 8; i < common; ++i) {
+            unsigned char l = foldByte(static_cast<unsigned char>(left[i]));
+            unsigned char r = foldByte(static_cast<unsigned char>(right[i]));
+            if (l != r) return l < r;
+        }
+        if (a.nameLength != b.nameLength) return a.nameLength < b.nameLength;
+        return std::memcmp(left, right, a.nameLength) < 0;
+    }
+
+    void listFiles(const std::vector<std::string>& args) {
+        bool longFormat = false;
+        bool showHidden = false;
+        bool reverse = false;
+        std::string sortBy = "name";
+        std::string target = ".";
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "-l") longFormat = true;
+            else if (args[i] == "-a") showHidden = true;
+            else if (args[i] == "-la" || args[i] == "-al") longFormat = showHidden = true;
+            else if (args[i] == "-r") reverse = true;
+            else if (args[i] == "--sort" && i + 1 < args.size()) sortBy = args[++i];
+            else if (!args[i].empty() && args[i][0] == '-') {
+                std::cout << "Verwendung: list [pfad] [-l] [-a] [--sort name|size|time|none] [-r]\n";
+                return;
+            } else target = args[i];
+        }
+        if (sortBy != "name" && sortBy != "size" && sortBy != "time" && sortBy != "none") {
+            std::cout << "Unbekannte Sortierung: " << sortBy << "\n";
+            return;
+        }
+
+        DirectoryReader reader(fs::u8path(target));
+        std::vector<ListItem> items;
+        std::string names;
+        uint64_t totalBytes = 0;
+        size_t directories = 0;
+        bool complete = reader.forEach([&](const DirectoryReader::Entry& entry) {
+            if (!showHidden && (entry.attributes & (FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM))) return;
+            size_t offset = names.size();
+            TextEncoding::appendUtf8(names, entry.name, entry.nameLength);
+            items.push_back(ListItem{0, offset, static_cast<uint32_t>(names.size() - offset),
+                                     entry.attributes, entry.size, entry.lastWriteTime});
+            if (entry.isDirectory()) ++directories;
+            else totalBytes += entry.size;
+        });
+        if (!reader.isOpen()) {
+            std::cerr << "Fehler: Verzeichnis '" << target << "' kann nicht gelesen werden.\n";
+            return;
+        }
+
+        for (auto& item : items) {
+            item.key = foldedPrefix(names.data() + item.nameOffset, item.nameLength);
+        }
+        auto byName = [&names](const ListItem& a, const ListItem& b) { return nameLess(a, b, names); };
+        auto sortItems = [&](auto less) {
+            if (items.size() > PARALLEL_SORT_THRESHOLD) std::sort(std::execution::par, items.begin(), items.end(), less);
+            else std::sort(items.begin(), items.end(), less);
+        };
+        if (sortBy == "name") {
+            sortItems(byName);
+        } else if (sortBy == "size") {
+            sortItems([&](const ListItem& a, const ListItem& b) {
+                return a.size != b.size ? a.size > b.size : byName(a, b);
+            });
+        } else if (sortBy == "time") {
+            sortItems([&](const ListItem& a, const ListItem& b) {
+                return a.lastWriteTime != b.lastWriteTime ? a.lastWriteTime > b.lastWriteTime : byName(a, b);
+            });
+        }
+        if (reverse) std::reverse(items.begin(), items.end());
+
+        std::string out;
+        if (longFormat) {
+            out.reserve(items.size() * 48 + names.size());
+            char line[64];
+            for (const auto& item : items) {
+                FILETIME utc{static_cast<DWORD>(item.lastWriteTime), static_cast<DWORD>(item.lastWriteTime >> 32)};
+                FILETIME local;
+                SYSTEMTIME time{};
+                FileTimeToLocalFileTime(&utc, &local);
+                FileTimeToSystemTime(&local, &time);
+                char sizeText[24];
+                if (item.attributes & FILE_ATTRIBUTE_DIRECTORY) {
+                    std::strcpy(sizeText, "<DIR>");
+                } else {
+                    *std::to_chars(sizeText, sizeText + sizeof(sizeText) - 1, item.size).ptr = '\0';
+                }
+                int length = std::snprintf(line, sizeof(line), "%c%c%c%c%c  %04u-%02u-%02u %02u:%02u  %14s  ",
+                    item.attributes & FILE_ATTRIBUTE_DIRECTORY ? 'd' : '-',
+                    item.attributes & FILE_ATTRIBUTE_READONLY ? 'r' : '-',
+                    item.attributes & FILE_ATTRIBUTE_ARCHIVE ? 'a' : '-',
+                    item.attributes & FILE_ATTRIBUTE_HIDDEN ? 'h' : '-',
+                    item.attributes & FILE_ATTRIBUTE_SYSTEM ? 's' : '-',
+                    static_cast<unsigned>(time.wYear), static_cast<unsigned>(time.wMonth), static_cast<unsigned>(time.wDay),
+                    static_cast<unsigned>(time.wHour), static_cast<unsigned>(time.wMinute), sizeText);
+                out.append(line, static_cast<size_t>(length));
+                out.append(names, item.nameOffset, item.nameLength);
+                out += '\n';
+            }
+            out += std::to_string(items.size() - directories) + " Datei(en), " + std::to_string(directories) +
+                   " Verzeichnis(se), " + std::to_string(totalBytes) + " Bytes\n";
+        } else if (!items.empty()) {
+            formatColumns(items, names, out);
+        }
+        if (!complete) {
+            out += "Warnung: Verzeichnis wurde nicht vollstaendig gelesen.\n";
         }
+        writeOutput(out.data(), out.size());
     }
 
-    void listFiles() {
-        std::cout << "Dateien im aktuellen Verzeichnis:\n";
-        for (const auto& entry : fs::directory_iterator(fs::current_path())) {
-            std::cout << " - " << entry.path().filename().string() << std::endl;
+    // Column-major layout with per-column widths, using as many columns as fit.
+    void formatColumns(const std::vector<ListItem>& items, const std::string& names, std::string& out) const {
+        size_t lineWidth = static_cast<size_t>(ui.getWidth() - 1);
+        std::vector<uint32_t> widths(items.size());
+        size_t narrowest = SIZE_MAX;
+        for (size_t i = 0; i < items.size(); ++i) {
+            const char* name = names.data() + items[i].nameOffset;
+            for (uint32_t j = 0; j < items[i].nameLength; ++j) {
+                widths[i] += (static_cast<unsigned char>(name[j]) & 0xC0) != 0x80;
+            }
+            narrowest = std::min<size_t>(narrowest, widths[i]);
+        }
+
+        size_t rows = items.size();
+        std::vector<size_t> columnWidths{0};
+        for (size_t columns = std::min(items.size(), lineWidth / (narrowest + COLUMN_GAP)); columns > 1; --columns) {
+            size_t candidateRows = (items.size() + columns - 1) / columns;
+            size_t used = (items.size() + candidateRows - 1) / candidateRows;
+            std::vector<size_t> candidate(used, 0);
+            size_t total = COLUMN_GAP * (used - 1);
+            bool fits = true;
+            for (size_t i = 0; i < items.size() && fits; ++i) {
+                size_t& width = candidate[i / candidateRows];
+                if (widths[i] > width) {
+                    total += widths[i] - width;
+                    width = widths[i];
+                    fits = total <= lineWidth;
+                }
+            }
+            if (fits) {
+                rows = candidateRows;
+                columnWidths = std::move(candidate);
+                break;
+            }
+        }
+
+        out.reserve(names.size() + rows * (lineWidth + 1));
+        for (size_t row = 0; row < rows; ++row) {
+            for (size_t column = 0; column < columnWidths.size(); ++column) {
+                size_t index = column * rows + row;
+                if (index >= items.size()) break;
+                out.append(names, items[index].nameOffset, items[index].nameLength);
+                bool lastInRow = column + 1 == columnWidths.size() || index + rows >= items.size();
+                if (!lastInRow) out.append(columnWidths[column] - widths[index] + COLUMN_GAP, ' ');
+            }
+            out += '\n';
         }
     }
 
@@ -1205,11 +8676,220 @@ private:
         system(command.c_str());
     }
 
-    void generateRandomNumber() {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> distr(1, 100);
-        std::cout << "Zufallszahl: " << distr(gen) << std::endl;
+    // Output is cut into blocks, and every block draws from its own stream, jumped
+    // off the seed once per block. The blocks of a round are generated on the pool
+    // while the previous round is written, and the result only depends on the seed.
+    void generateRandom(const std::vector<std::string>& args) {
+        const char* usage = "Verwendung: random [--count N] [--range a b] [--seed s] [--out datei] | random --bytes N --out datei [--seed s]\n";
+        uint64_t count = 1;
+        int64_t low = 1;
+        int64_t high = 100;
+        std::optional<uint64_t> bytes;
+        std::optional<uint64_t> seed;
+        std::optional<std::string> output;
+        try {
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (args[i] == "--count" && i + 1 < args.size()) count = std::stoull(args[++i]);
+                else if (args[i] == "--range" && i + 2 < args.size()) {
+                    low = std::stoll(args[++i]);
+                    high = std::stoll(args[++i]);
+                } else if (args[i] == "--bytes" && i + 1 < args.size()) bytes = std::stoull(args[++i]);
+                else if (args[i] == "--seed" && i + 1 < args.size()) seed = std::stoull(args[++i]);
+                else if (args[i] == "--out" && i + 1 < args.size()) output = args[++i];
+                else throw std::invalid_argument(args[i]);
+            }
+        } catch (const std::exception&) {
+            std::cout << usage;
+            return;
+        }
+        if (low > high || (bytes && !output)) {
+            std::cout << usage;
+            return;
+        }
+        if (!seed) seed = (static_cast<uint64_t>(std::random_device{}()) << 32) ^
+                          static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+
+        if (args.empty()) {
+            Xoshiro256 generator(*seed);
+            std::cout << "Zufallszahl: " << low + static_cast<int64_t>(generator.below(static_cast<uint64_t>(high - low) + 1)) << "\n";
+            return;
+        }
+
+        uint64_t range = static_cast<uint64_t>(high) - static_cast<uint64_t>(low) + 1;
+        uint64_t perBlock = bytes ? RANDOM_BYTE_BLOCK : RANDOM_NUMBER_BLOCK;
+        uint64_t total = bytes ? *bytes : count;
+        uint64_t blocks = (total + perBlock - 1) / perBlock;
+        auto produce = [&](uint64_t block, Xoshiro256& stream, std::string& out) {
+            uint64_t items = std::min(perBlock, total - block * perBlock);
+            if (bytes) {
+                out.resize(static_cast<size_t>(items));
+                stream.fill(out.data(), out.size());
+                return;
+            }
+            out.resize(static_cast<size_t>(items) * 21);
+            char* at = out.data();
+            for (uint64_t i = 0; i < items; ++i) {
+                int64_t value = static_cast<int64_t>(static_cast<uint64_t>(low) + stream.below(range));
+                at = std::to_chars(at, at + 20, value).ptr;
+                *at++ = '\n';
+            }
+            out.resize(static_cast<size_t>(at - out.data()));
+        };
+
+        HANDLE file = INVALID_HANDLE_VALUE;
+        if (output) {
+            file = CreateFileW(fs::u8path(*output).c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                               FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                std::cerr << "Fehler: Konnte Datei '" << *output << "' nicht anlegen.\n";
+                return;
+            }
+        }
+
+        Xoshiro256 base(*seed);
+        std::vector<std::string> buffers[2] = {std::vector<std::string>(RANDOM_ROUND), std::vector<std::string>(RANDOM_ROUND)};
+        std::optional<TaskGroup> groups[2];
+        auto startRound = [&](size_t slot, uint64_t first) {
+            groups[slot].emplace(threadPool);
+            for (size_t i = 0; i < RANDOM_ROUND && first + i < blocks; ++i) {
+                groups[slot]->run([&produce, &buffers, slot, i, block = first + i, stream = base]() mutable {
+                    produce(block, stream, buffers[slot][i]);
+                });
+                base.jump();
+            }
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        uint64_t written = 0;
+        bool ok = true;
+        ConsoleInterrupt::reset();
+        if (blocks > 0) startRound(0, 0);
+        for (uint64_t round = 0; ok && round * RANDOM_ROUND < blocks; ++round) {
+            size_t slot = round % 2;
+            groups[slot]->wait();
+            uint64_t first = round * RANDOM_ROUND;
+            bool interrupted = ConsoleInterrupt::requested();
+            if (!interrupted && first + RANDOM_ROUND < blocks) startRound(1 - slot, first + RANDOM_ROUND);
+            for (size_t i = 0; ok && i < RANDOM_ROUND && first + i < blocks; ++i) {
+                const std::string& text = buffers[slot][i];
+                for (size_t done = 0; ok && done < text.size();) {
+                    DWORD slice = static_cast<DWORD>(std::min<size_t>(text.size() - done, OUTPUT_SLICE));
+                    DWORD sent = 0;
+                    if (file == INVALID_HANDLE_VALUE) writeOutput(text.data() + done, slice);
+                    else ok = WriteFile(file, text.data() + done, slice, &sent, nullptr) && sent == slice;
+                    done += slice;
+                }
+                written += text.size();
+            }
+            if (interrupted) break;
+            if (output) std::cout << "\r  " << formatSize(written) << " geschrieben..." << std::flush;
+        }
+        for (auto& group : groups) group.reset();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (!output) return;
+        CloseHandle(file);
+        std::cout << "\r" << std::string(40, ' ') << "\r";
+        if (!ok) {
+            std::cerr << "Fehler: Schreiben nach '" << *output << "' fehlgeschlagen.\n";
+            DeleteFileW(fs::u8path(*output).c_str());
+        } else if (ConsoleInterrupt::requested()) {
+            std::cout << "Abgebrochen.\n";
+        } else {
+            double megabytes = written / (1024.0 * 1024.0);
+            std::cout << formatSize(written) << " in " << std::fixed << std::setprecision(2) << seconds << " s ("
+                      << std::setprecision(0) << megabytes / std::max(seconds, 1e-9) << " MB/s) -> " << *output
+                      << std::defaultfloat << " (Seed " << *seed << ")\n";
+        }
+    }
+
+    void listProcesses(const std::vector<std::string>& args) {
+        const char* usage = "Verwendung: ps [--sort pid|name|cpu|mem] [--filter text]\n";
+        ProcessTable::SortKey sortKey = ProcessTable::SortKey::Pid;
+        std::string filter;
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "--sort" && i + 1 < args.size()) {
+                auto key = ProcessTable::parseSortKey(args[++i]);
+                if (!key) {
+                    std::cout << usage;
+                    return;
+                }
+                sortKey = *key;
+            } else if (args[i] == "--filter" && i + 1 < args.size()) {
+                filter = args[++i];
+            } else {
+                std::cout << usage;
+                return;
+            }
+        }
+
+        ProcessTable table;
+        if (!table.refresh()) {
+            std::cerr << "Fehler: Prozessliste konnte nicht gelesen werden.\n";
+            return;
+        }
+        table.sort(sortKey);
+        std::string needle = filter;
+        std::transform(needle.begin(), needle.end(), needle.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        std::string out;
+        char line[96];
+        std::snprintf(line, sizeof(line), "%8s %8s %7s %8s %12s %12s  %s\n", "PID", "PPID", "Threads", "Handles", "Speicher", "CPU-Zeit", "Name");
+        out += line;
+        size_t shown = 0;
+        std::string lowered;
+        for (const auto& process : table.processes()) {
+            if (!needle.empty()) {
+                lowered = process.name;
+                std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                if (lowered.find(needle) == std::string::npos && std::to_string(process.pid) != needle) continue;
+            }
+            uint64_t seconds = process.cpuTime / 10000000;
+            std::snprintf(line, sizeof(line), "%8lu %8lu %7lu %8lu %12s %5llu:%02llu:%02llu  ",
+                          static_cast<unsigned long>(process.pid), static_cast<unsigned long>(process.parentPid),
+                          static_cast<unsigned long>(process.threads), static_cast<unsigned long>(process.handles),
+                          formatSize(process.workingSet).c_str(), static_cast<unsigned long long>(seconds / 3600),
+                          static_cast<unsigned long long>(seconds / 60 % 60), static_cast<unsigned long long>(seconds % 60));
+            out += line;
+            out += process.name;
+            out += '\n';
+            ++shown;
+        }
+        out += std::to_string(shown) + " von " + std::to_string(table.processes().size()) + " Prozessen\n";
+        writeOutput(out.data(), out.size());
+    }
+
+    void showTop(const std::vector<std::string>& args) {
+        const char* usage = "Verwendung: top [--sort cpu|mem|pid|name] [--interval ms]\n";
+        ProcessTable::SortKey sortKey = ProcessTable::SortKey::Cpu;
+        std::chrono::milliseconds interval(1000);
+        try {
+            for (size_t i = 0; i < args.size(); ++i) {
+                std::optional<ProcessTable::SortKey> key;
+                if (args[i] == "--sort" && i + 1 < args.size() && (key = ProcessTable::parseSortKey(args[++i]))) sortKey = *key;
+                else if (args[i] == "--interval" && i + 1 < args.size()) interval = std::chrono::milliseconds(std::max(100, std::stoi(args[++i])));
+                else throw std::invalid_argument(args[i]);
+            }
+        } catch (const std::exception&) {
+            std::cout << usage;
+            return;
+        }
+        ProcessTable table;
+        if (!table.refresh() || !ui.showProcesses(table, sortKey, interval)) {
+            std::cerr << "Fehler: Prozessliste konnte nicht gelesen werden.\n";
+        }
+    }
+
+    void killProcess(const std::vector<std::string>& args) {
+        if (args.size() != 1 || args[0].empty() ||
+            !std::all_of(args[0].begin(), args[0].end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+            std::cout << "Verwendung: kill <pid>\n";
+            return;
+        }
+        DWORD pid = static_cast<DWORD>(std::stoul(args[0]));
+        DWORD error = ProcessTable::terminate(pid);
+        if (error == 0) std::cout << "Prozess " << pid << " beendet.\n";
+        else std::cerr << "Fehler: Prozess " << pid << " konnte nicht beendet werden (Code " << error << ").\n";
     }
 
     void sleepForSeconds(const std::vector<std::string>& args) {
@@ -1264,121 +8944,413 @@ private:
         }
     }
 
+    void writeOutput(const char* data, size_t size) {
+        if (std::cout.rdbuf() != consoleOutput) {
+            std::cout.write(data, static_cast<std::streamsize>(size));
+            return;
+        }
+        std::cout.flush();
+        HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+        while (size > 0) {
+            DWORD slice = static_cast<DWORD>(std::min<size_t>(size, OUTPUT_SLICE));
+            DWORD written = 0;
+            if (!WriteFile(out, data, slice, &written, nullptr) || written == 0) return;
+            data += written;
+            size -= written;
+        }
+    }
+
     void readFromFile(const std::vector<std::string>& args) {
         if (args.empty()) {
-            std::cout << "Verwendung: readfile <dateiname>\n";
+            std::cout << "Verwendung: readfile <dateiname> [--head N | --tail N] [--follow] [--page]\n";
             return;
         }
-        std::ifstream inFile(args[0]);
-        if (inFile.is_open()) {
-            std::string line;
-            while (std::getline(inFile, line)) {
-                std::cout << line << std::endl;
+        bool page = false;
+        bool follow = false;
+        std::optional<uint64_t> head;
+        std::optional<uint64_t> tail;
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (args[i] == "--page") page = true;
+            else if (args[i] == "--follow" || args[i] == "-f") follow = true;
+            else if (args[i] == "--head" && i + 1 < args.size()) head = std::stoull(args[++i]);
+            else if (args[i] == "--tail" && i + 1 < args.size()) tail = std::stoull(args[++i]);
+            else {
+                std::cout << "Unbekannte Option: " << args[i] << "\n";
+                return;
             }
-            inFile.close();
-        } else {
+        }
+
+        fs::path path = fs::u8path(args[0]);
+        MappedFile file(path);
+        if (!file.isOpen()) {
             std::cerr << "Fehler: Konnte Datei '" << args[0] << "' nicht lesen.\n";
+            return;
+        }
+
+        if (page) {
+            scrollback.clear();
+        }
+        auto emit = [this, page](const char* data, size_t size) {
+            if (page) scrollback.append(data, size);
+            else writeOutput(data, size);
+        };
+
+        const char* begin = file.data();
+        uint64_t size = file.size();
+        uint64_t from = 0;
+        uint64_t to = size;
+        if (head) {
+            to = 0;
+            for (uint64_t line = 0; line < *head && to < size; ++line) {
+                const void* newline = std::memchr(begin + to, '\n', static_cast<size_t>(size - to));
+                to = newline ? static_cast<uint64_t>(static_cast<const char*>(newline) - begin) + 1 : size;
+            }
+        } else if (tail) {
+            uint64_t newlines = 0;
+            uint64_t scan = size > 0 && begin[size - 1] == '\n' ? size - 1 : size;
+            while (scan > 0 && newlines < *tail) {
+                if (begin[--scan] == '\n' && ++newlines == *tail) {
+                    ++scan;
+                    break;
+                }
+            }
+            from = *tail == 0 ? size : scan;
+        }
+
+        ConsoleInterrupt::reset();
+        for (uint64_t pos = from; pos < to && !ConsoleInterrupt::requested(); pos += OUTPUT_SLICE) {
+            emit(begin + pos, static_cast<size_t>(std::min<uint64_t>(OUTPUT_SLICE, to - pos)));
+        }
+
+        if (follow && !page && !ConsoleInterrupt::requested()) {
+            uint64_t offset = size;
+            file.close();
+            followFile(path, offset);
+        }
+        if (ConsoleInterrupt::requested()) {
+            std::cout << "\nAbgebrochen.\n";
+        }
+        if (page) {
+            ui.showPager(scrollback, args[0]);
         }
     }
 
-    void encryptFile(const std::vector<std::string>& args) {
-        if (args.size() != 2) {
-            std::cout << "Verwendung: encrypt <eingabedatei> <ausgabedatei>\n";
+    // Prints data appended to `path` after `offset` as change notifications arrive,
+    // until a key or Ctrl+C is pressed.
+    void followFile(const fs::path& path, uint64_t offset) {
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, 0, nullptr);
+        fs::path dirPath = path.has_parent_path() ? path.parent_path() : fs::current_path();
+        HANDLE dir = CreateFileW(dirPath.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                 nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (file == INVALID_HANDLE_VALUE || dir == INVALID_HANDLE_VALUE) {
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+            if (dir != INVALID_HANDLE_VALUE) CloseHandle(dir);
+            std::cerr << "Fehler: Datei kann nicht verfolgt werden.\n";
             return;
         }
-        std::ifstream inFile(args[0], std::ios::binary);
-        std::ofstream outFile(args[1], std::ios::binary);
-        if (!inFile || !outFile) {
-            std::cerr << "Fehler: Konnte Dateien nicht oeffnen.\n";
-            return;
+
+        std::cout << "\n[Verfolge " << path.filename().string() << " - beliebige Taste beendet]\n" << std::flush;
+        std::vector<DWORD> notifications(16 * 1024);
+        std::vector<char> buffer(1024 * 1024);
+        OVERLAPPED overlapped{};
+        overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+        FlushConsoleInputBuffer(input);
+        bool pending = false;
+        auto cancelWatch = [&] {
+            if (!pending) return;
+            // The kernel writes into `notifications` until the cancelled read completes.
+            CancelIo(dir);
+            DWORD bytes = 0;
+            GetOverlappedResult(dir, &overlapped, &bytes, TRUE);
+            pending = false;
+        };
+        auto printAppended = [&] {
+            LARGE_INTEGER current;
+            if (!GetFileSizeEx(file, &current)) return false;
+            if (static_cast<uint64_t>(current.QuadPart) < offset) {
+                std::cout << "\n[Datei wurde gekuerzt]\n";
+                offset = 0;
+            }
+            while (offset < static_cast<uint64_t>(current.QuadPart)) {
+                OVERLAPPED position{};
+                position.Offset = static_cast<DWORD>(offset);
+                position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+                DWORD read = 0;
+                if (!ReadFile(file, buffer.data(), static_cast<DWORD>(buffer.size()), &read, &position) || read == 0) break;
+                writeOutput(buffer.data(), read);
+                offset += read;
+            }
+            return true;
+        };
+
+        while (true) {
+            ResetEvent(overlapped.hEvent);
+            if (!ReadDirectoryChangesW(dir, notifications.data(), static_cast<DWORD>(notifications.size() * sizeof(DWORD)),
+                                       FALSE, FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+                                       nullptr, &overlapped, nullptr)) {
+                break;
+            }
+            pending = true;
+            // Data appended while no read was armed raised no notification, so the
+            // size is checked after every re-arm rather than per notification; this
+            // also covers a notification buffer overflow.
+            if (!printAppended()) break;
+
+            HANDLE waits[3] = {overlapped.hEvent, input, ConsoleInterrupt::waitHandle()};
+            DWORD count = waits[2] ? 3 : 2;
+            DWORD signaled = WaitForMultipleObjects(count, waits, FALSE, INFINITE);
+            if (signaled == WAIT_OBJECT_0 + 1) {
+                if (_kbhit()) {
+                    _getch();
+                    break;
+                }
+                FlushConsoleInputBuffer(input);
+                cancelWatch();
+                continue;
+            }
+            if (signaled != WAIT_OBJECT_0) {
+                break;
+            }
+
+            DWORD bytes = 0;
+            GetOverlappedResult(dir, &overlapped, &bytes, FALSE);
+            pending = false;
+        }
+
+        cancelWatch();
+        CloseHandle(overlapped.hEvent);
+        CloseHandle(dir);
+        CloseHandle(file);
+    }
+
+    // `outputSize` maps the input size to the output size where that is known in
+    // advance, so the target can be preallocated.
+    bool streamFile(const std::vector<std::string>& args, const char* usage,
+                    const std::function<uint64_t(uint64_t)>& outputSize, const AsyncFileIO::Transform& transform) {
+        if (args.size() != 2) {
+            std::cout << "Verwendung: " << usage << "\n";
+            return false;
+        }
+        fs::path input = fs::u8path(args[0]);
+        std::error_code ec;
+        uint64_t hint = outputSize ? outputSize(fs::file_size(input, ec)) : 0;
+        std::string error;
+        if (!fileIO.transformFile(input, fs::u8path(args[1]), ec ? 0 : hint, transform, error)) {
+            std::cerr << "Fehler: " << error << ".\n";
+            return false;
+        }
+        return true;
+    }
+
+    static void xorBlock(const char* data, size_t size, std::vector<char>& out) {
+        size_t start = out.size();
+        out.resize(start + size);
+        for (size_t i = 0; i < size; ++i) {
+            out[start + i] = static_cast<char>(data[i] ^ 0x5A);
         }
-        char ch;
-        while (inFile.get(ch)) {
-            ch = ch ^ 0x5A;
-            outFile.put(ch);
+    }
+
+    void encryptFile(const std::vector<std::string>& args) {
+        if (streamFile(args, "encrypt <eingabedatei> <ausgabedatei>", [](uint64_t size) { return size; },
+                       [](const char* data, size_t size, bool, std::vector<char>& out) { xorBlock(data, size, out); })) {
+            std::cout << "Datei erfolgreich verschluesselt.\n";
         }
-        std::cout << "Datei erfolgreich verschluesselt.\n";
     }
 
     void decryptFile(const std::vector<std::string>& args) {
-        if (args.size() != 2) {
-            std::cout << "Verwendung: decrypt <eingabedatei> <ausgabedatei>\n";
-            return;
+        if (streamFile(args, "decrypt <eingabedatei> <ausgabedatei>", [](uint64_t size) { return size; },
+                       [](const char* data, size_t size, bool, std::vector<char>& out) { xorBlock(data, size, out); })) {
+            std::cout << "Datei erfolgreich entschluesselt.\n";
+        }
+    }
+
+    // Run-length encoding as (count, byte) pairs with runs of at most 255. The open
+    // run is carried across blocks so the output matches a single pass.
+    void compressFile(const std::vector<std::string>& args) {
+        char current = 0;
+        unsigned count = 0;
+        auto encode = [&](const char* data, size_t size, bool last, std::vector<char>& out) {
+            for (size_t i = 0; i < size; ++i) {
+                if (count > 0 && data[i] == current && count < 255) {
+                    ++count;
+                    continue;
+                }
+                if (count > 0) {
+                    out.push_back(static_cast<char>(count));
+                    out.push_back(current);
+                }
+                current = data[i];
+                count = 1;
+            }
+            if (last && count > 0) {
+                out.push_back(static_cast<char>(count));
+                out.push_back(current);
+            }
+        };
+        if (streamFile(args, "compress <eingabedatei> <ausgabedatei>", nullptr, encode)) {
+            std::cout << "Datei erfolgreich komprimiert.\n";
+        }
+    }
+
+    void decompressFile(const std::vector<std::string>& args) {
+        int count = -1;
+        auto decode = [&](const char* data, size_t size, bool, std::vector<char>& out) {
+            for (size_t i = 0; i < size; ++i) {
+                if (count < 0) {
+                    count = static_cast<unsigned char>(data[i]);
+                } else {
+                    out.insert(out.end(), static_cast<size_t>(count), data[i]);
+                    count = -1;
+                }
+            }
+        };
+        if (streamFile(args, "decompress <eingabedatei> <ausgabedatei>", nullptr, decode)) {
+            std::cout << "Datei erfolgreich dekomprimiert.\n";
         }
-        std::ifstream inFile(args[0], std::ios::binary);
-        std::ofstream outFile(args[1], std::ios::binary);
-        if (!inFile || !outFile) {
-            std::cerr << "Fehler: Konnte Dateien nicht oeffnen.\n";
+    }
+
+    void searchFiles(const std::vector<std::string>& args) {
+        if (args.empty()) {
+            std::cout << "Verwendung: search <muster>\n";
             return;
         }
-        char ch;
-        while (inFile.get(ch)) {
-            ch = ch ^ 0x5A;
-            outFile.put(ch);
+        std::regex pattern(args[0]);
+        for (const auto& entry : fs::recursive_directory_iterator(fs::current_path())) {
+            if (std::regex_search(entry.path().string(), pattern)) {
+                std::cout << entry.path().string() << std::endl;
+            }
         }
-        std::cout << "Datei erfolgreich entschluesselt.\n";
     }
 
-    void compressFile(const std::vector<std::string>& args) {
-        if (args.size() != 2) {
-            std::cout << "Verwendung: compress <eingabedatei> <ausgabedatei>\n";
+    // Runs `command` after changes below `path` settle. Changes are collected until
+    // none arrived for the debounce interval, or at most ten intervals after the first
+    // one, so a steady stream of writes cannot hold the command back forever.
+    void watchPath(const std::vector<std::string>& args) {
+        const char* usage = "Verwendung: watch <pfad> [--recursive] [--debounce ms] -- <befehl>\n";
+        auto separator = std::find(args.begin(), args.end(), "--");
+        std::optional<std::string> target;
+        bool recursive = false;
+        int debounceMs = WATCH_DEBOUNCE_MS;
+        for (auto it = args.begin(); it != separator; ++it) {
+            if (*it == "--recursive" || *it == "-r") recursive = true;
+            else if (*it == "--debounce" && std::next(it) != separator) debounceMs = std::max(0, std::stoi(*++it));
+            else if (!target && !it->empty() && (*it)[0] != '-') target = *it;
+            else {
+                std::cout << usage;
+                return;
+            }
+        }
+        std::string command;
+        for (auto it = separator == args.end() ? separator : std::next(separator); it != args.end(); ++it) {
+            if (!command.empty()) command += ' ';
+            command += it->find(' ') == std::string::npos ? *it : "\"" + *it + "\"";
+        }
+        if (!target || command.empty()) {
+            std::cout << usage;
+            return;
+        }
+
+        std::error_code ec;
+        fs::path watched = fs::absolute(fs::u8path(*target), ec).lexically_normal();
+        bool directory = fs::is_directory(watched, ec);
+        if (!directory && !fs::exists(watched, ec)) {
+            std::cerr << "Fehler: '" << *target << "' existiert nicht.\n";
             return;
         }
-        std::ifstream inFile(args[0], std::ios::binary);
-        std::ofstream outFile(args[1], std::ios::binary);
-        if (!inFile || !outFile) {
-            std::cerr << "Fehler: Konnte Dateien nicht oeffnen.\n";
+        fs::path root = directory ? watched : watched.parent_path();
+        std::wstring onlyName = directory ? std::wstring() : watched.filename().wstring();
+        DirectoryWatcher watcher(root, recursive && directory,
+                                 FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                                 FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+        if (!watcher.isOpen()) {
+            std::cerr << "Fehler: '" << *target << "' kann nicht beobachtet werden.\n";
             return;
         }
-        
-        char current;
-        unsigned char count = 0;
-        while (inFile.get(current)) {
-            count = 1;
-            char next;
-            while (inFile.get(next) && next == current && count < 255) {
-                count++;
+
+        std::cout << "[Beobachte " << watched.u8string() << " - beliebige Taste beendet]\n" << std::flush;
+        using Clock = std::chrono::steady_clock;
+        const auto debounce = std::chrono::milliseconds(debounceMs);
+        std::map<std::wstring, DWORD> changes;
+        bool overflowed = false;
+        Clock::time_point first, last;
+        HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+        FlushConsoleInputBuffer(input);
+        ConsoleInterrupt::reset();
+
+        while (true) {
+            DWORD timeout = INFINITE;
+            if (!changes.empty() || overflowed) {
+                auto due = std::min(last + debounce, first + debounce * WATCH_MAX_DELAY_FACTOR);
+                auto now = Clock::now();
+                if (now >= due) {
+                    runWatchCommand(command, root, watched, changes, overflowed);
+                    changes.clear();
+                    overflowed = false;
+                    continue;
+                }
+                timeout = static_cast<DWORD>(std::chrono::ceil<std::chrono::milliseconds>(due - now).count());
+            }
+
+            HANDLE waits[3] = {watcher.event(), input, ConsoleInterrupt::waitHandle()};
+            DWORD count = waits[2] ? 3 : 2;
+            DWORD signaled = WaitForMultipleObjects(count, waits, FALSE, timeout);
+            if (signaled == WAIT_TIMEOUT) continue;
+            if (signaled == WAIT_OBJECT_0 + 1) {
+                if (_kbhit()) {
+                    _getch();
+                    break;
+                }
+                FlushConsoleInputBuffer(input);
+                continue;
+            }
+            if (signaled != WAIT_OBJECT_0) break;
+
+            bool hadChanges = !changes.empty() || overflowed;
+            bool overflow = false;
+            bool alive = watcher.collect([&](const WCHAR* name, size_t length, DWORD action) {
+                std::wstring path(name, length);
+                if (onlyName.empty() || _wcsicmp(path.c_str(), onlyName.c_str()) == 0) changes[path] = action;
+            }, overflow);
+            overflowed |= overflow;
+            if (!alive) {
+                std::cerr << "Fehler: Beobachtung von '" << *target << "' abgebrochen.\n";
+                break;
             }
-            outFile.put(count);
-            outFile.put(current);
-            if (next != current) {
-                inFile.putback(next);
+            if (!changes.empty() || overflowed) {
+                last = Clock::now();
+                if (!hadChanges) first = last;
             }
         }
-        std::cout << "Datei erfolgreich komprimiert.\n";
     }
 
-    void decompressFile(const std::vector<std::string>& args) {
-        if (args.size() != 2) {
-            std::cout << "Verwendung: decompress <eingabedatei> <ausgabedatei>\n";
-            return;
-        }
-        std::ifstream inFile(args[0], std::ios::binary);
-        std::ofstream outFile(args[1], std::ios::binary);
-        if (!inFile || !outFile) {
-            std::cerr << "Fehler: Konnte Dateien nicht oeffnen.\n";
-            return;
-        }
-        
-        char count, ch;
-        while (inFile.get(count) && inFile.get(ch)) {
-            for (int i = 0; i < count; i++) {
-                outFile.put(ch);
+    // Runs the watch command once per changed path when it contains "{}", otherwise
+    // once for the whole batch. Paths that no longer exist are left out. If changes
+    // were dropped, the watched path itself stands in for everything below it.
+    void runWatchCommand(const std::string& command, const fs::path& root, const fs::path& watched,
+                         const std::map<std::wstring, DWORD>& changes, bool overflowed) {
+        std::vector<fs::path> paths;
+        if (overflowed) paths.push_back(watched);
+        else {
+            for (const auto& [name, action] : changes) {
+                if (action != FILE_ACTION_REMOVED && action != FILE_ACTION_RENAMED_OLD_NAME) paths.push_back(root / name);
             }
         }
-        std::cout << "Datei erfolgreich dekomprimiert.\n";
-    }
+        if (paths.empty()) return;
 
-    void searchFiles(const std::vector<std::string>& args) {
-        if (args.empty()) {
-            std::cout << "Verwendung: search <muster>\n";
+        std::cout << "\n[" << paths.size() << " Aenderung(en)]\n";
+        if (command.find("{}") == std::string::npos) {
+            executeCommand(command);
             return;
         }
-        std::regex pattern(args[0]);
-        for (const auto& entry : fs::recursive_directory_iterator(fs::current_path())) {
-            if (std::regex_search(entry.path().string(), pattern)) {
-                std::cout << entry.path().string() << std::endl;
+        for (const auto& path : paths) {
+            std::string expanded = command;
+            std::string quoted = "\"" + path.u8string() + "\"";
+            for (size_t pos = expanded.find("{}"); pos != std::string::npos; pos = expanded.find("{}", pos + quoted.size())) {
+                expanded.replace(pos, 2, quoted);
             }
+            executeCommand(expanded);
         }
     }
 
@@ -1422,8 +9394,314 @@ private:
         system("ipconfig");
     }
 
-    void showSystemInfo() {
-        system("systeminfo");
+    static std::string formatSize(uint64_t bytes) {
+        static const char* units[] = {"B", "KB", "MB", "GB", "TB", "PB"};
+        double value = static_cast<double>(bytes);
+        size_t unit = 0;
+        while (value >= 1024.0 && unit + 1 < std::size(units)) {
+            value /= 1024.0;
+            ++unit;
+        }
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << value << " " << units[unit];
+        return out.str();
+    }
+
+    void showDiskUsage(const std::vector<std::string>& args) {
+        size_t depth = 1;
+        size_t top = 10;
+        std::string target = ".";
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "--depth" && i + 1 < args.size()) depth = std::stoul(args[++i]);
+            else if (args[i] == "--top" && i + 1 < args.size()) top = std::stoul(args[++i]);
+            else if (args[i] == "--refresh") diskUsageCache.clear();
+            else if (!args[i].empty() && args[i][0] == '-') {
+                std::cout << "Verwendung: du [pfad] [--depth N] [--top K] [--refresh]\n";
+                return;
+            } else target = args[i];
+        }
+
+        std::error_code ec;
+        fs::path root = fs::absolute(fs::u8path(target), ec).lexically_normal();
+        if (!fs::is_directory(root, ec)) {
+            std::cerr << "Fehler: '" << target << "' ist kein Verzeichnis.\n";
+            return;
+        }
+
+        DiskUsageScanner scanner(threadPool, diskUsageCache, depth, top);
+        auto start = std::chrono::steady_clock::now();
+        ConsoleInterrupt::reset();
+        auto total = scanner.scan(root, [&] {
+            if (ConsoleInterrupt::requested()) scanner.cancel();
+            std::cout << "\r  " << scanner.scannedDirectories() << " Verzeichnisse durchsucht..." << std::flush;
+        });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "\r" << std::string(60, ' ') << "\r";
+        if (ConsoleInterrupt::requested()) {
+            std::cout << "Abgebrochen.\n";
+            return;
+        }
+
+        std::ostringstream out;
+        out << std::right << std::setw(10) << "Belegt" << std::setw(12) << "Groesse" << "  Pfad\n";
+        for (const auto& line : scanner.lines()) {
+            std::string name = line.depth == 0 ? root.u8string() : line.path.filename().u8string();
+            out << std::setw(10) << formatSize(line.usage.allocated) << std::setw(12) << formatSize(line.usage.apparent)
+                << "  " << std::string(line.depth * 2, ' ') << name << "\n";
+        }
+
+        auto largest = scanner.largest();
+        if (!largest.empty()) {
+            out << "\nGroesste Eintraege:\n";
+            for (const auto& entry : largest) {
+                out << std::setw(10) << formatSize(entry.allocated) << "  "
+                    << entry.path.lexically_relative(root).u8string() << (entry.directory ? "\\" : "") << "\n";
+            }
+        }
+        for (const auto& error : scanner.errors()) {
+            out << "Fehler: " << error << "\n";
+        }
+        out << "\n" << total.files << " Dateien, " << total.directories << " Verzeichnisse in "
+            << std::fixed << std::setprecision(2) << seconds << " s (" << scanner.listedDirectories() << " gelesen, "
+            << scanner.reusedDirectories() << " aus dem Cache)\n";
+        std::string text = out.str();
+        writeOutput(text.data(), text.size());
+    }
+
+    void findDuplicates(const std::vector<std::string>& args) {
+        const char* usage = "Verwendung: dupes [pfad] [--min-size N] [--link hard|clone] [--refresh]\n";
+        uint64_t minSize = 1;
+        std::optional<DuplicateFinder::LinkMode> linkMode;
+        std::string target = ".";
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "--min-size" && i + 1 < args.size()) minSize = std::stoull(args[++i]);
+            else if (args[i] == "--link" && i + 1 < args.size()) {
+                const std::string& mode = args[++i];
+                if (mode == "hard") linkMode = DuplicateFinder::LinkMode::Hard;
+                else if (mode == "clone") linkMode = DuplicateFinder::LinkMode::Clone;
+                else {
+                    std::cout << usage;
+                    return;
+                }
+            } else if (args[i] == "--refresh") duplicateCache.clear();
+            else if (!args[i].empty() && args[i][0] == '-') {
+                std::cout << usage;
+                return;
+            } else target = args[i];
+        }
+
+        std::error_code ec;
+        fs::path root = fs::absolute(fs::u8path(target), ec).lexically_normal();
+        if (!fs::is_directory(root, ec)) {
+            std::cerr << "Fehler: '" << target << "' ist kein Verzeichnis.\n";
+            return;
+        }
+        DWORD clusterSize = 0;
+        if (linkMode == DuplicateFinder::LinkMode::Clone && (clusterSize = DuplicateFinder::cloneClusterSize(root)) == 0) {
+            std::cerr << "Fehler: Das Dateisystem von '" << target << "' unterstuetzt kein Block-Cloning.\n";
+            return;
+        }
+
+        DuplicateFinder finder(threadPool, duplicateCache, minSize);
+        auto start = std::chrono::steady_clock::now();
+        ConsoleInterrupt::reset();
+        auto groups = finder.find(root, [&] {
+            if (ConsoleInterrupt::requested()) finder.cancel();
+            std::cout << "\r  " << finder.scannedFiles() << " Dateien, "
+                      << finder.partialHashes() + finder.fullHashes() << " gehasht..." << std::flush;
+        });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "\r" << std::string(60, ' ') << "\r";
+        if (ConsoleInterrupt::requested()) {
+            std::cout << "Abgebrochen.\n";
+            return;
+        }
+
+        std::ostringstream out;
+        uint64_t reclaimable = 0;
+        size_t duplicates = 0;
+        for (const auto& group : groups) {
+            out << formatSize(group.size) << " x " << group.files.size() << "  ("
+                << formatSize(group.reclaimable()) << " freizugeben)\n";
+            for (const auto& names : group.files) {
+                out << "   ";
+                for (size_t i = 0; i < names.size(); ++i) {
+                    out << (i == 0 ? " " : " = ") << names[i].lexically_relative(root).u8string();
+                }
+                out << "\n";
+            }
+            reclaimable += group.reclaimable();
+            duplicates += group.files.size() - 1;
+        }
+        out << "\n" << groups.size() << " Gruppen, " << duplicates << " doppelte Dateien, "
+            << formatSize(reclaimable) << " freizugeben\n"
+            << finder.scannedFiles() << " Dateien in " << std::fixed << std::setprecision(2) << seconds << " s ("
+            << finder.partialHashes() << " Teil-Hashes, " << finder.fullHashes() << " volle Hashes, "
+            << finder.cacheHits() << " aus dem Cache)\n";
+        std::string text = out.str();
+        writeOutput(text.data(), text.size());
+
+        if (linkMode && !groups.empty()) {
+            uint64_t freed = finder.link(groups, *linkMode, clusterSize, [&] {
+                if (ConsoleInterrupt::requested()) finder.cancel();
+                std::cout << "\r  " << finder.linkedFiles() << " ersetzt..." << std::flush;
+            });
+            std::cout << "\r" << std::string(60, ' ') << "\r" << finder.linkedFiles() << " Dateien durch "
+                      << (*linkMode == DuplicateFinder::LinkMode::Hard ? "harte Links" : "Klone") << " ersetzt, "
+                      << formatSize(freed) << " freigegeben.\n";
+        }
+        for (const auto& error : finder.errors()) {
+            std::cerr << "Fehler: " << error << "\n";
+        }
+    }
+
+    // Columns are given by 1-based number or by header name; naming a column treats
+    // the first line as a header. Without --sep the separator is guessed from the
+    // extension and the first line.
+    void aggregateColumn(const std::vector<std::string>& args) {
+        const char* usage = "Verwendung: agg <datei> <spalte> [--group-by spalte] [--sep c]\n";
+        std::vector<std::string> positional;
+        std::optional<std::string> groupBy;
+        std::optional<char> separator;
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "--group-by" && i + 1 < args.size()) groupBy = args[++i];
+            else if (args[i] == "--sep" && i + 1 < args.size()) separator = args[++i] == "\\t" ? '\t' : args[i][0];
+            else positional.push_back(args[i]);
+        }
+        if (positional.size() != 2) {
+            std::cout << usage;
+            return;
+        }
+
+        MappedFile mapped(fs::u8path(positional[0]));
+        if (!mapped.isOpen()) {
+            std::cerr << "Fehler: Konnte Datei '" << positional[0] << "' nicht lesen.\n";
+            return;
+        }
+        const char* data = mapped.data();
+        uint64_t size = mapped.size();
+        const char* headerEnd = static_cast<const char*>(std::memchr(data, '\n', static_cast<size_t>(size)));
+        std::string_view header(data, headerEnd ? static_cast<size_t>(headerEnd - data) : static_cast<size_t>(size));
+        if (!separator) {
+            auto has = [&](char c) { return header.find(c) != std::string_view::npos; };
+            if (fs::u8path(positional[0]).extension() == ".tsv" || (has('\t') && !has(','))) separator = '\t';
+            else if (has(';') && !has(',')) separator = ';';
+            else separator = ',';
+        }
+
+        bool skipHeader = false;
+        auto resolve = [&](const std::string& spec) -> std::optional<size_t> {
+            if (!spec.empty() && std::all_of(spec.begin(), spec.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+                size_t number = std::stoul(spec);
+                if (number > 0) return number - 1;
+            }
+            size_t index = 0;
+            for (size_t start = 0; start <= header.size(); ++index) {
+                size_t stop = std::min(header.find(*separator, start), header.size());
+                std::string_view name = header.substr(start, stop - start);
+                while (!name.empty() && (name.back() == '\r' || name.back() == ' ' || name.back() == '"')) name.remove_suffix(1);
+                while (!name.empty() && (name.front() == ' ' || name.front() == '"')) name.remove_prefix(1);
+                if (name == spec) {
+                    skipHeader = true;
+                    return index;
+                }
+                start = stop + 1;
+            }
+            std::cerr << "Fehler: Spalte '" << spec << "' nicht gefunden.\n";
+            return std::nullopt;
+        };
+        auto valueColumn = resolve(positional[1]);
+        if (!valueColumn) return;
+        std::optional<size_t> groupColumn;
+        if (groupBy && !(groupColumn = resolve(*groupBy))) return;
+
+        ColumnAggregator aggregator(threadPool, data, size, *separator);
+        auto start = std::chrono::steady_clock::now();
+        ConsoleInterrupt::reset();
+        auto groups = aggregator.run(*valueColumn, groupColumn, skipHeader, [&] {
+            if (ConsoleInterrupt::requested()) aggregator.cancel();
+            std::cout << "\r  " << formatSize(aggregator.scannedBytes()) << " gelesen..." << std::flush;
+        });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "\r" << std::string(40, ' ') << "\r";
+        if (ConsoleInterrupt::requested()) {
+            std::cout << "Abgebrochen.\n";
+            return;
+        }
+
+        std::ostringstream out;
+        out << std::setprecision(6);
+        if (!groupColumn) {
+            const auto& summary = groups[""];
+            if (summary.count == 0) {
+                out << "Keine Zahlen in Spalte '" << positional[1] << "' gefunden.\n";
+            } else {
+                out << std::left << std::setw(12) << "Anzahl:" << summary.count << "\n"
+                    << std::setw(12) << "Summe:" << formatNumber(summary.sum) << "\n"
+                    << std::setw(12) << "Minimum:" << formatNumber(summary.min) << "\n"
+                    << std::setw(12) << "Maximum:" << formatNumber(summary.max) << "\n"
+                    << std::setw(12) << "Mittelwert:" << formatNumber(summary.sum / static_cast<double>(summary.count)) << "\n"
+                    << std::setw(12) << "p50:" << summary.sketch.quantile(0.5) << "\n"
+                    << std::setw(12) << "p90:" << summary.sketch.quantile(0.9) << "\n"
+                    << std::setw(12) << "p99:" << summary.sketch.quantile(0.99) << "\n";
+            }
+        } else {
+            size_t keyWidth = 6;
+            for (const auto& entry : groups) keyWidth = std::max(keyWidth, entry.first.size());
+            out << std::left << std::setw(static_cast<int>(keyWidth)) << "Gruppe" << std::right;
+            for (const char* title : {"Anzahl", "Summe", "Min", "Max", "Mittel", "p50", "p90", "p99"}) out << std::setw(13) << title;
+            out << "\n";
+            for (const auto& [key, summary] : groups) {
+                out << std::left << std::setw(static_cast<int>(keyWidth)) << key << std::right << std::setw(13) << summary.count
+                    << std::setw(13) << summary.sum << std::setw(13) << summary.min << std::setw(13) << summary.max
+                    << std::setw(13) << summary.sum / static_cast<double>(summary.count) << std::setw(13)
+                    << summary.sketch.quantile(0.5) << std::setw(13) << summary.sketch.quantile(0.9) << std::setw(13)
+                    << summary.sketch.quantile(0.99) << "\n";
+            }
+            out << groups.size() << " Gruppen\n";
+        }
+        if (aggregator.skippedRows() > 0) out << "(" << aggregator.skippedRows() << " Zeilen ohne Zahl uebersprungen)\n";
+        out << "(Perzentile auf 1 % genau; " << formatSize(size) << " in " << std::fixed << std::setprecision(2) << seconds << " s)\n";
+        std::string text = out.str();
+        writeOutput(text.data(), text.size());
+    }
+
+    void showSystemInfo(const std::vector<std::string>& args) {
+        if (args.size() == 2 && args[0] == "--interval") {
+            int intervalMs = std::stoi(args[1]);
+            statsSampler.setInterval(std::chrono::milliseconds(intervalMs));
+            settings["sysinfo.interval_ms"] = std::to_string(statsSampler.getInterval().count());
+            saveSettings();
+            std::cout << "Abtastintervall: " << statsSampler.getInterval().count() << " ms\n";
+            return;
+        }
+
+        SystemSnapshot stats = statsSampler.snapshot();
+        auto mebibytes = [](ULONGLONG bytes) { return std::to_string(bytes / (1024 * 1024)) + " MB"; };
+        auto rate = [](double bytesPerSecond) {
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(1) << bytesPerSecond / 1024.0 << " KB/s";
+            return out.str();
+        };
+
+        std::ostringstream out;
+        out << std::left;
+        out << std::setw(22) << "Computername:" << statsSampler.getComputerName() << "\n";
+        out << std::setw(22) << "Prozessoren:" << statsSampler.getProcessorCount() << "\n";
+        out << std::setw(22) << "Betriebszeit:" << stats.uptimeSeconds / 86400 << "d "
+            << (stats.uptimeSeconds / 3600) % 24 << "h " << (stats.uptimeSeconds / 60) % 60 << "m\n";
+        out << std::setw(22) << "CPU-Auslastung:" << std::fixed << std::setprecision(1) << stats.cpuPercent << " %\n";
+        out << std::setw(22) << "Arbeitsspeicher:" << mebibytes(stats.totalPhysical - stats.availablePhysical)
+            << " / " << mebibytes(stats.totalPhysical) << " (" << stats.memoryLoad << " %)\n";
+        out << std::setw(22) << "Auslagerung:" << mebibytes(stats.totalPageFile - stats.availablePageFile)
+            << " / " << mebibytes(stats.totalPageFile) << "\n";
+        out << std::setw(22) << "Prozesse/Threads:" << stats.processCount << " / " << stats.threadCount
+            << " (" << stats.handleCount << " Handles)\n";
+        out << std::setw(22) << "Datentraeger:" << "lesen " << rate(stats.diskReadPerSecond)
+            << ", schreiben " << rate(stats.diskWritePerSecond) << "\n";
+        out << std::setw(22) << "Netzwerk:" << "empfangen " << rate(stats.networkReceivePerSecond)
+            << ", senden " << rate(stats.networkSendPerSecond) << "\n";
+        std::cout << out.str();
     }
 
     void showWeather(const std::vector<std::string>& args) {
@@ -1436,164 +9714,548 @@ private:
         std::cout << "Wetterabfrage-Funktionalitaet noch nicht vollstaendig implementiert.\n";
     }
 
+    static std::string formatNumber(double value) {
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, 15);
+        return std::string(buffer, result.ptr);
+    }
+
+    // Binds each variable of `expression` to a stored value; `column`, if given,
+    // supplies the values of x row by row.
+    bool bindMathInputs(const MathExpression& expression, const double* column,
+                        std::vector<MathExpression::Input>& inputs) {
+        for (const auto& name : expression.variables()) {
+            if (column && name == "x") {
+                inputs.push_back(MathExpression::Input{column, true});
+                continue;
+            }
+            auto it = mathVariables.find(name);
+            if (it == mathVariables.end()) {
+                std::cerr << "Fehler: Unbekannte Variable: " << name << ".\n";
+                return false;
+            }
+            inputs.push_back(MathExpression::Input{&it->second, false});
+        }
+        return true;
+    }
+
+    // Expressions are compiled once per source text. `name = expr` stores a variable
+    // for later expressions; --over evaluates the expression for every number in a
+    // column of a file, bound to x.
     void performMathOperation(const std::vector<std::string>& args) {
-        if (args.size() < 3) {
-            std::cout << "Verwendung: math <zahl1> <operator> <zahl2>\n";
+        std::optional<std::string> over;
+        size_t column = 1;
+        std::optional<char> separator;
+        std::string source;
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "--over" && i + 1 < args.size()) over = args[++i];
+            else if (args[i] == "--col" && i + 1 < args.size()) column = std::stoul(args[++i]);
+            else if (args[i] == "--sep" && i + 1 < args.size()) separator = args[++i] == "\\t" ? '\t' : args[i][0];
+            else source += (source.empty() ? "" : " ") + args[i];
+        }
+        if (source.empty() || column == 0) {
+            std::cout << "Verwendung: math <ausdruck> | math <name> = <ausdruck> | "
+                      << "math --over <datei> <ausdruck> [--col N] [--sep c]\n";
             return;
         }
-        
-        double num1 = std::stod(args[0]);
-        double num2 = std::stod(args[2]);
-        std::string op = args[1];
-
-        double result;
-        if (op == "+") result = num1 + num2;
-        else if (op == "-") result = num1 - num2;
-        else if (op == "*") result = num1 * num2;
-        else if (op == "/") {
-            if (num2 == 0) {
-                std::cout << "Fehler: Division durch Null!\n";
+        if (over) {
+            char defaultSeparator = fs::u8path(*over).extension() == ".tsv" ? '\t' : ',';
+            evaluateOver(*over, source, column, separator.value_or(defaultSeparator));
+            return;
+        }
+
+        std::string target;
+        if (size_t equals = source.find('='); equals != std::string::npos) {
+            std::istringstream left(source.substr(0, equals));
+            left >> target;
+            bool valid = !target.empty() && (std::isalpha(static_cast<unsigned char>(target[0])) || target[0] == '_') &&
+                         std::all_of(target.begin(), target.end(),
+                                     [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; });
+            std::string rest;
+            if (!valid || left >> rest) {
+                std::cerr << "Fehler: Ungueltiger Variablenname.\n";
                 return;
             }
-            result = num1 / num2;
+            source = source.substr(equals + 1);
         }
-        else {
-            std::cout << "Ungueltige Operation.\n";
+
+        std::string error;
+        auto expression = mathCache.get(source, error);
+        if (!expression) {
+            std::cerr << "Fehler: " << error << ".\n";
+            return;
+        }
+        std::vector<MathExpression::Input> inputs;
+        if (!bindMathInputs(*expression, nullptr, inputs)) return;
+        double result = 0;
+        expression->evaluate(inputs.data(), 1, &result);
+        if (!std::isfinite(result)) {
+            std::cerr << "Fehler: Ergebnis ist nicht definiert (Division durch Null?).\n";
+            return;
+        }
+        if (!target.empty()) {
+            mathVariables[target] = result;
+            std::cout << target << " = " << formatNumber(result) << "\n";
+        } else {
+            std::cout << "Ergebnis: " << formatNumber(result) << "\n";
+        }
+    }
+
+    // Parses the column straight from the mapped file, evaluates it in batches of
+    // MathExpression::BATCH rows and formats the results into one output buffer.
+    // Lines whose field is not a number are skipped and counted.
+    void evaluateOver(const std::string& file, const std::string& source, size_t column, char separator) {
+        std::string error;
+        auto expression = mathCache.get(source, error);
+        if (!expression) {
+            std::cerr << "Fehler: " << error << ".\n";
+            return;
+        }
+        std::vector<double> values(MathExpression::BATCH);
+        std::vector<double> results(MathExpression::BATCH);
+        std::vector<MathExpression::Input> inputs;
+        if (!bindMathInputs(*expression, values.data(), inputs)) return;
+        MappedFile mapped(fs::u8path(file));
+        if (!mapped.isOpen()) {
+            std::cerr << "Fehler: Konnte Datei '" << file << "' nicht lesen.\n";
             return;
         }
 
-        std::cout << "Ergebnis: " << result << std::endl;
+        std::string out;
+        size_t rows = 0;
+        uint64_t skipped = 0;
+        auto flush = [&] {
+            expression->evaluate(inputs.data(), rows, results.data());
+            for (size_t i = 0; i < rows; ++i) {
+                char buffer[32];
+                auto result = std::to_chars(buffer, buffer + sizeof(buffer), results[i], std::chars_format::general, 15);
+                out.append(buffer, result.ptr);
+                out += '\n';
+            }
+            rows = 0;
+            if (out.size() >= OUTPUT_SLICE) {
+                writeOutput(out.data(), out.size());
+                out.clear();
+            }
+        };
+
+        const char* p = mapped.data();
+        const char* end = p + mapped.size();
+        ConsoleInterrupt::reset();
+        while (p < end && !ConsoleInterrupt::requested()) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+            if (!lineEnd) lineEnd = end;
+            const char* field = p;
+            for (size_t c = 1; c < column && field; ++c) {
+                field = static_cast<const char*>(std::memchr(field, separator, static_cast<size_t>(lineEnd - field)));
+                if (field) ++field;
+            }
+            bool parsed = false;
+            if (field) {
+                const char* fieldEnd = static_cast<const char*>(std::memchr(field, separator, static_cast<size_t>(lineEnd - field)));
+                if (!fieldEnd) fieldEnd = lineEnd;
+                while (field < fieldEnd && *field == ' ') ++field;
+                auto [next, ec] = std::from_chars(field, fieldEnd, values[rows]);
+                while (next < fieldEnd && (*next == ' ' || *next == '\r')) ++next;
+                parsed = ec == std::errc() && next == fieldEnd;
+            }
+            if (!parsed) ++skipped;
+            else if (++rows == MathExpression::BATCH) flush();
+            p = lineEnd + 1;
+        }
+        if (rows > 0) flush();
+        writeOutput(out.data(), out.size());
+        if (skipped > 0) std::cout << "(" << skipped << " Zeilen ohne Zahl uebersprungen)\n";
+        if (ConsoleInterrupt::requested()) std::cout << "\nAbgebrochen.\n";
     }
 
     void sortItems(const std::vector<std::string>& args) {
         if (args.empty()) {
-            std::cout << "Verwendung: sort <item1> <item2> ...\n";
+            std::cout << "Verwendung: sort [-n] [-u] <item1> <item2> ... | sort --file <datei> [--out datei] [-k spalte] [-n] [-u]\n";
             return;
         }
+        if (std::find(args.begin(), args.end(), "--file") != args.end()) {
+            sortFile(args);
+            return;
+        }
+
+        struct Item {
+            uint64_t key;
+            std::string_view text;
+        };
+        bool numeric = false;
+        bool unique = false;
+        std::vector<Item> items;
+        for (const auto& arg : args) {
+            if (arg == "-n") numeric = true;
+            else if (arg == "-u") unique = true;
+            else items.push_back(Item{0, arg});
+        }
 
-        std::vector<std::string> items = args;
-        std::sort(items.begin(), items.end());
+        auto byText = [](const Item& a, const Item& b) { return a.text < b.text; };
+        if (numeric) {
+            for (auto& item : items) {
+                const char* begin = item.text.data();
+                const char* end = begin + item.text.size();
+                if (begin < end && *begin == '+') ++begin;
+                double value = 0;
+                std::from_chars(begin, end, value);
+                item.key = RadixSort::orderedKey(value);
+            }
+            if (items.size() < RadixSort::THRESHOLD) {
+                std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+                    return a.key != b.key ? a.key < b.key : a.text < b.text;
+                });
+            } else {
+                RadixSort::sortKeys(items.data(), items.size(), [](const Item& item) { return item.key; },
+                                    [&](Item* first, size_t count) { std::sort(first, first + count, byText); }, &threadPool);
+            }
+        } else if (items.size() < RadixSort::THRESHOLD) {
+            std::sort(items.begin(), items.end(), byText);
+        } else {
+            RadixSort::sortStrings(items.data(), items.size(), [](const Item& item, size_t depth) -> unsigned {
+                return depth < item.text.size() ? static_cast<unsigned char>(item.text[depth]) + 1u : 0;
+            }, [](Item*, size_t) {}, &threadPool);
+        }
+        if (unique) {
+            items.erase(std::unique(items.begin(), items.end(), [numeric](const Item& a, const Item& b) {
+                return numeric ? a.key == b.key : a.text == b.text;
+            }), items.end());
+        }
 
-        std::cout << "Sortierte Elemente:\n";
+        std::string out = "Sortierte Elemente:\n";
         for (const auto& item : items) {
-            std::cout << item << " ";
+            out.append(item.text);
+            out += ' ';
         }
-        std::cout << std::endl;
+        out += '\n';
+        writeOutput(out.data(), out.size());
     }
 
-    void base64Operation(const std::vector<std::string>& args) {
-        if (args.size() < 2) {
-            std::cout << "Verwendung: base64 <encode|decode> <text>\n";
+    void sortFile(const std::vector<std::string>& args) {
+        const char* usage = "Verwendung: sort --file <datei> [--out datei] [-k spalte] [-n] [-u] [--memory MB] [--temp verzeichnis]\n";
+        ExternalSorter::Options options;
+        options.memoryBudget = ExternalSorter::defaultBudget();
+        std::string input;
+        std::optional<std::string> output;
+        try {
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (args[i] == "--file" && i + 1 < args.size()) input = args[++i];
+                else if (args[i] == "--out" && i + 1 < args.size()) output = args[++i];
+                else if (args[i] == "-k" && i + 1 < args.size()) options.keyField = std::stoul(args[++i]);
+                else if (args[i] == "-n") options.numeric = true;
+                else if (args[i] == "-u") options.unique = true;
+                else if (args[i] == "--memory" && i + 1 < args.size()) options.memoryBudget = std::stoull(args[++i]) * 1024 * 1024;
+                else if (args[i] == "--temp" && i + 1 < args.size()) options.temporaryDirectory = fs::u8path(args[++i]);
+                else throw std::invalid_argument(args[i]);
+            }
+        } catch (const std::exception&) {
+            std::cout << usage;
+            return;
+        }
+        if (input.empty()) {
+            std::cout << usage;
             return;
         }
+        if (output && options.temporaryDirectory.empty()) {
+            options.temporaryDirectory = fs::absolute(fs::u8path(*output)).parent_path();
+        }
 
-        std::string operation = args[0];
-        std::string input = args[1];
+        // The result is written under a temporary name next to the output and renamed
+        // over it only once sorting succeeded, so sorting a file onto itself never
+        // loses the input when it fails or is cancelled.
+        HANDLE file = INVALID_HANDLE_VALUE;
+        fs::path temporary;
+        if (output) {
+            temporary = fs::u8path(*output);
+            temporary += L".sort~";
+            file = CreateFileW(temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                               FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                std::cerr << "Fehler: Ausgabe '" << *output << "' konnte nicht angelegt werden.\n";
+                return;
+            }
+        }
+        ExternalSorter::Sink sink = [&](const char* data, size_t size) {
+            if (!output) {
+                writeOutput(data, size);
+                return true;
+            }
+            while (size > 0) {
+                DWORD slice = static_cast<DWORD>(std::min<size_t>(size, OUTPUT_SLICE));
+                DWORD written = 0;
+                if (!WriteFile(file, data, slice, &written, nullptr) || written != slice) return false;
+                data += slice;
+                size -= slice;
+            }
+            return true;
+        };
 
-        if (operation == "encode") {
-            std::cout << "Base64-Kodierung: " << base64_encode(input) << std::endl;
-        } else if (operation == "decode") {
-            std::cout << "Base64-Dekodierung: " << base64_decode(input) << std::endl;
-        } else {
-            std::cout << "Ungueltige Operation. Verwenden Sie 'encode' oder 'decode'.\n";
+        ExternalSorter sorter(threadPool, options);
+        auto start = std::chrono::steady_clock::now();
+        std::string error;
+        ConsoleInterrupt::reset();
+        bool ok = sorter.sort(fs::u8path(input), sink, error, [&] {
+            if (ConsoleInterrupt::requested()) sorter.cancel();
+            if (!output) return;
+            std::cout << "\r  " << formatSize(sorter.readBytes()) << " gelesen, " << sorter.runCount() << " Laeufe, "
+                      << formatSize(sorter.mergedBytes()) << " zusammengefuehrt..." << std::flush;
+        });
+        if (output) {
+            std::cout << "\r" << std::string(70, ' ') << "\r";
+            CloseHandle(file);
+            if (ok && !MoveFileExW(temporary.c_str(), fs::u8path(*output).c_str(), MOVEFILE_REPLACE_EXISTING)) {
+                ok = false;
+                error = "Ausgabe '" + *output + "' konnte nicht ersetzt werden";
+            }
+            if (!ok) DeleteFileW(temporary.c_str());
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (ConsoleInterrupt::requested()) {
+            std::cout << "Abgebrochen.\n";
+        } else if (!ok) {
+            std::cerr << "Fehler: " << error << ".\n";
+        } else if (output) {
+            std::cout << formatSize(sorter.readBytes()) << " sortiert in " << std::fixed << std::setprecision(2) << seconds
+                      << std::defaultfloat << " s (" << std::max<size_t>(sorter.runCount(), 1) << " Laeufe) -> " << *output << "\n";
         }
     }
 
-    void hashString(const std::vector<std::string>& args) {
-        if (args.empty()) {
-            std::cout << "Verwendung: hash <text>\n";
+    void base64Operation(const std::vector<std::string>& args) {
+        const char* usage = "base64 <encode|decode> <text> | base64 <encode|decode> --file <eingabedatei> <ausgabedatei>";
+        if (args.size() < 2) {
+            std::cout << "Verwendung: " << usage << "\n";
+            return;
+        }
+        const std::string& operation = args[0];
+        if (operation != "encode" && operation != "decode") {
+            std::cout << "Ungueltige Operation. Verwenden Sie 'encode' oder 'decode'.\n";
+            return;
+        }
+        if (args[1] == "--file") {
+            std::vector<std::string> files(args.begin() + 2, args.end());
+            if (operation == "encode") base64EncodeFile(files, usage);
+            else base64DecodeFile(files, usage);
             return;
         }
 
-        std::string input = args[0];
-        std::size_t hash = std::hash<std::string>{}(input);
-        std::cout << "Hash-Wert: " << hash << std::endl;
+        // All remaining arguments form the text. Spaces between them are part of the
+        // text to encode, but not of base64 data, so encoded text split across
+        // arguments is joined without them.
+        std::string input = args[1];
+        for (size_t i = 2; i < args.size(); ++i) {
+            if (operation == "encode") input += ' ';
+            input += args[i];
+        }
+        if (operation == "encode") {
+            std::string encoded(Base64::encodedSize(input.size()), '\0');
+            Base64::encode(reinterpret_cast<const uint8_t*>(input.data()), input.size(), encoded.data());
+            std::cout << "Base64-Kodierung: " << encoded << "\n";
+            return;
+        }
+        std::string decoded(Base64::decodedCapacity(input.size()), '\0');
+        size_t errorAt = 0;
+        auto written = Base64::decode(input.data(), input.size(), reinterpret_cast<uint8_t*>(decoded.data()), errorAt);
+        if (!written) {
+            std::cerr << "Fehler: Ungueltiges Base64 an Position " << errorAt << ".\n";
+            return;
+        }
+        decoded.resize(*written);
+        std::cout << "Base64-Dekodierung: " << decoded << "\n";
     }
 
-    static std::string base64_encode(const std::string& input) {
-        static const std::string base64_chars = 
-            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-            "abcdefghijklmnopqrstuvwxyz"
-            "0123456789+/";
-
-        std::string encoded;
-        int i = 0;
-        int j = 0;
-        unsigned char char_array_3[3];
-        unsigned char char_array_4[4];
-
-        for (char c : input) {
-            char_array_3[i++] = c;
-            if (i == 3) {
-                char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-                char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-                char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-                char_array_4[3] = char_array_3[2] & 0x3f;
-
-                for (i = 0; i < 4; i++)
-                    encoded += base64_chars[char_array_4[i]];
-                i = 0;
+    // Encodes block by block into the output buffer; up to two bytes that do not fill
+    // a 3-byte group are carried into the next block.
+    void base64EncodeFile(const std::vector<std::string>& files, const char* usage) {
+        uint8_t carry[3];
+        size_t carried = 0;
+        auto encode = [&](const char* data, size_t size, bool last, std::vector<char>& out) {
+            const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+            size_t start = out.size();
+            out.resize(start + Base64::encodedSize(carried + size));
+            char* target = out.data() + start;
+            while (carried > 0 && carried < 3 && size > 0) {
+                carry[carried++] = *in++;
+                --size;
             }
+            if (carried == 3) {
+                Base64::encode(carry, 3, target);
+                target += 4;
+                carried = 0;
+            }
+            size_t whole = last ? size : size / 3 * 3;
+            Base64::encode(in, whole, target);
+            target += Base64::encodedSize(whole);
+            std::memcpy(carry + carried, in + whole, size - whole);
+            carried += size - whole;
+            if (last && carried > 0) {
+                Base64::encode(carry, carried, target);
+                target += Base64::encodedSize(carried);
+                carried = 0;
+            }
+            out.resize(static_cast<size_t>(target - out.data()));
+        };
+        if (streamFile(files, usage, [](uint64_t size) { return (size + 2) / 3 * 4; }, encode)) {
+            std::cout << "Datei erfolgreich kodiert.\n";
         }
+    }
 
-        if (i) {
-            for (j = i; j < 3; j++)
-                char_array_3[j] = '\0';
-
-            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+    // Decodes the text between line breaks; CR and LF are the only bytes skipped.
+    // Up to three characters of an unfinished quantum are carried into the next line
+    // or block, with their file positions for error messages. Nothing may follow the
+    // padded quantum.
+    void base64DecodeFile(const std::vector<std::string>& files, const char* usage) {
+        char carry[4];
+        uint64_t carryAt[4];
+        size_t carried = 0;
+        uint64_t position = 0;
+        bool padded = false;
+        std::optional<uint64_t> error;
+
+        auto decodeRun = [&](const char* run, size_t size, uint64_t at, std::vector<char>& out) {
+            size_t start = out.size();
+            out.resize(start + Base64::decodedCapacity(carried + size));
+            uint8_t* target = reinterpret_cast<uint8_t*>(out.data() + start);
+            size_t used = 0;
+            size_t errorAt = 0;
+            if (carried > 0) {
+                for (; carried < 4 && used < size; ++used) {
+                    carryAt[carried] = at + used;
+                    carry[carried++] = run[used];
+                }
+                if (carried == 4) {
+                    auto written = Base64::decode(carry, 4, target, errorAt);
+                    if (!written) error = carryAt[errorAt];
+                    else target += *written;
+                    padded = carry[3] == '=';
+                    carried = 0;
+                }
+            }
+            size_t whole = (size - used) / 4 * 4;
+            if (!error && whole > 0) {
+                if (padded) {
+                    error = at + used;
+                } else if (auto written = Base64::decode(run + used, whole, target, errorAt)) {
+                    target += *written;
+                    padded = run[used + whole - 1] == '=';
+                } else {
+                    error = at + used + errorAt;
+                }
+            }
+            used += whole;
+            if (!error && used < size) {
+                if (padded) error = at + used;
+                for (; used < size; ++used) {
+                    carryAt[carried] = at + used;
+                    carry[carried++] = run[used];
+                }
+            }
+            out.resize(static_cast<size_t>(reinterpret_cast<char*>(target) - out.data()));
+        };
 
-            for (j = 0; j < i + 1; j++)
-                encoded += base64_chars[char_array_4[j]];
+        auto decode = [&](const char* data, size_t size, bool last, std::vector<char>& out) {
+            for (size_t i = 0; i < size && !error;) {
+                if (data[i] == '\n' || data[i] == '\r') {
+                    ++i;
+                    continue;
+                }
+                const void* lineFeed = std::memchr(data + i, '\n', size - i);
+                size_t end = lineFeed ? static_cast<size_t>(static_cast<const char*>(lineFeed) - data) : size;
+                if (const void* carriageReturn = std::memchr(data + i, '\r', end - i)) {
+                    end = static_cast<size_t>(static_cast<const char*>(carriageReturn) - data);
+                }
+                decodeRun(data + i, end - i, position + i, out);
+                i = end;
+            }
+            position += size;
+            if (last && !error && carried > 0) error = position;
+        };
 
-            while (i++ < 3)
-                encoded += '=';
+        bool ok = streamFile(files, usage, nullptr, decode);
+        if (ok && error) {
+            std::error_code ec;
+            fs::remove(fs::u8path(files[1]), ec);
+            std::cerr << "Fehler: Ungueltiges Base64 an Position " << *error << ".\n";
+            return;
         }
-
-        return encoded;
+        if (ok) std::cout << "Datei erfolgreich dekodiert.\n";
     }
 
-    static std::string base64_decode(const std::string& encoded_string) {
-        static const std::string base64_chars = 
-            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-            "abcdefghijklmnopqrstuvwxyz"
-            "0123456789+/";
-
-        int in_len = encoded_string.size();
-        int i = 0;
-        int j = 0;
-        int in_ = 0;
-        unsigned char char_array_4[4], char_array_3[3];
-        std::string decoded;
+    static std::string toHex(const uint8_t* bytes, size_t size) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex(size * 2, '0');
+        for (size_t i = 0; i < size; ++i) {
+            hex[2 * i] = digits[bytes[i] >> 4];
+            hex[2 * i + 1] = digits[bytes[i] & 0x0F];
+        }
+        return hex;
+    }
 
-        while (in_len-- && (encoded_string[in_] != '=') && (isalnum(encoded_string[in_]) || (encoded_string[in_] == '+') || (encoded_string[in_] == '/'))) {
-            char_array_4[i++] = encoded_string[in_]; in_++;
-            if (i == 4) {
-                for (i = 0; i < 4; i++)
-                    char_array_4[i] = base64_chars.find(char_array_4[i]);
+    std::optional<std::string> digest(const std::string& algorithm, const uint8_t* data, size_t size,
+                                      MappedPrefetch* prefetch) {
+        if (algorithm == "xxh3") {
+            uint64_t value = Xxh3::hash(data, size, prefetch);
+            uint8_t canonical[8];
+            for (int i = 0; i < 8; ++i) canonical[i] = static_cast<uint8_t>(value >> (56 - 8 * i));
+            return toHex(canonical, sizeof(canonical));
+        }
+        if (algorithm == "sha256") {
+            Sha256 sha;
+            if (size > 0) sha.update(data, size, prefetch);
+            auto result = sha.finish();
+            return toHex(result.data(), result.size());
+        }
+        if (algorithm == "blake3") {
+            auto result = Blake3::hash(data, size, &threadPool);
+            return toHex(result.data(), result.size());
+        }
+        return std::nullopt;
+    }
 
-                char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-                char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-                char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+    void hashString(const std::vector<std::string>& args) {
+        std::string algorithm = "xxh3";
+        std::optional<std::string> file;
+        std::string text;
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "--algo" && i + 1 < args.size()) algorithm = args[++i];
+            else if (args[i] == "--file" && i + 1 < args.size()) file = args[++i];
+            else text += (text.empty() ? "" : " ") + args[i];
+        }
+        if (!file && text.empty()) {
+            std::cout << "Verwendung: hash <text> | hash --file <pfad> [--algo xxh3|sha256|blake3]\n";
+            return;
+        }
 
-                for (i = 0; i < 3; i++)
-                    decoded += char_array_3[i];
-                i = 0;
+        if (!file) {
+            auto value = digest(algorithm, reinterpret_cast<const uint8_t*>(text.data()), text.size(), nullptr);
+            if (!value) {
+                std::cout << "Unbekannter Algorithmus: " << algorithm << "\n";
+                return;
             }
+            std::cout << "Hash-Wert (" << algorithm << "): " << *value << std::endl;
+            return;
         }
 
-        if (i) {
-            for (j = 0; j < i; j++)
-                char_array_4[j] = base64_chars.find(char_array_4[j]);
-
-            char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-            char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-
-            for (j = 0; j < i - 1; j++) decoded += char_array_3[j];
+        MappedFile mapped(fs::u8path(*file));
+        if (!mapped.isOpen()) {
+            std::cerr << "Fehler: Konnte Datei '" << *file << "' nicht lesen.\n";
+            return;
+        }
+        MappedPrefetch prefetch(mapped.data(), mapped.size());
+        auto start = std::chrono::steady_clock::now();
+        auto value = digest(algorithm, reinterpret_cast<const uint8_t*>(mapped.data()),
+                            static_cast<size_t>(mapped.size()), &prefetch);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!value) {
+            std::cout << "Unbekannter Algorithmus: " << algorithm << "\n";
+            return;
+        }
+        std::cout << *value << "  " << *file << "\n";
+        if (mapped.size() >= MappedPrefetch::WINDOW) {
+            double megabytes = mapped.size() / (1024.0 * 1024.0);
+            std::cout << std::fixed << std::setprecision(1) << megabytes << " MB in " << std::setprecision(2)
+                      << seconds << " s (" << std::setprecision(0) << megabytes / seconds << " MB/s)\n";
         }
-
-        return decoded;
     }
 
     void runBenchmark() {
@@ -1679,47 +10341,12 @@ private:
         std::vector<std::string>& commandHistory;
         size_t& historyIndex;
         TerminalUI& ui;
+        TabCompleter& completer;
 
         void handleBackspace(std::string& input, size_t& cursorPos) {
             if (!input.empty() && cursorPos > 0) {
                 input.erase(--cursorPos, 1);
-                std::cout << "\b \b";
-            }
-        }
-
-        void handleAutoComplete(std::string& input, size_t& cursorPos) {
-            std::string prefix = input.substr(0, cursorPos);
-            std::vector<std::string> matches;
-            
-            
-            for (const auto& [name, cmd] : commands) {
-                if (name.find(prefix) == 0) {
-                    matches.push_back(name);
-                }
-                
-                auto cmdCompletions = cmd->getCompletions(prefix);
-                matches.insert(matches.end(), cmdCompletions.begin(), cmdCompletions.end());
-            }
-
-            if (matches.empty()) {
-                return;
-            }
-
-            if (matches.size() == 1) {
-                
-                input = matches[0];
-                cursorPos = input.length();
-                redrawLine(input);
-            } else {
-                
-                std::string commonPrefix = findCommonPrefix(matches);
-                if (commonPrefix.length() > prefix.length()) {
-                    input = commonPrefix + input.substr(cursorPos);
-                    cursorPos = commonPrefix.length();
-                    redrawLine(input);
-                }
-                
-                showCompletions(matches);
+                ui.updatePromptInput(input, cursorPos);
             }
         }
 
@@ -1728,11 +10355,13 @@ private:
             const std::map<std::string, std::unique_ptr<Command>>& cmds,
             std::vector<std::string>& history,
             size_t& hIndex,
-            TerminalUI& terminalUI
+            TerminalUI& terminalUI,
+            TabCompleter& tabCompleter
         ) : commands(cmds),
             commandHistory(history),
             historyIndex(hIndex),
-            ui(terminalUI) {}
+            ui(terminalUI),
+            completer(tabCompleter) {}
         
         std::string getInput() {
             std::string input;
@@ -1741,33 +10370,29 @@ private:
             
             while ((ch = _getch()) != 13) {  
                 if (ch == '\t') {  
-                    handleAutoComplete(input, cursorPos);
+                    ui.completeInput(completer, input, cursorPos);
                 } else if (ch == 8) {  
                     handleBackspace(input, cursorPos);
                 } else if (ch == 224) {  
                     ch = _getch();
                     if (ch == 72) {  
                         if (!commandHistory.empty() && historyIndex < commandHistory.size() - 1) {
-                            std::cout << "\r" << std::string(input.length() + 3, ' ');
                             input = commandHistory[++historyIndex];
                             cursorPos = input.length();
-                            ui.drawPrompt(fs::current_path().string());
-                            std::cout << input;
+                            redrawLine(input);
                         }
                     }
                     else if (ch == 80) {  
                         if (historyIndex > 0) {
-                            std::cout << "\r" << std::string(input.length() + 3, ' ');
                             input = commandHistory[--historyIndex];
                             cursorPos = input.length();
-                            ui.drawPrompt(fs::current_path().string());
-                            std::cout << input;
+                            redrawLine(input);
                         }
                     }
                 }
                 else if (ch >= 32 && ch <= 126) {  
                     input.insert(cursorPos++, 1, (char)ch);
-                    std::cout << (char)ch;
+                    ui.updatePromptInput(input, cursorPos);
                 }
             }
             
@@ -1775,42 +10400,8 @@ private:
         }
 
     private:
-        void showCompletions(const std::vector<std::string>& completions) {
-            std::cout << "\n";
-            size_t maxLength = 0;
-            for (const auto& c : completions) {
-                maxLength = std::max(maxLength, c.length());
-            }
-
-            size_t columns = std::max(size_t{1}, 80 / (maxLength + 2));
-            size_t col = 0;
-
-            for (const auto& completion : completions) {
-                std::cout << std::left << std::setw(maxLength + 2) << completion;
-                if (++col >= columns) {
-                    std::cout << "\n";
-                    col = 0;
-                }
-            }
-            if (col != 0) std::cout << "\n";
-        }
-
         void redrawLine(const std::string& input) {
-            std::cout << "\r" << std::string(input.length() + 3, ' ') << "\r";
-            ui.drawPrompt(fs::current_path().string());
-            std::cout << input;
-        }
-
-        std::string findCommonPrefix(const std::vector<std::string>& strings) {
-            if (strings.empty()) return "";
-            
-            std::string prefix = strings[0];
-            for (const auto& s : strings) {
-                while (s.find(prefix) != 0) {
-                    prefix = prefix.substr(0, prefix.length() - 1);
-                }
-            }
-            return prefix;
+            ui.updatePromptInput(input, input.length());
         }
     };
 